@@ -116,6 +116,15 @@ public:
     virtual int WriteLMS7002MSPI(const uint32_t *writeData, size_t size,unsigned periphID = 0)=0;
     virtual int ReadLMS7002MSPI(const uint32_t *writeData, uint32_t *readData, size_t size, unsigned periphID = 0)=0;
 
+    /*!
+     * Wait until LMS7002M SPI writes the connection still queues reached the chip.
+     * Reads are always ordered after earlier writes, this is needed only
+     * before delays that let the chip settle after a write.
+     * Queued writes return 0 from WriteLMS7002MSPI(), their failures are reported here.
+     * @return 0 on success, -1 if any of the writes queued since the last flush failed
+     */
+    virtual int FlushControl(void);
+
     /*!
      * Write to an available I2C slave.
      * @param addr the address of the slave
@@ -161,6 +170,34 @@ public:
     virtual int ResetStreamBuffers();
     virtual int GetBuffersCount()const;
     virtual int CheckStreamSize(int size)const;
+
+    //! Occupancy of stream transfer contexts of one direction
+    struct TransferStats
+    {
+        uint32_t depth;     //!< contexts available for transfers
+        uint32_t inUse;     //!< transfers begun and not finished
+        uint32_t highWater; //!< most transfers in flight at once since depth was set
+        uint64_t acquired;  //!< transfers begun since depth was set
+        uint32_t exhausted; //!< transfers not begun for lack of a free context
+    };
+
+    /** @brief Sets how many stream transfers of given direction can be in flight
+        Changes only while none of them is in flight.
+        @param depth requested number of transfers, 0 - connection default
+        @return number of transfers that can be in flight
+    */
+    virtual int SetTransferDepth(bool tx, int depth);
+    //! @return 0 on success, -1 if connection does not keep transfer statistics
+    virtual int GetTransferStats(bool tx, TransferStats* stats);
+
+    /** @brief Waits until any stream transfer of given direction begun on endpoint ep finished
+        Handles still have to be finished with FinishDataReading() or FinishDataSending(),
+        until then they are reported again, so transfers of other endpoints are never lost.
+        @param handles receives handles of finished transfers in completion order
+        @param count size of handles
+        @return number of handles, 0 on timeout, -1 if connection only supports WaitForReading() and WaitForSending()
+    */
+    virtual int WaitForCompletions(bool tx, int ep, int* handles, int count, unsigned timeout_ms);
     virtual int ReceiveData(char* buffer, int length, int epIndex, int timeout = 100);
     virtual int SendData(const char* buffer, int length, int epIndex, int timeout = 100);
     
@@ -0,0 +1,94 @@
+/**
+    @file ConnectionEmulator.h
+    @brief In-process LMS64C device emulating the control plane of a LimeSDR-USB
+*/
+
+#pragma once
+#include <ConnectionRegistry.h>
+
+#include "LMS64CProtocol.h"
+#include "LMS7002M_RegistersMap.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace lime
+{
+
+/*!
+ * LMS64C connection answering requests in software instead of over USB, so
+ * control algorithms run and can be timed without hardware.
+ * LMS7002M SPI is served by a register model starting from the chip defaults
+ * and following MAC channel selection, board SPI by an FPGA register file whose
+ * PLL and clock counter operations finish at once. VCO comparators of CGEN, SXR
+ * and SXT follow the programmed divider and CSW values, so VCO tuning searches
+ * as on the chip. MCU programs are not run and samples are not streamed.
+ * Requests are answered in order after the latency, several can be in flight.
+ */
+class ConnectionEmulator : public LMS64CProtocol
+{
+public:
+    //! @param latency_us time from request to its response
+    ConnectionEmulator(unsigned latency_us);
+    ~ConnectionEmulator(void);
+
+    bool IsOpen() override;
+
+    int Write(const unsigned char* buffer, int length, int timeout_ms = 100) override;
+    int Read(unsigned char* buffer, int length, int timeout_ms = 100) override;
+
+    void SetLatency(unsigned latency_us);
+    //! @brief Sets reference clock of the synthesizers, also seen by FPGA::DetectRefClk()
+    void SetReferenceClock(double refClk_Hz);
+    //! @return number of request/response transactions so far
+    uint64_t GetTransactionCount() const;
+
+protected:
+    eConnectionType GetType(void) {return USB_PORT;}
+    int GetControlQueueDepth(void) override;
+
+private:
+    void Process(const unsigned char* request, unsigned char* response);
+    void ResetChip();
+    void WriteChip(uint16_t addr, uint16_t value);
+    uint16_t ReadChip(uint16_t addr);
+    uint16_t GetChipBits(uint8_t channel, const LMS7Parameter &param) const;
+    uint8_t Comparators(bool cgen, uint8_t channel) const;
+    void WriteFPGA(uint16_t addr, uint16_t value);
+
+    std::mutex mLock;
+    std::unique_ptr<LMS7002M_RegistersMap> mChip;
+    std::map<uint16_t, uint16_t> mFPGA;
+    uint8_t mGPIO[2];
+    uint8_t mGPIODir[2];
+    struct Response
+    {
+        std::chrono::steady_clock::time_point ready;
+        std::array<unsigned char, ProtocolLMS64C::pktLength> data;
+    };
+    std::deque<Response> mResponses;
+    std::condition_variable mResponseCond; //!< Read() waits for a request to answer
+    double mRefClk_Hz;
+    std::atomic<unsigned> mLatency_us;
+    std::atomic<uint64_t> mTransactions;
+};
+
+/*!
+ * Lists the emulator only when asked for by module=Emulator or when the
+ * LIME_EMULATOR environment variable is set, its value is the latency in us.
+ * The handle address carries the latency of the connection.
+ */
+class ConnectionEmulatorEntry : public ConnectionRegistryEntry
+{
+public:
+    ConnectionEmulatorEntry(void);
+    std::vector<ConnectionHandle> enumerate(const ConnectionHandle& hint);
+    IConnection* make(const ConnectionHandle& handle);
+};
+
+}
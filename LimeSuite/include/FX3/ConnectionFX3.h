@@ -8,6 +8,7 @@
 #include <ConnectionRegistry.h>
 
 #include "LMS64CProtocol.h"
+#include "fifo.h"
 #include <vector>
 #include <set>
 #include <string>
@@ -30,6 +31,8 @@
 namespace lime
 {
 
+class USBTransferPool;
+
 /** @brief Wrapper class for holding USB asynchronous transfers contexts
 */
 class USBTransferContext
@@ -47,6 +50,10 @@ public:
         transfer = libusb_alloc_transfer(0);
         bytesXfered = 0;
         done = 0;
+        pool = nullptr;
+        handle = -1;
+        ep = -1;
+        order = 0;
 #endif
     }
     ~USBTransferContext()
@@ -78,8 +85,60 @@ public:
     libusb_transfer* transfer;
     long bytesXfered;
     std::atomic<bool> done;
-    std::mutex transferLock;
-    std::condition_variable cv;
+    //completion is reported to the owning pool
+    USBTransferPool* pool;
+    int handle;
+    int ep;         //!< endpoint given to Begin, WaitCompleted() looks for it
+    uint32_t order; //!< completion sequence number
+#endif
+};
+
+/** @brief Transfer contexts of one endpoint, all allocated up front and reused
+    Free contexts are kept on a lock-free stack, so taking and returning one
+    is O(1). The head carries a counter next to the index against ABA.
+    Handles returned by Acquire() index the contexts.
+*/
+class USBTransferPool
+{
+public:
+    static const int defaultDepth = 16;
+    static const int maxDepth = 64;
+
+    USBTransferPool();
+    //! @brief Changes number of contexts in use, only while none of them is taken
+    int SetDepth(int depth);
+    int Depth() const {return mDepth;}
+    //! @return handle of a free context, -1 if all are taken
+    int Acquire();
+    void Release(int handle);
+    void GetStats(IConnection::TransferStats* stats) const;
+
+#ifdef __unix__
+    //! @brief Marks context finished, called from transfer callbacks which libusb serializes
+    void Complete(int handle);
+    //! @brief Waits until given context finished
+    bool WaitFor(int handle, unsigned timeout_ms);
+    /** @brief Waits until any transfer begun on given endpoint finished
+        Finished contexts are reported again until they are released.
+        @return number of finished contexts written to handles in completion order, 0 on timeout
+    */
+    int WaitCompleted(int ep, int* handles, int count, unsigned timeout_ms);
+#endif
+
+    USBTransferContext& operator[](int handle) {return mContexts[handle];}
+private:
+    static const uint32_t emptyIndex = 0xFFFFFFFF;
+    USBTransferContext mContexts[maxDepth];
+    std::atomic<int32_t> mNext[maxDepth];
+    std::atomic<uint64_t> mHead; //!< push counter in upper half, index in lower half
+    int mDepth;
+    std::atomic<uint32_t> mInUse;
+    std::atomic<uint32_t> mHighWater;
+    std::atomic<uint64_t> mAcquired;
+    std::atomic<uint32_t> mExhausted;
+#ifdef __unix__
+    std::atomic<uint32_t> mCompletions; //!< completion order counter, written by callbacks
+    FIFOWaitWord mEvent;
 #endif
 };
 
@@ -101,6 +160,9 @@ public:
     int ProgramWrite(const char *buffer, const size_t length, const int programmingMode, const int device, ProgrammingCallback callback) override;
 protected:
     int GetBuffersCount() const;
+    int SetTransferDepth(bool tx, int depth) override;
+    int GetTransferStats(bool tx, TransferStats* stats) override;
+    int WaitForCompletions(bool tx, int ep, int* handles, int count, unsigned timeout_ms) override;
     int CheckStreamSize(int size)const;
     int SendData(const char* buffer, int length, int epIndex = 0, int timeout = 100)override;
     int ReceiveData(char* buffer, int length, int epIndex = 0, int timeout = 100)override;
@@ -118,10 +180,9 @@ protected:
     int ResetStreamBuffers() override;
     eConnectionType GetType(void) {return USB_PORT;}
     
-    static const int USB_MAX_CONTEXTS = 16; //maximum number of contexts for asynchronous transfers
-    
-    USBTransferContext contexts[USB_MAX_CONTEXTS];
-    USBTransferContext contextsToSend[USB_MAX_CONTEXTS];
+    //contexts for asynchronous stream transfers
+    USBTransferPool contexts;
+    USBTransferPool contextsToSend;
 
     bool isConnected;
 
@@ -0,0 +1,96 @@
+/**
+    @file BatchController.h
+    @brief Runtime tuning of USB transfer size and transfers in flight
+*/
+
+#ifndef LMS_BATCH_CONTROLLER_H
+#define LMS_BATCH_CONTROLLER_H
+
+#include <stdint.h>
+
+namespace lime
+{
+
+/*!
+ * Adapts packets per USB transfer and number of transfers in flight of a
+ * streaming loop to the measured link packet rate.
+ *
+ * Data held in flight adds latency of InFlight()*Packets() packet times,
+ * the controller keeps that within the latency budget derived from
+ * throughputVsLatency. Transfers the loop gets to well after their expected
+ * completion mean the host falls behind, so more transfers are kept in
+ * flight, while long quiet periods let the count shrink again.
+ */
+class BatchController
+{
+public:
+    struct Bounds
+    {
+        uint32_t minPackets;
+        uint32_t maxPackets;
+        uint32_t minInFlight;
+        uint32_t maxInFlight;
+        uint32_t latencyBudget_us; //!< data allowed to be held in flight
+    };
+
+    /** @brief Bounds for given stream preference
+        @param throughputVsLatency 0 - lowest latency, 1 - highest throughput
+        @param maxPackets largest transfer the buffers allow
+        @param maxInFlight transfers supported by the connection
+    */
+    static Bounds MakeBounds(float throughputVsLatency, uint32_t maxPackets, uint32_t maxInFlight);
+
+    BatchController(const Bounds &bounds, uint32_t initialPackets);
+
+    inline uint32_t Packets() const {return mPackets;}
+    inline uint32_t InFlight() const {return mInFlight;}
+
+    /** @brief Sets link time per packet at the stream sample rate
+        @param packet_us 0 if not known, the packet rate measured in a period is used instead
+    */
+    void SetPacketTime(double packet_us);
+
+    /** @brief Expected completion time of a transfer submitted now
+        @param transfersAhead transfers already in flight on the link
+        @param packets packets of the submitted transfer
+    */
+    uint64_t ExpectedCompletion(uint64_t now_us, uint32_t transfersAhead, uint32_t packets) const;
+
+    /** @brief Reports a finished transfer
+        @param packets packets transferred
+        @param expected_us completion time given by ExpectedCompletion() at submission
+        @param reached_us time the loop started waiting for it
+    */
+    void OnCompletion(uint32_t packets, uint64_t expected_us, uint64_t reached_us);
+
+    //! @return true when the control period elapsed and Retune() should be called
+    bool Due(uint64_t now_us) const;
+
+    /** @brief Chooses new transfer size and count from statistics of the last period
+        @param fifoPackets packets queued in channel FIFOs. Rx: more than half of fifoSize
+               means the application lags behind, Tx: transfers are not made bigger
+               than the data the application keeps queued
+        @param fifoSize FIFO capacity in packets
+        @param tx true for transmit loop
+        @return true if Packets() or InFlight() changed
+    */
+    bool Retune(uint64_t now_us, uint32_t fifoPackets, uint32_t fifoSize, bool tx);
+
+    static const uint32_t periodUs = 100000;
+private:
+    static uint32_t FloorPow2(uint32_t value);
+
+    Bounds mBounds;
+    uint32_t mPackets;
+    uint32_t mInFlight;
+    double mNominalUs; //!< given by SetPacketTime()
+    double mPacketUs; //!< time per packet completions are expected at, 0 while unknown
+    uint64_t mPeriodStart;
+    uint64_t mPeriodPackets;
+    uint32_t mPeriodTransfers;
+    uint32_t mPeriodLate;
+    uint32_t mQuietPeriods;
+};
+
+}
+#endif
@@ -0,0 +1,92 @@
+/**
+    @file Channelizer.h
+    @brief Polyphase filter bank splitting a stream into uniformly spaced channels and back
+*/
+
+#ifndef LMS_CHANNELIZER_H
+#define LMS_CHANNELIZER_H
+
+#include "dataTypes.h"
+#include <complex>
+#include <vector>
+
+namespace lime
+{
+
+/*!
+ * Shared part of analysis and synthesis banks: prototype filter split into
+ * polyphase branches and the channel count point FFT.
+ * Channel k is centered at k/channels of the stream sample rate, channels from
+ * channels/2 up are the negative frequencies. Each channel has 1/channels of
+ * the stream bandwidth and runs at 1/channels of its sample rate.
+ */
+class FilterBank
+{
+public:
+    //! @param channels power of two from 2 to maxChannels
+    FilterBank(uint32_t channels);
+    uint32_t Channels() const {return mChannels;}
+
+    static const uint32_t maxChannels = 256;
+    static const uint32_t tapsPerBranch = 8;
+protected:
+    void Transform(std::complex<float>* data) const;
+    //! @brief Zeroes branch filter history
+    void Reset();
+
+    const uint32_t mChannels;
+    std::vector<int16_t> mTaps; //!< Q15, tapsPerBranch per branch, reverse time order
+    std::vector<std::vector<complex16_t> > mBranches; //!< history followed by new samples
+    std::vector<std::vector<complex16_t> > mFiltered;
+    std::vector<std::complex<float> > mBlock;
+    uint64_t mNext; //!< timestamp expected next
+private:
+    std::vector<uint32_t> mReversed;
+    std::vector<std::complex<float> > mTwiddles;
+};
+
+/*!
+ * Analysis bank for Rx: one wideband stream in, every channel out.
+ * Blocks are aligned to timestamps, so output does not depend on how input
+ * is split into packets, and a timestamp discontinuity restarts the filters.
+ */
+class Channelizer : public FilterBank
+{
+public:
+    Channelizer(uint32_t channels);
+
+    /** @brief Processes a packet of wideband samples
+        @param timestamp timestamp of samples[0]
+        @param outTimestamp returns timestamp of the first output sample at channel rate
+        @return number of samples produced for every channel, see Output()
+    */
+    uint32_t Process(const complex16_t* samples, uint32_t count, uint64_t timestamp, uint64_t* outTimestamp);
+
+    //! @return samples of channel produced by the last Process(), valid until the next call
+    const complex16_t* Output(uint32_t channel) const {return mOutputs[channel].data();}
+private:
+    std::vector<complex16_t> mInput; //!< incomplete block followed by new samples
+    std::vector<std::vector<complex16_t> > mOutputs;
+};
+
+/*!
+ * Synthesis bank for Tx: every channel in, one wideband stream out.
+ * Sum of channel amplitudes has to stay within full scale.
+ */
+class ChannelSynthesizer : public FilterBank
+{
+public:
+    ChannelSynthesizer(uint32_t channels);
+
+    /** @brief Combines channel samples into wideband samples
+        @param inputs count samples for each channel, nullptr for unused channels
+        @param timestamp timestamp of the first output sample
+        @return count*channels samples, valid until the next call
+    */
+    const complex16_t* Process(const complex16_t* const* inputs, uint32_t count, uint64_t timestamp);
+private:
+    std::vector<complex16_t> mOutput;
+};
+
+}
+#endif
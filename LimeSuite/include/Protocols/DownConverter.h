@@ -0,0 +1,61 @@
+/**
+    @file DownConverter.h
+    @brief Host side digital down-converter of received samples
+*/
+
+#ifndef LMS_DOWN_CONVERTER_H
+#define LMS_DOWN_CONVERTER_H
+
+#include "dataTypes.h"
+#include <atomic>
+#include <vector>
+
+namespace lime
+{
+
+/*!
+ * Selects a narrow sub-band of a wide Rx stream: NCO mixer followed by a cascade
+ * of half-band decimate-by-2 filters, fixed-point Q15 throughout.
+ * Mixer phase and filter phases follow the hardware timestamp, so the output is
+ * the same regardless of how input is split into packets, and a timestamp
+ * discontinuity restarts the filters instead of smearing across the gap.
+ */
+class DownConverter
+{
+public:
+    /** @param frequency sub-band center relative to stream center, in cycles per input sample (-0.5..0.5)
+        @param decimation power of two from 1 to maxDecimation
+    */
+    DownConverter(double frequency, uint32_t decimation);
+
+    //! @brief Retunes the mixer, can be called while streaming
+    void SetFrequency(double frequency);
+    double GetFrequency() const;
+    uint32_t Decimation() const {return mDecimation;}
+
+    /** @brief Processes a packet of input samples
+        @param timestamp timestamp of samples[0] at input rate
+        @param outCount returns number of output samples
+        @param outTimestamp returns timestamp of the first output sample at output rate
+        @return output samples, valid until the next call
+    */
+    const complex16_t* Process(const complex16_t* samples, uint32_t count, uint64_t timestamp, uint32_t* outCount, uint64_t* outTimestamp);
+
+    static const uint32_t maxDecimation = 256;
+private:
+    struct Stage
+    {
+        std::vector<complex16_t> input; //!< filter history followed by new samples
+        std::vector<complex16_t> output;
+        uint64_t next; //!< timestamp of the sample expected next
+    };
+
+    const uint32_t mDecimation;
+    std::atomic<uint32_t> mPhaseIncrement;
+    std::vector<complex16_t> mOscillator;
+    std::vector<complex16_t> mMixed;
+    std::vector<Stage> mStages;
+};
+
+}
+#endif
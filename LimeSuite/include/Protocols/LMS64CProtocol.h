@@ -10,6 +10,10 @@
 #include <LMS64CCommands.h>
 #include <LMSBoards.h>
 #include <thread>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
 
 namespace lime{
 
@@ -18,6 +22,12 @@ namespace lime{
  * The LMS64CProtocol is an IConnection that implements
  * configuration and spi access over the LMS64C Protocol.
  * Connections using LMS64C may inherit from LMS64C.
+ *
+ * LMS7002M SPI writes return once queued. A control thread packs consecutive
+ * queued writes into full packets and keeps up to GetControlQueueDepth()
+ * requests in flight. Reads are queued behind the writes, so only reads wait
+ * for them. A failed queued write is reported by the next FlushControl().
+ * Connections have to call StopControlQueue() before they close.
  */
 class LIME_API LMS64CProtocol : public virtual IConnection
 {
@@ -185,7 +195,22 @@ public:
     int ProgramMCU(const uint8_t *buffer, const size_t length, const MCU_PROG_MODE mode, ProgrammingCallback callback) override;
     int WriteLMS7002MSPI(const uint32_t *writeData, size_t size,unsigned periphID = 0) override;
     int ReadLMS7002MSPI(const uint32_t *writeData, uint32_t *readData, size_t size, unsigned periphID = 0) override;
+    int FlushControl(void) override;
+
+    /** @brief Queues LMS7002M reads behind pending writes without waiting for them
+        @param readData receives values, has to stay valid until the future is ready
+        @return future of the read status, 0 on success
+    */
+    std::future<int> ReadLMS7002MSPIAsync(const uint32_t *writeData, uint32_t *readData, size_t size, unsigned periphID = 0);
+
+    //! @brief Queues board SPI reads, like ReadLMS7002MSPIAsync()
+    std::future<int> ReadRegistersAsync(const uint32_t *addrs, uint32_t *data, const size_t size);
 protected:
+    //! @return number of requests device accepts before their responses are read
+    virtual int GetControlQueueDepth(void);
+    //! @brief Sends queued requests and ends control thread, later writes start it again
+    void StopControlQueue(void);
+
 #ifdef REMOTE_CONTROL
     void InitRemote();
     void CloseRemote();
@@ -204,6 +229,49 @@ private:
     unsigned char* PreparePacket(const GenericPacket &pkt, int &length, const eLMS_PROTOCOL protocol);
     int ParsePacket(GenericPacket &pkt, const unsigned char* buffer, const int length, const eLMS_PROTOCOL protocol);
     std::mutex mControlPortLock;
+    std::vector<unsigned char> mInBuffer; //!< responses of TransferPacket()
     double _cachedRefClockRate;
+
+    struct PendingRead
+    {
+        std::promise<int> done;
+        uint32_t* data;
+        size_t size;
+        size_t packed;
+        int status;
+    };
+    //! one register of a queued request
+    struct ControlEntry
+    {
+        eCMD_LMS cmd;
+        unsigned periphID;
+        uint32_t word; //!< address and value of writes, address of reads
+        std::shared_ptr<PendingRead> read;
+    };
+    //! packet sent or about to be sent by the control thread
+    struct ControlSlot
+    {
+        unsigned char out[ProtocolLMS64C::pktLength];
+        unsigned char in[ProtocolLMS64C::pktLength];
+        std::shared_ptr<PendingRead> read;
+        size_t offset;
+        size_t count;
+        int status;
+    };
+    bool QueueControl(eCMD_LMS cmd, unsigned periphID, const uint32_t* words, size_t size, std::shared_ptr<PendingRead> read);
+    std::future<int> QueueRead(eCMD_LMS cmd, unsigned periphID, const uint32_t* words, uint32_t* data, size_t size);
+    void PackControl(ControlSlot &slot);
+    void CompleteControl(ControlSlot &slot);
+    void WaitControlIdle(std::unique_lock<std::mutex> &lck);
+    void ControlLoop(void);
+
+    std::mutex mQueueLock;
+    std::condition_variable mQueueCond; //!< control thread waits for requests
+    std::condition_variable mIdleCond; //!< FlushControl() waits for the queue to drain
+    std::deque<ControlEntry> mControlQueue;
+    bool mControlBusy; //!< control thread holds requests taken from the queue
+    bool mControlQuit;
+    int mControlError; //!< failure of queued writes, returned by FlushControl()
+    std::thread mControlThread;
 };
 }
@@ -0,0 +1,100 @@
+/**
+    @file SampleKernels.h
+    @brief Sample format conversion and measurement kernels of the streaming path.
+    Vectorized implementations are selected at runtime by CPU features,
+    the scalar implementations are used as fallback and as reference.
+*/
+
+#ifndef LMS_SAMPLE_KERNELS_H
+#define LMS_SAMPLE_KERNELS_H
+
+#include "dataTypes.h"
+
+namespace lime
+{
+namespace kernels
+{
+
+//! @brief Name of the instruction set selected for the kernels ("avx2", "ssse3" or "scalar")
+const char* SelectedISA();
+
+/** @brief Unpacks 12-bit link samples (3 bytes per I/Q pair) into 16-bit samples
+    @param buffer packed samples, channels interleaved per sample when mimo
+    @param bufLen number of bytes in buffer
+    @param samples destination array for each channel
+    @return number of samples per channel
+*/
+int Unpack12(const uint8_t* buffer, int bufLen, bool mimo, complex16_t** samples);
+
+/** @brief Packs 16-bit samples into 12-bit link format
+    @return number of bytes written to buffer
+*/
+int Pack12(const complex16_t* const* samples, int samplesCount, bool mimo, uint8_t* buffer);
+
+//! @brief Splits interleaved 16-bit link samples of two channels
+int Deinterleave16(const uint8_t* buffer, int bufLen, complex16_t** samples);
+
+//! @brief Interleaves 16-bit samples of two channels into link format
+int Interleave16(const complex16_t* const* samples, int samplesCount, uint8_t* buffer);
+
+/** @brief Converts 16-bit samples to float as sample*scale+offset
+    Conversion can be done in place, dst may start at the same address as src.
+*/
+void Int16ToFloat(const complex16_t* src, float* dst, int samplesCount, float scale, float offsetI, float offsetQ);
+
+//! @brief Converts float samples to 16-bit as sample*scale+offset, rounded and saturated
+void FloatToInt16(const float* src, complex16_t* dst, int samplesCount, float scale, float offsetI, float offsetQ);
+
+/** @brief Sum of I*I+Q*Q of samples
+    Sample power is computed in 32 bits, the sum in 64 bits, full int16 range is allowed.
+*/
+uint64_t Energy(const complex16_t* src, int samplesCount);
+
+/** @brief Finds first sample whose power I*I+Q*Q is above (or not above) threshold
+    @param above true to find power > threshold, false to find power <= threshold
+    @return index of the sample, -1 if there is none
+*/
+int FindPower(const complex16_t* src, int samplesCount, uint32_t threshold, bool above);
+
+//! Longest pattern supported by Correlate()
+static const int maxCorrelationLength = 64;
+
+/** @brief Cross-correlates samples with a pattern, out[n] = sum src[n+k]*conj(pattern[k])
+    Sums are 32-bit, samples and pattern are expected to be within 12-bit range.
+    @param src samples, outputs+patternLength-1 of them are read
+    @param outputs number of correlation values to compute
+    @param patternLength pattern length, at most maxCorrelationLength
+    @param re real parts of the results
+    @param im imaginary parts of the results
+*/
+void Correlate(const complex16_t* src, int outputs, const complex16_t* pattern, int patternLength, int32_t* re, int32_t* im);
+
+/** @brief Mixes samples with conjugate of local oscillator, dst = src*conj(lo) in Q15
+    Shifts a signal at the oscillator frequency to DC. Results are rounded and saturated.
+*/
+void MixDown(const complex16_t* src, const complex16_t* lo, int samplesCount, complex16_t* dst);
+
+//! Longest filter supported by FirDecimate()
+static const int maxFirLength = 64;
+
+/** @brief Decimating FIR filter, dst[m] = sum taps[j]*src[m*decimation+j] in Q15
+    Only the kept outputs are computed. Results are rounded and saturated.
+    @param src input, (outputs-1)*decimation+tapsCount samples are read
+    @param taps Q15 coefficients, at most maxFirLength, applied in reverse time order
+*/
+void FirDecimate(const complex16_t* src, int outputs, int decimation, const int16_t* taps, int tapsCount, complex16_t* dst);
+
+//scalar reference implementations
+int Unpack12_scalar(const uint8_t* buffer, int bufLen, bool mimo, complex16_t** samples);
+int Pack12_scalar(const complex16_t* const* samples, int samplesCount, bool mimo, uint8_t* buffer);
+void Int16ToFloat_scalar(const complex16_t* src, float* dst, int samplesCount, float scale, float offsetI, float offsetQ);
+void FloatToInt16_scalar(const float* src, complex16_t* dst, int samplesCount, float scale, float offsetI, float offsetQ);
+uint64_t Energy_scalar(const complex16_t* src, int samplesCount);
+int FindPower_scalar(const complex16_t* src, int samplesCount, uint32_t threshold, bool above);
+void MixDown_scalar(const complex16_t* src, const complex16_t* lo, int samplesCount, complex16_t* dst);
+void FirDecimate_scalar(const complex16_t* src, int outputs, int decimation, const int16_t* taps, int tapsCount, complex16_t* dst);
+void Correlate_scalar(const complex16_t* src, int outputs, const complex16_t* pattern, int patternLength, int32_t* re, int32_t* im);
+
+}
+}
+#endif
@@ -0,0 +1,95 @@
+/**
+    @file StreamBuffer.h
+    @brief Memory allocation for streaming buffers (USB transfers and FIFOs)
+*/
+
+#ifndef LMS_STREAM_BUFFER_H
+#define LMS_STREAM_BUFFER_H
+
+#include "LimeSuiteConfig.h"
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace lime
+{
+
+/*!
+ * Allocator used for all streaming buffers. The default one can be replaced
+ * with Set(), buffers remember their allocator so replacing it is safe
+ * while streams exist.
+ */
+class LIME_API StreamAllocator
+{
+public:
+    virtual ~StreamAllocator() {}
+
+    /** @brief Allocates zero initialized, at least page aligned memory
+        @param bytes requested size, updated to the reserved size that is passed to Free()
+        @return memory, nullptr on failure
+    */
+    virtual void* Allocate(size_t &bytes) = 0;
+    virtual void Free(void* ptr, size_t bytes) = 0;
+
+    static StreamAllocator* Get();
+    //! @param allocator new allocator, nullptr restores the default one
+    static void Set(StreamAllocator* allocator);
+};
+
+/*!
+ * Default allocator. Memory is mapped lazily, so pages are placed on the NUMA node
+ * of the thread that first writes them (first-touch): the streaming thread for
+ * USB buffers and the producer side for FIFOs.
+ */
+class LIME_API DefaultStreamAllocator : public StreamAllocator
+{
+public:
+    enum Options
+    {
+        HUGE_PAGES = 1,  //!< back buffers of 2 MB and more with huge pages
+        LOCK_MEMORY = 2, //!< lock buffers in memory so they are never paged out
+    };
+
+    DefaultStreamAllocator();
+    //! The instance used unless StreamAllocator::Set() replaced it
+    static DefaultStreamAllocator& Instance();
+    void SetOptions(uint32_t options);
+    uint32_t GetOptions() const;
+
+    void* Allocate(size_t &bytes) override;
+    void Free(void* ptr, size_t bytes) override;
+
+    static const size_t hugePageSize = 2 << 20;
+private:
+    std::atomic<uint32_t> mOptions;
+};
+
+//! Owns a buffer of the allocator that was current when it was allocated
+class LIME_API StreamBuffer
+{
+public:
+    StreamBuffer();
+    //! @throws std::bad_alloc when allocation fails
+    explicit StreamBuffer(size_t bytes);
+    ~StreamBuffer();
+
+    //! @throws std::bad_alloc when allocation fails
+    void Allocate(size_t bytes);
+    void Release();
+    //! Writes every page from the calling thread, so that they are placed on its node
+    void Touch();
+
+    inline void* data() const {return mPtr;}
+    inline size_t size() const {return mSize;}
+private:
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    void* mPtr;
+    size_t mSize;
+    size_t mReserved;
+    StreamAllocator* mAllocator;
+};
+
+}
+#endif
@@ -0,0 +1,237 @@
+/**
+    @file StreamExecutor.h
+    @brief Coroutine tasks awaiting stream operations on a small thread pool
+*/
+
+#ifndef LMS_STREAM_EXECUTOR_H
+#define LMS_STREAM_EXECUTOR_H
+
+//only available when built as C++20 or later
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#define LIME_STREAM_COROUTINES
+
+#include "Streamer.h"
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace lime
+{
+
+template<typename T> class Task;
+
+namespace detail
+{
+
+struct TaskPromiseBase
+{
+    struct FinalAwaiter
+    {
+        bool await_ready() const noexcept {return false;}
+        template<typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            std::coroutine_handle<> continuation = handle.promise().continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept {return {};}
+    FinalAwaiter final_suspend() const noexcept {return {};}
+    void unhandled_exception() {error = std::current_exception();}
+
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+};
+
+template<typename T>
+struct TaskPromise : public TaskPromiseBase
+{
+    Task<T> get_return_object();
+    void return_value(T result) {value = std::move(result);}
+    T value;
+};
+
+template<>
+struct TaskPromise<void> : public TaskPromiseBase
+{
+    Task<void> get_return_object();
+    void return_void() {}
+};
+
+}
+
+/*!
+ * Lazily started coroutine, runs when awaited and resumes the awaiting one when done.
+ * T has to be default constructible.
+ */
+template<typename T = void>
+class Task
+{
+public:
+    typedef detail::TaskPromise<T> promise_type;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : mHandle(handle) {}
+    Task(Task &&other) noexcept : mHandle(std::exchange(other.mHandle, nullptr)) {}
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task()
+    {
+        if (mHandle)
+            mHandle.destroy();
+    }
+
+    bool await_ready() const noexcept {return false;}
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+    {
+        mHandle.promise().continuation = awaiting;
+        return mHandle;
+    }
+    T await_resume()
+    {
+        if (mHandle.promise().error)
+            std::rethrow_exception(mHandle.promise().error);
+        if constexpr (!std::is_void_v<T>)
+            return std::move(mHandle.promise().value);
+    }
+
+private:
+    std::coroutine_handle<promise_type> mHandle;
+};
+
+namespace detail
+{
+template<typename T>
+inline Task<T> TaskPromise<T>::get_return_object()
+{
+    return Task<T>(std::coroutine_handle<TaskPromise<T> >::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object()
+{
+    return Task<void>(std::coroutine_handle<TaskPromise<void> >::from_promise(*this));
+}
+}
+
+/*!
+ * Runs coroutine tasks on a few worker threads. Tasks suspend on stream FIFOs
+ * instead of blocking a thread: one reactor thread sleeps on a single wait word
+ * that the FIFOs of awaited streams notify, and hands tasks whose stream became
+ * ready back to the workers. A stream can be served by one executor at a time
+ * and has to stay set up while the executor uses it, Release() detaches it.
+ */
+class LIME_API StreamExecutor
+{
+public:
+    //! @param threads worker threads running the tasks
+    StreamExecutor(unsigned threads = 2);
+    //! Stops and waits for all spawned tasks
+    ~StreamExecutor();
+
+    //! @brief Starts task on the workers, executor keeps it until it finishes
+    void Spawn(Task<void> task);
+
+    /** @brief Ends waiting, pending and later stream waits and sleeps complete at once and fail
+        Tasks have to return when their awaits fail. Blocks until all spawned tasks finished.
+    */
+    void Stop();
+    bool Stopping() const {return mStopping.load(std::memory_order_acquire);}
+
+    //! @brief Detaches stream from this executor
+    void Release(StreamChannel* channel);
+
+    //! Awaitable moving the awaiting task to a worker thread
+    struct ScheduleAwaiter
+    {
+        StreamExecutor* executor;
+        bool await_ready() const noexcept {return false;}
+        void await_suspend(std::coroutine_handle<> handle) {executor->Post(handle);}
+        void await_resume() const noexcept {}
+    };
+    ScheduleAwaiter Schedule() {return ScheduleAwaiter{this};}
+
+    //! Awaitable resuming when channel FIFO has samples (Rx) or free space (Tx), false when stopping
+    struct ReadyAwaiter
+    {
+        StreamExecutor* executor;
+        StreamChannel* channel;
+        bool await_ready() const {return executor->Stopping() || executor->IsReady(channel);}
+        bool await_suspend(std::coroutine_handle<> handle) {return executor->Enqueue(channel, handle);}
+        bool await_resume() const {return !executor->Stopping();}
+    };
+    ReadyAwaiter Ready(StreamChannel* channel) {return ReadyAwaiter{this, channel};}
+
+    //! Awaitable resuming after duration, false when stopping
+    struct SleepAwaiter
+    {
+        StreamExecutor* executor;
+        std::chrono::steady_clock::time_point deadline;
+        bool await_ready() const {return executor->Stopping() || std::chrono::steady_clock::now() >= deadline;}
+        bool await_suspend(std::coroutine_handle<> handle) {return executor->EnqueueTimer(deadline, handle);}
+        bool await_resume() const {return !executor->Stopping();}
+    };
+    SleepAwaiter Sleep(std::chrono::microseconds duration) {return SleepAwaiter{this, std::chrono::steady_clock::now() + duration};}
+
+    /** @brief Reads count samples, suspending while FIFO is empty
+        @param meta returns timestamp of the first sample
+        @return number of samples read, fewer only when stopping, -1 on error
+    */
+    Task<int> Read(StreamChannel* channel, void* samples, uint32_t count, StreamChannel::Metadata* meta);
+
+    /** @brief Writes count samples, suspending while FIFO is full
+        @return number of samples written, fewer only when stopping, -1 on error
+    */
+    Task<int> Write(StreamChannel* channel, const void* samples, uint32_t count, const StreamChannel::Metadata* meta);
+
+private:
+    struct Detached;
+    Detached Launch(Task<void> task);
+    void Post(std::coroutine_handle<> handle);
+    bool IsReady(StreamChannel* channel);
+    bool Enqueue(StreamChannel* channel, std::coroutine_handle<> handle);
+    bool EnqueueTimer(std::chrono::steady_clock::time_point deadline, std::coroutine_handle<> handle);
+    void WorkerLoop();
+    void ReactorLoop();
+
+    struct Waiter
+    {
+        StreamChannel* channel;
+        std::coroutine_handle<> handle;
+    };
+    struct Timer
+    {
+        std::chrono::steady_clock::time_point deadline;
+        std::coroutine_handle<> handle;
+    };
+
+    std::atomic<bool> mStopping;
+    //ready to run
+    std::mutex mQueueLock;
+    std::condition_variable mQueueCond;
+    std::deque<std::coroutine_handle<> > mQueue;
+    bool mQuit;
+    //spawned tasks still running
+    std::mutex mTasksLock;
+    std::condition_variable mTasksCond;
+    unsigned mTasks;
+    //waiting for streams and time, served by the reactor
+    FIFOWaitWord mEvent;
+    std::mutex mWaitersLock;
+    std::vector<Waiter> mWaiters;
+    std::vector<Timer> mTimers;
+    std::vector<StreamChannel*> mChannels; //!< streams notifying mEvent
+    std::vector<std::thread> mWorkers;
+    std::thread mReactor;
+};
+
+}
+
+#endif // __cpp_impl_coroutine
+#endif
@@ -0,0 +1,129 @@
+/**
+    @file StreamProfiler.h
+    @brief Per-stage latency histograms and timeline tracing of the streaming path
+*/
+
+#ifndef LMS_STREAM_PROFILER_H
+#define LMS_STREAM_PROFILER_H
+
+#include "LimeSuiteConfig.h"
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+namespace lime
+{
+
+//! Stages of the streaming path, the order is also used by the C API
+enum StreamStage
+{
+    STAGE_RX_USB_WAIT = 0, //!< waiting for a USB read transfer to complete
+    STAGE_RX_PARSE,        //!< unpacking a received packet into samples
+    STAGE_RX_FIFO_PUSH,    //!< pushing received samples into channel FIFO
+    STAGE_RX_APP_READ,     //!< application reading samples from FIFO
+    STAGE_TX_APP_WRITE,    //!< application writing samples into FIFO
+    STAGE_TX_FIFO_POP,     //!< taking samples out of FIFO for a packet
+    STAGE_TX_BUILD,        //!< packing samples into a packet
+    STAGE_TX_USB_WAIT,     //!< waiting for a USB write transfer to complete
+    STAGE_APP_PROCESS,     //!< application processing between reads, reported by the caller
+    STAGE_COUNT
+};
+
+/*!
+ * Collects per-stage durations into lock-free log-linear histograms
+ * (8 sub-buckets per power of two, 12.5% resolution) and, optionally,
+ * into a ring of timeline events that can be written in Chrome trace format.
+ * Both are off by default and cost a single relaxed load when disabled.
+ */
+class LIME_API StreamProfiler
+{
+public:
+    struct StageStats
+    {
+        uint64_t count;
+        uint64_t min_ns;
+        uint64_t max_ns;
+        uint64_t mean_ns;
+        uint64_t p50_ns;
+        uint64_t p90_ns;
+        uint64_t p99_ns;
+        uint64_t p999_ns;
+    };
+
+    static StreamProfiler& Instance();
+
+    void SetEnabled(bool enable);
+    void SetTracing(bool enable);
+    inline bool IsEnabled() const {return enabled.load(std::memory_order_relaxed);}
+    inline bool IsTracing() const {return tracing.load(std::memory_order_relaxed);}
+
+    void Record(StreamStage stage, uint64_t start_ns, uint64_t duration_ns);
+    StageStats GetStats(StreamStage stage) const;
+    void Reset();
+
+    //! Writes the trace ring as Chrome trace JSON (chrome://tracing, Perfetto)
+    int WriteTrace(const char* filename) const;
+
+    static const char* StageName(StreamStage stage);
+    static inline uint64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    StreamProfiler();
+    StreamProfiler(const StreamProfiler&) = delete;
+    StreamProfiler& operator=(const StreamProfiler&) = delete;
+
+    static const int linearBuckets = 16;
+    static const int subBucketBits = 3;
+    static const int bucketsCount = linearBuckets + (64-4)*(1<<subBucketBits);
+    static const uint32_t traceSize = 1<<16;
+
+    static int BucketIndex(uint64_t value);
+    static uint64_t BucketValue(int index);
+
+    struct Histogram
+    {
+        std::atomic<uint64_t> buckets[bucketsCount];
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> min;
+        std::atomic<uint64_t> max;
+    };
+
+    struct TraceEvent
+    {
+        std::atomic<uint64_t> seq; //!< 0 while being written, otherwise index+1
+        uint64_t start_ns;
+        uint64_t duration_ns;
+        uint32_t thread;
+        uint16_t stage;
+    };
+
+    std::atomic<bool> enabled;
+    std::atomic<bool> tracing;
+    Histogram histograms[STAGE_COUNT];
+    TraceEvent* trace;
+    std::atomic<uint64_t> traceIndex;
+};
+
+//! Measures the lifetime of the object as the duration of a stage
+class StageTimer
+{
+public:
+    inline StageTimer(StreamStage stage) : mStage(stage),
+        mStart(StreamProfiler::Instance().IsEnabled() ? StreamProfiler::Now() : 0) {}
+    inline ~StageTimer()
+    {
+        if (mStart)
+            StreamProfiler::Instance().Record(mStage, mStart, StreamProfiler::Now()-mStart);
+    }
+private:
+    StreamStage mStage;
+    uint64_t mStart;
+};
+
+}
+#endif
@@ -16,6 +16,8 @@
 
 #include "dataTypes.h"
 #include "fifo.h"
+#include "TriggerEngine.h"
+#include <functional>
 #include <vector>
 
 namespace lime
@@ -25,13 +27,24 @@ class IConnection;
 class FPGA;
 class Streamer;
 class LMS7002M;
+class DownConverter;
+class Channelizer;
+class ChannelSynthesizer;
 
 /*!
  * The stream config structure is used with the SetupStream() API.
  */
 struct LIME_API StreamConfig
 {
-    StreamConfig(void){};
+    StreamConfig(void)
+    {
+        threadOptions.cpuMask = 0;
+        threadOptions.policy = ThreadOptions::POLICY_DEFAULT;
+        threadOptions.priority = 0;
+        fillGaps = false;
+        historyLength = 0;
+        transferDepth = 0;
+    };
 
     //! True for transmit stream, false for receive
     bool isTx;
@@ -66,6 +79,29 @@ struct LIME_API StreamConfig
      * Default: STREAM_12_BIT_IN_16
      */
     StreamDataFormat linkFormat;
+
+    //! Placement and scheduling of the streaming thread serving this stream, applied when the thread starts
+    struct ThreadOptions
+    {
+        uint64_t cpuMask; //!< bit n allows CPU n, 0 - no restriction
+        enum Policy
+        {
+            POLICY_DEFAULT,
+            POLICY_FIFO,
+            POLICY_RR,
+        } policy;
+        int priority; //!< real-time priority for POLICY_FIFO and POLICY_RR
+    };
+    ThreadOptions threadOptions;
+
+    //! Rx: insert zero samples flagged RingFIFO::GAP_FILLED for lost packets, keeping timestamps continuous
+    bool fillGaps;
+
+    //! Rx: number of already read samples kept for StreamChannel::ReadHistory(), 0 - none
+    uint64_t historyLength;
+
+    //! USB transfers the streaming thread may keep in flight, 0 - connection default, applied when the thread starts
+    uint32_t transferDepth;
 };
 
 class LIME_API StreamChannel 
@@ -95,16 +131,79 @@ public:
         int droppedPackets;
         uint64_t timestamp;
     };
+
+    //! Cumulative stream health counters, reading them does not reset anything
+    struct Telemetry
+    {
+        bool active;
+        uint32_t fifoSize;
+        uint32_t fifoItemsCount;
+        uint32_t fifoHighWater;
+        uint32_t overrun;
+        uint32_t underrun;
+        uint32_t droppedPackets;
+        uint64_t linkBytes;
+        float linkRate;
+        uint64_t timestamp;
+    };
     
+    //! Record of Rx packet losses since the stream was set up
+    struct LossStats
+    {
+        static const int histogramSize = 16;
+        static const int eventsSize = 16;
+        //! histogram[n] counts gaps of 2^n to 2^(n+1)-1 packets, the last one also bigger gaps
+        uint32_t histogram[histogramSize];
+        uint32_t eventsCount;    //!< loss events since setup
+        uint64_t filledSamples;  //!< zero samples inserted with fillGaps
+        //! most recent events, oldest first
+        uint32_t recentCount;
+        uint64_t recentTimestamp[eventsSize]; //!< timestamp of the first missing sample
+        uint32_t recentPackets[eventsSize];
+    };
+
+    /** Push and pull access to the stream, see SetCallback()
+        Rx: samples were received, returns number of samples taken, the rest is offered again
+        Tx: fills up to count samples and meta, returns number of samples filled
+        Negative return stops callbacks until the stream is started again.
+    */
+    typedef std::function<int(void* samples, uint32_t count, Metadata* meta)> Callback;
+
     StreamChannel(Streamer* streamer);
+    //! Channels are only copied when Streamer creates its channel vectors
+    StreamChannel(const StreamChannel& other);
     ~StreamChannel();
     
     
-    void Setup(StreamConfig conf);
+    void Setup(StreamConfig conf, uint32_t packetSamples);
     void Close();
     int Read(void* samples, const uint32_t count, Metadata* meta, const int32_t timeout_ms = 100);
     int Write(const void* samples, const uint32_t count, const Metadata* meta, const int32_t timeout_ms = 100);
+    void SetFloatConversion(float scale, float offsetI, float offsetQ);
+    int ReadHistory(const uint64_t timestamp, void* samples, const uint32_t count, Metadata* meta);
+    int SetHistory(const double seconds);
+    static int ReadAligned(StreamChannel* const* channels, const uint8_t chCount, void* const* samples, const uint32_t count, Metadata* meta, const int32_t timeout_ms = 100);
+    //zero-copy access to FIFO packets, not available for FMT_FLOAT32 streams
+    int AcquireRead(const complex16_t** samples, Metadata* meta, const int32_t timeout_ms = 100);
+    bool ReleaseRead(const uint32_t count);
+    int AcquireWrite(complex16_t** samples, const int32_t timeout_ms = 100, const bool overwrite = false);
+    int CommitWrite(const uint32_t count, const Metadata* meta);
     StreamChannel::Info GetInfo();
+    void GetFIFOPackets(uint32_t* filled, uint32_t* size);
+    StreamChannel::Telemetry GetTelemetry();
+    StreamChannel::LossStats GetLossStats();
+    void RecordLoss(const uint64_t timestamp, const uint32_t packets, const uint64_t samples);
+    bool ReceivesInSlot();
+    bool PushReceived(complex16_t* samples, const bool inSlot, const uint32_t count, const Metadata* meta);
+    int SetTrigger(const TriggerEngine::Config &options);
+    uint32_t GetTriggerCount() const;
+    StreamChannel* AddDDC(const double frequency, const uint32_t decimation);
+    int SetDDCFrequency(const double frequency);
+    int SetupChannelizer(const uint32_t channels, StreamChannel** outputs);
+    int WriteChannels(const void* const* samples, const uint32_t count, const Metadata* meta, const int32_t timeout_ms = 100);
+    void ProcessOutputs(const complex16_t* samples, const uint32_t count, const uint64_t timestamp);
+    int SetCallback(Callback function, const bool direct = false);
+    void SetEvent(FIFOWaitWord* event);
     int GetStreamSize();
 
     bool IsActive() const;
@@ -112,14 +211,51 @@ public:
     int Stop();
     StreamConfig config;
     Streamer* mStreamer;
-    unsigned overflow;
-    unsigned underflow;
-    unsigned pktLost;
+    std::atomic<uint32_t> overflow;
+    std::atomic<uint32_t> underflow;
+    std::atomic<uint32_t> pktLost;
     bool mActive;
     bool used;
        
 protected:
+    void ResetCounters();
+    void RemoveOutput(StreamChannel* output);
+    void DispatchLoop();
     RingFIFO* fifo;  
+    //counter values already returned by GetInfo()
+    uint32_t reportedOverflow;
+    uint32_t reportedUnderflow;
+    uint32_t reportedPktLost;
+    //written by Rx thread on loss events, recentNext indexes the ring of recent events
+    std::mutex lossLock;
+    LossStats loss;
+    uint32_t recentNext;
+    TriggerEngine trigger;
+    //DDC and channelizer outputs fed by this Rx channel, hasDDC lets the Rx thread skip the lock
+    std::mutex ddcLock;
+    std::vector<StreamChannel*> ddcOutputs;
+    Channelizer* channelizer;
+    std::vector<StreamChannel*> channelizerOutputs; //!< by channel, nullptr once closed
+    std::atomic<bool> hasDDC;
+    //set on outputs only
+    DownConverter* ddc;
+    StreamChannel* ddcParent;
+    //Tx channel split into channels, see WriteChannels()
+    ChannelSynthesizer* synthesizer;
+    std::vector<complex16_t> channelInput;
+    //callback and the thread calling it, direct Rx callbacks are called by the Rx thread instead
+    Callback callback;
+    bool callbackDirect;
+    std::atomic<bool> callbackStopped;
+    std::atomic<bool> stopDispatcher;
+    std::thread dispatcher;
+    std::vector<float> callbackFloats;
+    //float conversion parameters and Tx conversion buffer, see SetFloatConversion()
+    static const int scratchPackets = 16;
+    std::vector<complex16_t> scratch;
+    float convScale;
+    float convOffsetI;
+    float convOffsetQ;
 };
     
 class Streamer
@@ -130,18 +266,56 @@ public:
 
     StreamChannel* SetupStream(const StreamConfig& config);
     int GetStreamSize(bool tx);
+    double GetSampleRate(bool tx);
 
     uint64_t GetHardwareTimestamp(void);
     void SetHardwareTimestamp(const uint64_t now);
     int UpdateThreads(bool stopAll = false);
+    int PauseThreads();
+    void ApplyLayout(int paused);
 
     std::atomic<uint32_t> rxDataRate_Bps;
     std::atomic<uint32_t> txDataRate_Bps;
+    std::atomic<uint64_t> rxBytesTotal;
+    std::atomic<uint64_t> txBytesTotal;
     IConnection* dataPort;
+
+    /*!
+     * Run state of a streaming thread. Threads outlive Stop(), while none of
+     * their streams is active they park between transfers, keeping buffers
+     * and transfer contexts, and are only joined when the stream set changes.
+     */
+    struct ThreadControl
+    {
+        enum State
+        {
+            RUN,
+            PARK,   //!< requested by UpdateThreads()
+            PARKED, //!< acknowledged by the thread, streams are not touched until RUN
+            EXITED, //!< thread function returned, stays until UpdateThreads() joins it
+        };
+        //! marks the thread EXITED on every return of its loop, so ParkThread() stops waiting
+        struct ExitGuard
+        {
+            ThreadControl &control;
+            ~ExitGuard()
+            {
+                control.state.store(EXITED, std::memory_order_release);
+                control.ack.Notify();
+            }
+        };
+        std::atomic<int> state;
+        std::atomic<bool> keepTimestamps; //!< Rx unparked after a layout change, its streams did not stop
+        FIFOWaitWord wake; //!< parked thread sleeps on it
+        FIFOWaitWord ack;  //!< UpdateThreads() sleeps on it until the thread parks
+    };
     std::thread rxThread;
     std::thread txThread;
     std::atomic<bool> terminateRx;
     std::atomic<bool> terminateTx;
+    ThreadControl rxControl;
+    ThreadControl txControl;
+    bool configured; //!< FPGA was set up for the streams the threads were started with
 
     std::vector<StreamChannel> mRxStreams;
     std::vector<StreamChannel> mTxStreams;
@@ -154,11 +328,22 @@ public:
     StreamConfig::StreamDataFormat dataLinkFormat;
     void ReceivePacketsLoop();
     void TransmitPacketsLoop();
+    bool IsRunning(bool tx) const;
+    StreamConfig::ThreadOptions GetThreadOptions(bool tx) const;
+    float GetLatencyPreference(bool tx) const;
+    uint32_t GetTransferDepth(bool tx) const;
+    //upper limit of packets in one USB transfer, actual size is tuned while streaming
+    static const unsigned maxPacketsInTransfer = 128;
 private:
     void AlignRxTSP();
     void AlignRxRF(bool restoreValues);
     void AlignQuadrature(bool restoreValues);
     void RstRxIQGen();
+    void WriteLayout();
+    void ParkThread(ThreadControl &control);
+    void UnparkThread(ThreadControl &control);
+    void JoinThread(std::thread &thread, std::atomic<bool> &terminate, ThreadControl &control);
+    void Park(ThreadControl &control, const std::atomic<bool> &terminate);
     double GetPhaseOffset(int bin);
     FPGA* fpga;
     LMS7002M* lms;
@@ -0,0 +1,82 @@
+/**
+    @file TransferQueue.h
+    @brief Stream transfers in flight on one endpoint, finished in completion order
+*/
+
+#ifndef LMS_TRANSFER_QUEUE_H
+#define LMS_TRANSFER_QUEUE_H
+
+#include <stdint.h>
+#include <deque>
+#include <vector>
+
+namespace lime
+{
+
+class IConnection;
+
+/*!
+ * Buffers of a streaming loop and the transfers using them. Buffers are kept
+ * on a free list, a finished transfer frees its buffer without waiting for
+ * older ones. Connections with a completion queue report finished transfers
+ * in batches in completion order, others are waited for oldest first.
+ */
+class TransferQueue
+{
+public:
+    struct Completion
+    {
+        char* buffer;
+        uint32_t length;  //!< bytes requested
+        int transferred;  //!< bytes transferred
+        uint64_t due_us;  //!< expected completion time given to Submit()
+    };
+
+    //! @param count number of buffers of bufferSize bytes
+    TransferQueue(IConnection* port, bool tx, int epIndex, char* buffers, uint32_t bufferSize, uint32_t count);
+
+    inline uint32_t InFlight() const {return mInFlight;}
+
+    //! @return free buffer, nullptr if all are in flight
+    char* Acquire();
+    //! @brief Returns acquired buffer that was not submitted
+    void Release(char* buffer);
+    /** @brief Begins transfer of the buffer
+        @param due_us expected completion time, reported back with the completion
+        @return true if transfer was begun, otherwise the buffer is free again
+    */
+    bool Submit(char* buffer, uint32_t length, uint64_t due_us);
+
+    /** @brief Waits for finished transfers and frees their buffers
+        Buffers keep the data until they are acquired again.
+        @return number of completions, 0 on timeout
+    */
+    int Wait(Completion* done, uint32_t count, unsigned timeout_ms);
+
+    //! @brief Aborts transfers in flight, all buffers are free afterwards
+    void Abort();
+
+private:
+    struct Slot
+    {
+        int buffer; //!< -1 when handle is not in flight
+        uint32_t length;
+        uint64_t due_us;
+    };
+
+    IConnection* mPort;
+    const bool mTx;
+    const int mEpIndex;
+    char* const mBuffers;
+    const uint32_t mBufferSize;
+    const uint32_t mCount;
+    bool mQueued; //!< connection reports completions, cleared when it turns out it does not
+    uint32_t mInFlight;
+    std::vector<int> mFree;
+    std::vector<Slot> mSlots; //!< by transfer handle
+    std::deque<int> mOrder;   //!< handles in submission order
+    std::vector<int> mHandles;
+};
+
+}
+#endif
@@ -0,0 +1,105 @@
+/**
+    @file TriggerEngine.h
+    @brief Per packet trigger evaluation of received samples
+*/
+
+#ifndef LMS_TRIGGER_ENGINE_H
+#define LMS_TRIGGER_ENGINE_H
+
+#include "dataTypes.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace lime
+{
+
+class RingFIFO;
+
+/*!
+ * Gates received samples of one Rx channel. While armed, packets are evaluated
+ * in the Rx loop and only windows of preTrigger samples before and postTrigger
+ * samples after each trigger reach the channel FIFO. Samples before the trigger
+ * are kept in a ring owned by the engine, the first packet of every window is
+ * flagged RingFIFO::TRIGGERED and windows carry their own timestamps.
+ */
+class TriggerEngine
+{
+public:
+    struct Config
+    {
+        enum Mode
+        {
+            MODE_OFF,         //!< all samples go to FIFO
+            MODE_POWER,       //!< mean power of a packet above threshold, triggers at packet start
+            MODE_EDGE,        //!< first sample rising above threshold after being below it
+            MODE_CORRELATION, //!< normalized correlation with pattern above threshold
+        } mode;
+        float threshold;      //!< dBFS for power and edge modes, 0..1 for correlation
+        uint32_t preTrigger;  //!< samples delivered before the trigger
+        uint32_t postTrigger; //!< samples delivered from the trigger on
+        bool singleShot;      //!< deliver only the first window until configured again
+        std::vector<complex16_t> pattern; //!< correlation pattern, at most kernels::maxCorrelationLength samples
+    };
+
+    TriggerEngine();
+
+    //! @brief Sets new configuration, applied by the Rx thread before its next packet
+    void Configure(const Config &config);
+
+    //! @return number of windows delivered since the last Configure()
+    uint32_t Triggers() const;
+
+    //! Rx thread: applies pending configuration, true if packets have to go through Process()
+    bool Armed();
+
+    /** @brief Rx thread: evaluates a received packet and writes what belongs to trigger windows to fifo
+        Only window samples take FIFO space, so packets outside windows never push out stored windows.
+        @param samples packet samples, not in a FIFO slot
+        @param count number of samples
+        @param timestamp timestamp of the first sample
+        @param flags FIFO flags of the packet
+        @return false if FIFO did not take all samples of a window
+    */
+    bool Process(RingFIFO* fifo, const complex16_t* samples, uint32_t count, uint64_t timestamp, uint32_t flags);
+
+private:
+    enum State
+    {
+        STATE_IDLE,
+        STATE_CAPTURE,
+        STATE_DONE,
+    };
+
+    void Apply();
+    bool Detect(const complex16_t* samples, uint32_t count, int* trigger);
+    void KeepHistory(const complex16_t* samples, uint32_t count, uint64_t timestamp);
+    bool Push(RingFIFO* fifo, const complex16_t* samples, uint32_t count, uint64_t timestamp, uint32_t flags);
+    bool StartWindow(RingFIFO* fifo, const complex16_t* samples, uint32_t count, uint64_t timestamp, uint32_t flags, int trigger);
+
+    std::mutex mConfigLock;
+    Config mPendingConfig;
+    std::atomic<bool> mConfigPending;
+    std::atomic<uint32_t> mTriggers;
+
+    //Rx thread only
+    Config mConfig;
+    State mState;
+    uint64_t mThresholdEnergy; //!< power modes, per sample
+    double mPatternEnergy;
+    uint32_t mRemaining;       //!< samples of the current window still to deliver
+    bool mBelow;               //!< edge mode: signal was below threshold
+    bool mMarkWindow;          //!< next pushed packet starts a window
+    //samples before the current packet, pre-trigger plus correlation length
+    std::vector<complex16_t> mHistory;
+    uint32_t mHistoryPos;
+    uint32_t mHistoryFill;
+    uint64_t mHistoryEnd;      //!< timestamp following the newest kept sample
+    //correlation input (end of history followed by the packet) and results
+    std::vector<complex16_t> mCorrInput;
+    std::vector<int32_t> mCorrRe;
+    std::vector<int32_t> mCorrIm;
+};
+
+}
+#endif
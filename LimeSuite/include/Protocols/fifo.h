@@ -9,11 +9,91 @@
 #include <queue>
 #include <condition_variable>
 #include "dataTypes.h"
+#include "StreamBuffer.h"
 #include <cmath>
+#include <chrono>
+#include <climits>
+#include <algorithm>
+#include <string.h>
 #include <assert.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 namespace lime{
 
+/*!
+ * Waiting primitive of RingFIFO. On Linux the waiting side sleeps on a futex
+ * and is woken by the other side, elsewhere it falls back to short sleeps.
+ */
+class FIFOWaitWord
+{
+public:
+    FIFOWaitWord() : mSeq(0), mWaiting(0) {}
+
+    //! @return current sequence, to be passed to Wait() after re-checking the condition
+    inline uint32_t Prepare()
+    {
+        const uint32_t seq = mSeq.load(std::memory_order_acquire);
+        mWaiting.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return seq;
+    }
+
+    inline void Wait(uint32_t seq, uint32_t timeout_us)
+    {
+#ifdef __linux__
+        struct timespec ts;
+        ts.tv_sec = timeout_us / 1000000;
+        ts.tv_nsec = (timeout_us % 1000000) * 1000;
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&mSeq), FUTEX_WAIT_PRIVATE, seq, &ts, nullptr, 0);
+#else
+        if (mSeq.load(std::memory_order_acquire) == seq)
+            std::this_thread::sleep_for(std::chrono::microseconds(timeout_us < 200 ? timeout_us : 200));
+#endif
+        mWaiting.store(0, std::memory_order_relaxed);
+    }
+
+    //! Withdraws Prepare() when the condition became true in the meantime
+    inline void Cancel()
+    {
+        mWaiting.store(0, std::memory_order_relaxed);
+    }
+
+    //! Wakes the other side, costs only a load when nobody is waiting
+    inline void Notify()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (mWaiting.load(std::memory_order_relaxed) == 0)
+            return;
+        mWaiting.store(0, std::memory_order_relaxed);
+        mSeq.fetch_add(1, std::memory_order_release);
+#ifdef __linux__
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&mSeq), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#endif
+    }
+
+private:
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex needs a plain 32-bit word");
+    std::atomic<uint32_t> mSeq;
+    std::atomic<uint32_t> mWaiting;
+};
+
+/*!
+ * Single producer, single consumer lock-free ring of sample packets.
+ * Head and tail are monotonic 64-bit packet indices on separate cache lines,
+ * the slot of an index is index & (mBufferSize-1).
+ * Packet headers and samples are stored in two arrays, the samples slab holds
+ * mPacketSamples per slot so that packets are sized to what one link packet
+ * carries for the channel instead of the largest possible packet.
+ * With OVERWRITE_OLD the producer drops the oldest packet by advancing the
+ * head itself, the consumer detects that by validating the head after copying.
+ * The ring can be bigger than the FIFO capacity, the extra slots keep packets
+ * that were already read until the producer wraps around to them, so they can
+ * be looked up by timestamp with ReadHistory() at no cost to the stream itself.
+ */
 class RingFIFO
 {
 public:
@@ -22,6 +102,7 @@ public:
     {
         uint32_t size;
         uint32_t itemsFilled;
+        uint32_t highWater; //!< most items filled since last Clear()
     };
     
     enum StreamFlags
@@ -29,31 +110,54 @@ public:
         SYNC_TIMESTAMP = 1,
         END_BURST = 2,
         OVERWRITE_OLD = 4,
+        GAP_FILLED = 8, //!< zero samples inserted in place of lost packets
+        TRIGGERED = 16, //!< first packet of a trigger window, see TriggerEngine
     };
 
     //! @brief Returns information about FIFO size and fullness
     BufferInfo GetInfo()
     {
-        std::unique_lock<std::mutex> lck(lock);
         BufferInfo stats;
-        stats.size = mBufferSize*mBuffer->maxSamplesInPacket;
-        stats.itemsFilled = mElementsFilled*mBuffer->maxSamplesInPacket;
+        const uint64_t head = mHead.load(std::memory_order_acquire);
+        const uint64_t tail = mTail.load(std::memory_order_acquire);
+        stats.size = mCapacity*mPacketSamples;
+        stats.itemsFilled = (tail > head ? tail - head : 0)*mPacketSamples;
+        stats.highWater = mHighWater.load(std::memory_order_relaxed)*mPacketSamples;
         return stats;
     }
 
-    //!    @brief Initializes FIFO memory
-    RingFIFO(const uint32_t bufLength) : mBufferSize(1+(bufLength-1)/mBuffer->maxSamplesInPacket)
+    /** @brief Initializes FIFO memory
+        @param bufLength number of samples to hold, rounded up to a power of two number of packets
+        @param packetSamples capacity of one packet
+        @param historyLength number of already read samples to keep for ReadHistory()
+    */
+    RingFIFO(const uint32_t bufLength, const uint32_t packetSamples = SamplesPacket::maxSamplesInPacket, const uint64_t historyLength = 0) :
+        mPacketSamples(packetSamples), mCapacity(PacketsCount(bufLength, packetSamples)),
+        mBufferSize(historyLength ? PacketsCount(bufLength, packetSamples, historyLength) : mCapacity)
     {
-        mBuffer = new SamplesPacket[mBufferSize];
-        Clear();
+        //stream buffers come zero initialized, samples are placed on the node of the first writer
+        mPacketsBuffer.Allocate(sizeof(PacketHeader)*mBufferSize);
+        mSamplesBuffer.Allocate(sizeof(complex16_t)*mBufferSize*mPacketSamples);
+        mPackets = static_cast<PacketHeader*>(mPacketsBuffer.data());
+        mSamples = static_cast<complex16_t*>(mSamplesBuffer.data());
+        mHead.store(0);
+        mTail.store(0);
+        mHighWater.store(0);
+        mHistoryStart.store(0);
+        mInterrupted.store(false);
+        mEvent.store(nullptr);
+        mEventUsers.store(0);
+        mReadIndex = 0;
+        mReadOffset = 0;
     }
 
-    ~RingFIFO()
+    //! @brief Number of samples one packet can hold
+    uint32_t PacketSamples() const
     {
-        delete []mBuffer;
-    };
+        return mPacketSamples;
+    }
 
-    /** @brief inserts samples to FIFO, operation is thread-safe
+    /** @brief inserts samples to FIFO, must be called only from one thread at a time
     @param buffer pointers to arrays containing samples data of each channel
     @param samplesCount number of samples to insert from each buffer channel
     @param channelsCount number of channels to insert
@@ -66,51 +170,50 @@ public:
     {
         assert(buffer != nullptr);
         uint32_t samplesTaken = 0;
-        std::unique_lock<std::mutex> lck(lock);
-        auto t1 = std::chrono::high_resolution_clock::now();
+        const auto t1 = std::chrono::steady_clock::now();
         while (samplesTaken < samplesCount)
         {
-            if (mElementsFilled >= mBufferSize) //buffer might be full, wait for free slots
-            {
-                auto t2 = std::chrono::high_resolution_clock::now();
-                if(t2-t1 >= std::chrono::milliseconds(timeout_ms))
-                    return samplesTaken;
-                if(flags & OVERWRITE_OLD)
-                {
-                    int dropElements = 1+(samplesCount-samplesTaken)/SamplesPacket::maxSamplesInPacket;
-                    mHead = (mHead + dropElements) & (mBufferSize - 1);//advance to next one
-                    mElementsFilled -= dropElements;
-                }
-                else  //there is no space, wait on CV to give pop_samples the thread context
-                {
-                    hasItems.wait_for(lck, std::chrono::milliseconds(timeout_ms));
-                }
-            }
-            else
+            if (!WaitForSpace(flags & OVERWRITE_OLD, t1, timeout_ms))
+                break;
+
+            uint32_t cnt = samplesCount-samplesTaken;
+            uint32_t pktFlags = flags;
+            if (cnt > mPacketSamples)
             {
-                mBuffer[mTail].timestamp = timestamp + samplesTaken;
-                int cnt = samplesCount-samplesTaken;
-                if (cnt > SamplesPacket::maxSamplesInPacket)
-                {
-                    cnt = SamplesPacket::maxSamplesInPacket;
-                    mBuffer[mTail].flags = flags & SYNC_TIMESTAMP;
-                }
-                else
-                    mBuffer[mTail].flags = flags;
-                memcpy(mBuffer[mTail].samples,&buffer[samplesTaken],cnt*sizeof(complex16_t));
-                samplesTaken+=cnt;
-                mBuffer[mTail].last = cnt;
-                mBuffer[mTail++].first = 0;
-                mTail  &= (mBufferSize - 1);//advance to next one
-                ++mElementsFilled;
+                cnt = mPacketSamples;
+                pktFlags = flags & SYNC_TIMESTAMP;
             }
+            memcpy(SlotSamples(mTail.load(std::memory_order_relaxed)), &buffer[samplesTaken], cnt*sizeof(complex16_t));
+            Publish(cnt, timestamp + samplesTaken, pktFlags);
+            samplesTaken+=cnt;
         }
-        lck.unlock();
-        hasItems.notify_one();
+        mItemsAvailable.Notify();
+        NotifyEvent();
         return samplesTaken;
     }
 
-    /** @brief Takes samples out of FIFO, operation is thread-safe
+    /** @brief Borrows the next free packet slot for writing samples in place, producer side
+        @param timeout_ms how long to wait for a free slot
+        @param overwrite drop the oldest packet instead of waiting when FIFO is full
+        @return slot for up to PacketSamples() samples, nullptr on timeout
+    */
+    complex16_t* AcquireWrite(const uint32_t timeout_ms, const bool overwrite = false)
+    {
+        if (!WaitForSpace(overwrite, std::chrono::steady_clock::now(), timeout_ms))
+            return nullptr;
+        return SlotSamples(mTail.load(std::memory_order_relaxed));
+    }
+
+    //! @brief Publishes the slot returned by AcquireWrite() with samplesCount samples
+    void CommitWrite(const uint32_t samplesCount, const uint64_t timestamp, const uint32_t flags = 0)
+    {
+        assert(samplesCount <= mPacketSamples);
+        Publish(samplesCount, timestamp, flags);
+        mItemsAvailable.Notify();
+        NotifyEvent();
+    }
+
+    /** @brief Takes samples out of FIFO, must be called only from one thread at a time
         @param buffer pointers to destination arrays for each channel's samples data, each array must be big enough to contain \samplesCount number of samples.
         @param samplesCount number of samples to pop
         @param channelsCount number of channels to pop
@@ -123,68 +226,360 @@ public:
     {
         assert(buffer != nullptr);
         uint32_t samplesFilled = 0;
-        if (flags != nullptr) *flags = 0;
-        std::unique_lock<std::mutex> lck(lock);
+        uint32_t flagsFilled = 0;
+        const auto t1 = std::chrono::steady_clock::now();
         while (samplesFilled < samplesCount)
         {
-            while (mElementsFilled == 0) //buffer might be empty, wait for packets
-            {
-                if (timeout_ms == 0)
-                    return samplesFilled;
-                if (hasItems.wait_for(lck, std::chrono::milliseconds(timeout_ms)) == std::cv_status::timeout)
-                    return samplesFilled;
-            }
+            if (!WaitForItems(t1, timeout_ms))
+                break;
+
+            uint32_t cnt;
+            uint64_t pktTimestamp;
+            uint32_t pktFlags;
+            const complex16_t* src = PeekHead(&cnt, &pktTimestamp, &pktFlags);
+            if (src == nullptr)
+                continue;
+            //trigger windows are not contiguous in time, each one starts a new read
+            if ((pktFlags & TRIGGERED) && samplesFilled > 0)
+                break;
+            if (cnt > samplesCount - samplesFilled)
+                cnt = samplesCount - samplesFilled;
+            memcpy(&buffer[samplesFilled], src, cnt*sizeof(complex16_t));
+            if (!Consume(cnt))
+                continue; //packet was dropped while it was copied
+
             if(samplesFilled == 0 && timestamp != nullptr)
-                *timestamp = mBuffer[mHead].timestamp + mBuffer[mHead].first;
+                *timestamp = pktTimestamp;
+            flagsFilled |= pktFlags;
+            samplesFilled += cnt;
 
-            while(mElementsFilled > 0 && samplesFilled < samplesCount)
-            {
-                const bool hasEOB = mBuffer[mHead].flags & END_BURST;
-                if (flags != nullptr) *flags |= mBuffer[mHead].flags;
-                const int first = mBuffer[mHead].first;
+            //leave the loop early when end of burst is encountered
+            //so that the calling loop can flush out the buffer
+            if (pktFlags & END_BURST)
+                break;
+        }
+        if (flags != nullptr) *flags = flagsFilled;
+        mSpaceAvailable.Notify();
+        NotifyEvent();
+        return samplesFilled;
+    }
+
+    /** @brief Borrows the unread samples of the oldest packet without copying, consumer side
+        @param samplesCount returns number of samples available at the returned pointer
+        @param timestamp returns timestamp of the first returned sample
+        @param flags returns flags of the packet
+        @param timeout_ms how long to wait for a packet
+        @return pointer to samples, valid until ReleaseRead(), nullptr on timeout
+    */
+    const complex16_t* AcquireRead(uint32_t* samplesCount, uint64_t* timestamp, uint32_t* flags, const uint32_t timeout_ms)
+    {
+        const auto t1 = std::chrono::steady_clock::now();
+        while (WaitForItems(t1, timeout_ms))
+        {
+            const complex16_t* src = PeekHead(samplesCount, timestamp, flags);
+            if (src != nullptr)
+                return src;
+        }
+        return nullptr;
+    }
 
-                int cnt = samplesCount - samplesFilled;
-                const int cntbuf = mBuffer[mHead].last - first;
-                cnt = cnt > cntbuf ? cntbuf : cnt;
+    /** @brief Returns samplesCount samples borrowed by AcquireRead() to the FIFO
+        @return false if the packet was overwritten while borrowed, the samples have to be discarded then
+    */
+    bool ReleaseRead(const uint32_t samplesCount)
+    {
+        const bool valid = Consume(samplesCount);
+        mSpaceAvailable.Notify();
+        NotifyEvent();
+        return valid;
+    }
 
-                memcpy(&buffer[samplesFilled],&mBuffer[mHead].samples[first],cnt*sizeof(complex16_t));
-                samplesFilled += cnt;
+    /** @brief Copies received samples by timestamp, including already read ones kept as history
+        Can be called from any thread, does not affect the consumer. The newest FIFO capacity
+        worth of the ring is not used, so that the producer can not overwrite packets while they are copied.
+        @param timestamp timestamp of the first wanted sample
+        @param buffer destination, buffer[i] is the sample at *firstTimestamp + i
+        @param samplesCount number of samples wanted
+        @param firstTimestamp returns timestamp of buffer[0], later than timestamp if older data is gone
+        @return number of samples copied, fewer if the range is not received yet,
+                samples missing between packets are filled with zeros
+    */
+    uint32_t ReadHistory(const uint64_t timestamp, complex16_t* buffer, const uint32_t samplesCount, uint64_t* firstTimestamp)
+    {
+        const int attempts = 4;
+        for (int attempt = 0; attempt < attempts; ++attempt)
+        {
+            const uint64_t tail = mTail.load(std::memory_order_acquire);
+            uint64_t oldest = tail + mCapacity > mBufferSize ? tail + mCapacity - mBufferSize : 0;
+            oldest = std::max(oldest, mHistoryStart.load(std::memory_order_acquire));
+            if (oldest >= tail)
+                return 0;
 
-                if (cntbuf == cnt) //packet depleated
-                {
-                    mHead = (mHead + 1) & (mBufferSize - 1);//advance to next one
-                    --mElementsFilled;
-                }
+            //first packet that ends after timestamp
+            uint64_t lo = oldest, hi = tail;
+            while (lo < hi)
+            {
+                const uint64_t mid = lo + (hi - lo) / 2;
+                const PacketHeader &pkt = mPackets[mid & (mBufferSize - 1)];
+                if (pkt.timestamp + pkt.last <= timestamp)
+                    lo = mid + 1;
                 else
-                    mBuffer[mHead].first += cnt;
+                    hi = mid;
+            }
+            const uint64_t start = std::max(timestamp, mPackets[oldest & (mBufferSize - 1)].timestamp);
 
-                //leave the loop early when end of burst is encountered
-                //so that the calling loop can flush out the buffer
-                if (hasEOB) goto done;
+            uint32_t filled = 0;
+            bool valid = true;
+            for (uint64_t index = lo; index < tail && filled < samplesCount; )
+            {
+                const PacketHeader &pkt = mPackets[index & (mBufferSize - 1)];
+                const uint64_t at = start + filled;
+                if (pkt.last > mPacketSamples || pkt.timestamp + pkt.last <= at)
+                {
+                    valid = false; //packet changed under us
+                    break;
+                }
+                if (pkt.timestamp > at) //gap between packets
+                {
+                    const uint32_t cnt = std::min<uint64_t>(pkt.timestamp - at, samplesCount - filled);
+                    memset(&buffer[filled], 0, cnt*sizeof(complex16_t));
+                    filled += cnt;
+                    continue;
+                }
+                const uint32_t offset = at - pkt.timestamp;
+                const uint32_t cnt = std::min(pkt.last - offset, samplesCount - filled);
+                memcpy(&buffer[filled], SlotSamples(index) + offset, cnt*sizeof(complex16_t));
+                filled += cnt;
+                ++index;
+            }
+            //producer must not have reached the oldest slot that was looked at
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (valid && mTail.load(std::memory_order_acquire) < oldest + mBufferSize)
+            {
+                *firstTimestamp = start;
+                return filled;
             }
         }
-        done:
-        lck.unlock();
-        hasItems.notify_one();
-        return samplesFilled;
+        return 0;
     }
 
+    //! Drops all packets, acts as the consumer
     void Clear()
     {
-        std::unique_lock<std::mutex> lck(lock);
-        mHead = 0;
-        mTail = 0;
-        mElementsFilled = 0;
+        uint64_t head = mHead.load(std::memory_order_acquire);
+        while (!mHead.compare_exchange_weak(head, mTail.load(std::memory_order_acquire), std::memory_order_acq_rel));
+        mReadIndex = mHead.load(std::memory_order_relaxed);
+        mReadOffset = 0;
+        mHighWater.store(0, std::memory_order_relaxed);
+        //history before a restart may have unrelated timestamps
+        mHistoryStart.store(mTail.load(std::memory_order_acquire), std::memory_order_release);
+        mInterrupted.store(false, std::memory_order_release);
+        mSpaceAvailable.Notify();
+    }
+
+    /** @brief Sets an additional wait word notified whenever packets are published or released
+        Lets one thread wait for many FIFOs at once, see StreamExecutor. nullptr removes it.
+        Returns after notifiers that still hold the previous event are done with it,
+        so the event can be destroyed afterwards.
+    */
+    void SetEvent(FIFOWaitWord* event)
+    {
+        mEvent.store(event, std::memory_order_seq_cst);
+        while (mEventUsers.load(std::memory_order_seq_cst) != 0)
+            std::this_thread::yield();
+    }
+
+    //! @brief Wakes waiting producer and consumer, waits keep failing until Clear()
+    void Interrupt()
+    {
+        mInterrupted.store(true, std::memory_order_release);
+        mItemsAvailable.Notify();
+        mSpaceAvailable.Notify();
     }
 
 protected:
-    const uint32_t mBufferSize;
-    SamplesPacket* mBuffer;
-    uint32_t mHead;
-    uint32_t mTail;
-    uint32_t mElementsFilled;
-    std::mutex lock;
-    std::condition_variable hasItems;
+    inline void NotifyEvent()
+    {
+        if (mEvent.load(std::memory_order_relaxed) == nullptr)
+            return;
+        //counted before loading the event again, SetEvent() waits until it drops to zero
+        mEventUsers.fetch_add(1, std::memory_order_seq_cst);
+        FIFOWaitWord* event = mEvent.load(std::memory_order_seq_cst);
+        if (event != nullptr)
+            event->Notify();
+        mEventUsers.fetch_sub(1, std::memory_order_release);
+    }
+
+    //! Producer: waits until the slot at tail is free, or frees it by dropping the oldest packet
+    bool WaitForSpace(const bool overwrite, const std::chrono::steady_clock::time_point &t1, const uint32_t timeout_ms)
+    {
+        const uint64_t tail = mTail.load(std::memory_order_relaxed);
+        while (true)
+        {
+            uint64_t head = mHead.load(std::memory_order_acquire);
+            if (tail - head < mCapacity)
+                return true;
+            if(overwrite)
+            {
+                //drop the oldest packet, fails if consumer just took it
+                mHead.compare_exchange_strong(head, head+1, std::memory_order_acq_rel);
+                continue;
+            }
+            //let the consumer see what was written so far, then wait for free slots
+            mItemsAvailable.Notify();
+            const uint32_t seq = mSpaceAvailable.Prepare();
+            if (tail - mHead.load(std::memory_order_acquire) < mCapacity)
+            {
+                mSpaceAvailable.Cancel();
+                return true;
+            }
+            const uint32_t remaining_us = RemainingMicroseconds(t1, timeout_ms);
+            if (remaining_us == 0 || mInterrupted.load(std::memory_order_acquire))
+            {
+                mSpaceAvailable.Cancel();
+                return false;
+            }
+            mSpaceAvailable.Wait(seq, remaining_us);
+        }
+    }
+
+    //! Producer: fills in packet info of the slot at tail and makes it visible to the consumer
+    void Publish(const uint32_t samplesCount, const uint64_t timestamp, const uint32_t flags)
+    {
+        uint64_t tail = mTail.load(std::memory_order_relaxed);
+        PacketHeader &pkt = mPackets[tail & (mBufferSize - 1)];
+        pkt.timestamp = timestamp;
+        pkt.flags = flags;
+        pkt.last = samplesCount;
+        mTail.store(++tail, std::memory_order_release);
+
+        const uint64_t filled = tail - mHead.load(std::memory_order_relaxed);
+        if (filled > mHighWater.load(std::memory_order_relaxed))
+            mHighWater.store(filled, std::memory_order_relaxed);
+    }
+
+    //! Consumer: waits until at least one packet is available
+    bool WaitForItems(const std::chrono::steady_clock::time_point &t1, const uint32_t timeout_ms)
+    {
+        while (true)
+        {
+            const uint64_t head = mHead.load(std::memory_order_acquire);
+            if (mTail.load(std::memory_order_acquire) != head)
+                return true;
+            const uint32_t seq = mItemsAvailable.Prepare();
+            if (mTail.load(std::memory_order_acquire) != head)
+            {
+                mItemsAvailable.Cancel();
+                return true;
+            }
+            const uint32_t remaining_us = RemainingMicroseconds(t1, timeout_ms);
+            if (remaining_us == 0 || mInterrupted.load(std::memory_order_acquire))
+            {
+                mItemsAvailable.Cancel();
+                return false;
+            }
+            mItemsAvailable.Wait(seq, remaining_us);
+        }
+    }
+
+    //! Consumer: unread samples of the head packet, nullptr if it is being overwritten
+    const complex16_t* PeekHead(uint32_t* samplesCount, uint64_t* timestamp, uint32_t* flags)
+    {
+        const uint64_t head = mHead.load(std::memory_order_acquire);
+        if (head != mReadIndex) //previous packet was consumed or dropped
+        {
+            mReadIndex = head;
+            mReadOffset = 0;
+        }
+        const PacketHeader &pkt = mPackets[head & (mBufferSize - 1)];
+        const int cntbuf = int(pkt.last) - int(mReadOffset);
+        if (cntbuf <= 0 || cntbuf > int(mPacketSamples))
+            return nullptr; //packet is being overwritten, head has moved on
+        *samplesCount = cntbuf;
+        if (timestamp != nullptr)
+            *timestamp = pkt.timestamp + mReadOffset;
+        if (flags != nullptr)
+            *flags = pkt.flags;
+        return SlotSamples(head) + mReadOffset;
+    }
+
+    //! Consumer: marks samples of the head packet as read, false if producer dropped the packet meanwhile
+    bool Consume(const uint32_t samplesCount)
+    {
+        uint64_t head = mReadIndex;
+        //validate that producer did not drop this packet while it was read
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (mReadOffset + samplesCount >= mPackets[head & (mBufferSize - 1)].last) //packet depleated
+        {
+            if (!mHead.compare_exchange_strong(head, head+1, std::memory_order_acq_rel))
+                return false;
+            mReadIndex = head+1;
+            mReadOffset = 0;
+        }
+        else
+        {
+            if (mHead.load(std::memory_order_relaxed) != head)
+                return false;
+            mReadOffset += samplesCount;
+        }
+        return true;
+    }
+
+    //! Number of packets needed for bufLength samples (and history on top of them), rounded up to a power of two
+    static uint32_t PacketsCount(const uint32_t bufLength, const uint32_t packetSamples, const uint64_t historyLength = 0)
+    {
+        const uint64_t packets = (bufLength ? 1+(bufLength-1)/packetSamples : 1) + (historyLength+packetSamples-1)/packetSamples;
+        uint32_t count = 1;
+        while (count < packets)
+            count <<= 1;
+        return count;
+    }
+
+    static uint32_t RemainingMicroseconds(const std::chrono::steady_clock::time_point &start, const uint32_t timeout_ms)
+    {
+        const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        const int64_t remaining = int64_t(timeout_ms)*1000 - elapsed;
+        return remaining > 0 ? remaining : 0;
+    }
+
+    //padding keeps producer and consumer data on separate cache lines,
+    //the FIFO is heap allocated so alignas() would not be honoured before C++17
+    static const int cacheLine = 64;
+
+    inline complex16_t* SlotSamples(const uint64_t index) const
+    {
+        return mSamples + size_t(index & (mBufferSize - 1))*mPacketSamples;
+    }
+
+    struct PacketHeader
+    {
+        uint64_t timestamp;
+        uint32_t last; //!< number of samples in packet
+        uint32_t flags;
+    };
+
+    const uint32_t mPacketSamples;
+    const uint32_t mCapacity; //!< packets the FIFO holds
+    const uint32_t mBufferSize; //!< ring slots, capacity and history
+    StreamBuffer mPacketsBuffer;
+    StreamBuffer mSamplesBuffer;
+    PacketHeader* mPackets;
+    complex16_t* mSamples;
+    char mPad0[cacheLine];
+    std::atomic<uint64_t> mHead; //!< next packet to read, written by consumer (and producer when overwriting)
+    FIFOWaitWord mSpaceAvailable;
+    //consumer only
+    uint64_t mReadIndex; //!< packet that mReadOffset belongs to
+    uint32_t mReadOffset; //!< samples already read from packet mReadIndex
+    char mPad1[cacheLine];
+    std::atomic<uint64_t> mTail; //!< next packet to write, written by producer
+    std::atomic<uint32_t> mHighWater;
+    std::atomic<uint64_t> mHistoryStart; //!< first packet ReadHistory() may return
+    std::atomic<bool> mInterrupted; //!< set by Interrupt(), waits return at once
+    std::atomic<FIFOWaitWord*> mEvent;
+    std::atomic<uint32_t> mEventUsers; //!< NotifyEvent() calls that may hold mEvent
+    FIFOWaitWord mItemsAvailable;
+    char mPad2[cacheLine];
 };
 
 //https://www.justsoftwaresolutions.co.uk/threading/implementing-a-thread-safe-queue-using-condition-variables.html
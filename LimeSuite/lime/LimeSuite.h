@@ -1110,6 +1110,33 @@ typedef struct
 
 } lms_stream_status_t;
 
+/**Streaming telemetry structure. Unlike ::lms_stream_status_t, the counters
+ * are cumulative since LMS_SetupStream() and are not reset by reading them.*/
+typedef struct
+{
+    ///Indicates whether the stream is currently active
+    bool active;
+    ///Number of samples in FIFO buffer
+    uint32_t fifoFilledCount;
+    ///Size of FIFO buffer
+    uint32_t fifoSize;
+    ///Highest number of samples in FIFO buffer since the stream was started
+    uint32_t fifoHighWater;
+    ///Total FIFO underrun count
+    uint32_t underrun;
+    ///Total FIFO overrun count
+    uint32_t overrun;
+    ///Total number of dropped packets by HW
+    uint32_t droppedPackets;
+    ///Total bytes transferred by all streams of the same direction (TX or RX)
+    uint64_t linkBytes;
+    ///Combined data rate of all stream of the same direction (TX or RX)
+    float_type linkRate;
+    ///Current HW timestamp
+    uint64_t timestamp;
+
+} lms_stream_telemetry_t;
+
 /**
  * Create new stream based on parameters passed in configuration structure.
  * The structure is initialized with stream handle.
@@ -1164,6 +1191,26 @@ API_EXPORT int CALL_CONV LMS_StopStream(lms_stream_t *stream);
  API_EXPORT int CALL_CONV LMS_RecvStream(lms_stream_t *stream, void *samples,
              size_t sample_count, lms_stream_meta_t *meta, unsigned timeout_ms);
 
+/**
+ * Read timestamp aligned blocks of equal size from several Rx streams of the
+ * same device in one call, e.g. both channels of MIMO configuration.
+ * Sample i of every block has timestamp meta->timestamp + i. Reading starts at
+ * the newest data among the streams, positions missing in a stream because of
+ * lost or overwritten packets are filled with zeros. Samples are taken from
+ * FIFOs only when all streams have them, so streams stay aligned after a timeout.
+ *
+ * @param streams       array of Rx streams initialized with LMS_SetupStream().
+ * @param stream_count  number of streams.
+ * @param samples       array of sample buffers, one per stream.
+ * @param sample_count  number of samples to read for each stream.
+ * @param meta          Metadata, returns timestamp of the blocks.
+ * @param timeout_ms    how long to wait for data before timing out.
+ *
+ * @return number of samples received for each stream, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_RecvStreamAligned(lms_stream_t **streams, size_t stream_count,
+             void **samples, size_t sample_count, lms_stream_meta_t *meta, unsigned timeout_ms);
+
 /**
  * Get stream operation status
  *
@@ -1174,6 +1221,305 @@ API_EXPORT int CALL_CONV LMS_StopStream(lms_stream_t *stream);
  */
 API_EXPORT int CALL_CONV LMS_GetStreamStatus(lms_stream_t *stream, lms_stream_status_t* status);
 
+/**
+ * Get cumulative stream health counters. Safe to call periodically while the
+ * stream is running, it does not reset the counters of LMS_GetStreamStatus().
+ *
+ * @param stream    structure previously initialized with LMS_SetupStream().
+ * @param telemetry Stream telemetry. See the ::lms_stream_telemetry_t for description
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_GetStreamTelemetry(lms_stream_t *stream, lms_stream_telemetry_t* telemetry);
+
+/**
+ * Set scale and DC offset applied to ::LMS_FMT_F32 stream samples.
+ * Receive streams convert as float = int16*scale + offset,
+ * transmit streams as int16 = float*scale + offset with saturation.
+ * LMS_SetupStream() resets them to scale 1/32767 (Rx) or 32767 (Tx) and zero offset.
+ *
+ * @param stream    structure previously initialized with LMS_SetupStream().
+ * @param scale     conversion scale
+ * @param offset_i  DC offset added to I samples
+ * @param offset_q  DC offset added to Q samples
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_SetStreamFloatConversion(lms_stream_t *stream, float scale, float offset_i, float offset_q);
+
+/**Scheduling policies of streaming threads*/
+#define LMS_SCHED_DEFAULT   0   ///<Normal time-sharing scheduling
+#define LMS_SCHED_FIFO      1   ///<Real-time SCHED_FIFO
+#define LMS_SCHED_RR        2   ///<Real-time SCHED_RR
+
+/**Placement and scheduling of the thread serving a stream*/
+typedef struct
+{
+    ///CPUs the thread may run on, bit n for CPU n, 0 for no restriction
+    uint64_t cpuMask;
+    ///One of LMS_SCHED_* policies
+    int policy;
+    ///Real-time priority for LMS_SCHED_FIFO and LMS_SCHED_RR (1-99 on Linux)
+    int priority;
+} lms_stream_thread_t;
+
+/**
+ * Set CPU affinity and scheduling policy of the thread serving the stream
+ * (Rx or Tx thread and its helpers). Has to be called after LMS_SetupStream(),
+ * takes effect when the thread is started. Streams of the same direction share
+ * one thread, the first stream with options set determines them.
+ * Real-time policies usually need CAP_SYS_NICE or an rtprio limit, failures
+ * are logged and the thread runs with default scheduling.
+ *
+ * @param stream    structure previously initialized with LMS_SetupStream().
+ * @param options   thread options
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_SetStreamThreadOptions(lms_stream_t *stream, const lms_stream_thread_t *options);
+
+/**
+ * Set how many USB transfers the thread serving a stream may keep in flight.
+ * Deeper queues tolerate longer scheduling delays at high sample rates.
+ * Like thread options it takes effect when the thread is started, streams of
+ * the same direction share the deepest requested queue. The connection limits
+ * the depth, see LMS_GetStreamTransferStats() for the one in use.
+ *
+ * @param stream    structure previously initialized with LMS_SetupStream().
+ * @param depth     number of transfers, 0 for connection default
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_SetStreamTransferDepth(lms_stream_t *stream, unsigned depth);
+
+/**Occupancy of USB transfers of one stream direction*/
+typedef struct
+{
+    ///Transfers that can be in flight
+    uint32_t depth;
+    ///Transfers currently in flight
+    uint32_t inUse;
+    ///Most transfers in flight at once
+    uint32_t highWater;
+    ///Transfers started
+    uint64_t acquired;
+    ///Transfers not started because all were in flight
+    uint32_t exhausted;
+} lms_stream_transfers_t;
+
+/**
+ * Get USB transfer queue occupancy of the stream direction, counted since the
+ * streaming thread started.
+ *
+ * @param stream    structure previously initialized with LMS_SetupStream().
+ * @param stats     transfer statistics. See the ::lms_stream_transfers_t for description
+ *
+ * @return  0 on success, (-1) on failure or if the connection does not keep them
+ */
+API_EXPORT int CALL_CONV LMS_GetStreamTransferStats(lms_stream_t *stream, lms_stream_transfers_t *stats);
+
+/**
+ * Enable zero filling of lost packets on a receive stream. Missing packets
+ * are replaced with zero samples, so timestamps of received samples stay
+ * continuous. Has to be called after LMS_SetupStream().
+ *
+ * @param stream    Rx stream previously initialized with LMS_SetupStream().
+ * @param enable    true to insert zero samples for lost packets
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_SetStreamGapFill(lms_stream_t *stream, bool enable);
+
+#define LMS_LOSS_HISTOGRAM_SIZE 16  ///<Size of ::lms_stream_loss_t histogram
+#define LMS_LOSS_EVENTS_SIZE    16  ///<Number of recent loss events in ::lms_stream_loss_t
+
+/**Packet loss record of a receive stream, cumulative since LMS_SetupStream()*/
+typedef struct
+{
+    ///histogram[n] counts gaps of 2^n to 2^(n+1)-1 packets, last entry also bigger gaps
+    uint32_t histogram[LMS_LOSS_HISTOGRAM_SIZE];
+    ///Number of loss events
+    uint32_t eventsCount;
+    ///Number of zero samples inserted by LMS_SetStreamGapFill()
+    uint64_t filledSamples;
+    ///Number of valid entries in recent events arrays
+    uint32_t recentCount;
+    ///Timestamp of the first missing sample of recent events, oldest first
+    uint64_t recentTimestamp[LMS_LOSS_EVENTS_SIZE];
+    ///Number of packets lost in recent events
+    uint32_t recentPackets[LMS_LOSS_EVENTS_SIZE];
+} lms_stream_loss_t;
+
+/**
+ * Get packet loss histogram and most recent loss events of a receive stream.
+ *
+ * @param stream    Rx stream previously initialized with LMS_SetupStream().
+ * @param loss      loss record. See the ::lms_stream_loss_t for description
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_GetStreamLossStats(lms_stream_t *stream, lms_stream_loss_t *loss);
+
+/**
+ * Keep received samples of a receive stream for LMS_RecvStreamHistory() after
+ * they were read. Has to be called after LMS_SetupStream() while the stream
+ * is stopped, the sample rate has to be set before.
+ *
+ * @param stream    Rx stream previously initialized with LMS_SetupStream().
+ * @param seconds   length of the history, 0 to disable it
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_SetStreamHistory(lms_stream_t *stream, double seconds);
+
+/**
+ * Copy received samples starting at given hardware timestamp, including the
+ * samples already read with LMS_RecvStream(). Does not affect the stream.
+ * Samples missing because of lost packets are filled with zeros.
+ *
+ * @param stream        Rx stream previously initialized with LMS_SetupStream().
+ * @param timestamp     timestamp of the first wanted sample
+ * @param samples       sample buffer.
+ * @param sample_count  number of samples wanted
+ * @param meta          returns timestamp of the first copied sample, later than
+ *                      requested if the older samples are no longer kept
+ *
+ * @return number of samples copied, fewer if they are not received yet, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_RecvStreamHistory(lms_stream_t *stream, uint64_t timestamp,
+             void *samples, size_t sample_count, lms_stream_meta_t *meta);
+
+/**Trigger conditions of receive streams*/
+#define LMS_TRIGGER_OFF         0   ///<All received samples are delivered
+#define LMS_TRIGGER_POWER       1   ///<Mean power of a packet above threshold (dBFS)
+#define LMS_TRIGGER_EDGE        2   ///<Sample power rising above threshold (dBFS)
+#define LMS_TRIGGER_CORRELATION 3   ///<Normalized correlation with pattern above threshold (0-1)
+
+/**Trigger configuration of a receive stream*/
+typedef struct
+{
+    ///One of LMS_TRIGGER_* conditions
+    int mode;
+    ///dBFS for power and edge conditions, 0-1 for correlation
+    float threshold;
+    ///Number of samples delivered before the trigger
+    uint32_t preTrigger;
+    ///Number of samples delivered from the trigger on
+    uint32_t postTrigger;
+    ///Deliver only the first window until the trigger is set again
+    bool singleShot;
+    ///Correlation pattern, interleaved I/Q 16-bit values, scaled internally
+    const int16_t *pattern;
+    ///Number of pattern samples (I/Q pairs), at most 64
+    unsigned patternLength;
+} lms_stream_trigger_t;
+
+/**
+ * Deliver only windows around trigger events of a receive stream. Triggers
+ * are evaluated on every received packet by the streaming thread, other
+ * samples never reach the FIFO. Each window is read separately, its first
+ * LMS_RecvStream() returns the window start timestamp.
+ * Can be changed while the stream is running.
+ *
+ * @param stream    Rx stream previously initialized with LMS_SetupStream().
+ * @param trigger   trigger configuration, mode LMS_TRIGGER_OFF disables triggering
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_SetStreamTrigger(lms_stream_t *stream, const lms_stream_trigger_t *trigger);
+
+/**
+ * @param stream    Rx stream previously initialized with LMS_SetupStream().
+ *
+ * @return  number of trigger windows delivered since LMS_SetStreamTrigger(), (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_GetStreamTriggerCount(lms_stream_t *stream);
+
+/**
+ * Create a narrowband output of a wide Rx stream. Received samples are mixed
+ * down by frequency and decimated on the host, the output stream is started,
+ * read and destroyed with the regular stream functions and gets samples while
+ * the source stream is active. Output timestamps count output samples.
+ *
+ * @param stream    Rx stream previously initialized with LMS_SetupStream().
+ * @param output    returns the output stream, its fields other than handle are copied from stream
+ * @param frequency sub-band center relative to the stream center frequency, Hz
+ * @param decimation power of two from 1 to 256
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_SetupStreamDDC(lms_stream_t *stream, lms_stream_t *output, float_type frequency, unsigned decimation);
+
+/**
+ * Retune output created with LMS_SetupStreamDDC(), can be called while streaming
+ *
+ * @param output    DDC output stream
+ * @param frequency sub-band center relative to the stream center frequency, Hz
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_SetStreamDDCFrequency(lms_stream_t *output, float_type frequency);
+
+/**
+ * Split a stream into uniformly spaced channels with a polyphase filter bank.
+ * Channel k is centered at k*rate/channels from the stream center frequency,
+ * channels from channels/2 up are the negative frequencies, and runs at
+ * rate/channels.
+ *
+ * Rx: every channel gets an output stream, used like ones of LMS_SetupStreamDDC().
+ * Tx: channel samples are written with LMS_SendStreamChannels().
+ *
+ * @param stream    stream previously initialized with LMS_SetupStream().
+ * @param channels  power of two from 2 to 256
+ * @param outputs   Rx: array of channels streams to return outputs in, Tx: unused
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_SetupStreamChannelizer(lms_stream_t *stream, unsigned channels, lms_stream_t *outputs);
+
+/**
+ * Write samples of every channel of a Tx stream set up with LMS_SetupStreamChannelizer().
+ * The sum of channel amplitudes has to stay within full scale.
+ *
+ * @param stream        Tx stream with channelizer
+ * @param samples       array of sample buffers, one per channel, NULL for silent channels
+ * @param sample_count  number of samples in each buffer
+ * @param meta          metadata, timestamp is at stream sample rate
+ * @param timeout_ms    how long to wait for data before timing out.
+ *
+ * @return number of samples written per channel, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_SendStreamChannels(lms_stream_t *stream, const void * const *samples, size_t sample_count, const lms_stream_meta_t *meta, unsigned timeout_ms);
+
+/**
+ * Stream callback.
+ * In RX: samples were received, returns number of samples taken, the rest is
+ * offered again with the next call.
+ * In TX: fill up to sample_count samples and meta, returns number of samples filled.
+ * Negative return value stops further callbacks until the stream is started again.
+ */
+typedef int (*lms_stream_cb_t)(void *samples, size_t sample_count, lms_stream_meta_t *meta, void *user_data);
+
+/**
+ * Set a function the stream calls instead of being polled with LMS_RecvStream()
+ * or LMS_SendStream(). Stream has to be stopped. From LMS_StartStream() a thread
+ * waits on the stream FIFO and passes every received packet, or every free TX
+ * packet to be filled, to the callback. RX samples not taken stay in FIFO,
+ * which drops the oldest ones when full, TX callback is not called while FIFO
+ * is full. When the callback takes or fills nothing, it is called again after
+ * the time of one packet. The callback must not start, stop or destroy the stream.
+ *
+ * @param stream    stream previously initialized with LMS_SetupStream().
+ * @param callback  function to call, NULL removes it
+ * @param user_data passed to callback
+ * @param direct    RX only: call from the receive thread for every packet
+ *                  before it goes to FIFO, samples not taken go to FIFO. The
+ *                  callback has to return quickly. Not for LMS_FMT_F32.
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_SetStreamCallback(lms_stream_t *stream, lms_stream_cb_t callback, void *user_data, bool direct);
+
 /**
  * Write samples to the FIFO of the specified stream.
  *
@@ -1189,6 +1535,139 @@ API_EXPORT int CALL_CONV LMS_SendStream(lms_stream_t *stream,
                             const void *samples,size_t sample_count,
                             const lms_stream_meta_t *meta, unsigned timeout_ms);
 
+/**
+ * Borrow received samples from the FIFO of the specified stream without copying.
+ * Samples are returned in packets as received from HW, one packet per call.
+ * Not available for LMS_FMT_F32 streams.
+ *
+ * @param stream        structure previously initialized with LMS_SetupStream().
+ * @param samples       returns pointer to 16-bit I/Q samples, valid until LMS_ReleaseRecvBuffer()
+ * @param meta          Metadata. See the ::lms_stream_meta_t description.
+ * @param timeout_ms    how long to wait for data before timing out.
+ *
+ * @return number of samples available at samples, 0 on timeout, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_AcquireRecvBuffer(lms_stream_t *stream, const void **samples,
+                            lms_stream_meta_t *meta, unsigned timeout_ms);
+
+/**
+ * Return samples borrowed with LMS_AcquireRecvBuffer() to the FIFO.
+ *
+ * @param stream        structure previously initialized with LMS_SetupStream().
+ * @param sample_count  number of samples consumed, may be less than acquired
+ *
+ * @return 0 on success, 1 if the samples were overwritten by newer data while
+ *         borrowed and have to be discarded, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_ReleaseRecvBuffer(lms_stream_t *stream, size_t sample_count);
+
+/**
+ * Borrow a FIFO packet of the specified TX stream to be filled in place.
+ * Not available for LMS_FMT_F32 streams.
+ *
+ * @param stream        structure previously initialized with LMS_SetupStream().
+ * @param samples       returns pointer where 16-bit I/Q samples can be written
+ * @param timeout_ms    how long to wait for free space before timing out.
+ *
+ * @return number of samples that fit into the packet, 0 on timeout, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_AcquireSendBuffer(lms_stream_t *stream, void **samples, unsigned timeout_ms);
+
+/**
+ * Queue samples written into the packet returned by LMS_AcquireSendBuffer().
+ *
+ * @param stream        structure previously initialized with LMS_SetupStream().
+ * @param sample_count  number of samples written
+ * @param meta          Metadata. See the ::lms_stream_meta_t description.
+ *
+ * @return number of samples queued on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_CommitSendBuffer(lms_stream_t *stream, size_t sample_count,
+                            const lms_stream_meta_t *meta);
+
+/**Options of stream buffer allocation, see LMS_SetStreamBufferOptions()*/
+#define LMS_BUFFER_HUGEPAGES    0x1 ///<Use 2 MB huge pages for buffers of that size and bigger
+#define LMS_BUFFER_LOCK         0x2 ///<Lock buffers in memory (subject to RLIMIT_MEMLOCK)
+
+/**
+ * Set how FIFO and USB transfer buffers of streams are allocated. Applies to
+ * buffers allocated afterwards, so it should be called before LMS_SetupStream().
+ * Buffer pages are always placed on the NUMA node of the thread that writes
+ * them first.
+ *
+ * @param options   combination of LMS_BUFFER_* flags
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_SetStreamBufferOptions(unsigned options);
+
+/**Stages of the streaming path measured by the stream profiler*/
+#define LMS_STAGE_RX_USB_WAIT   0   ///<Waiting for USB read transfer
+#define LMS_STAGE_RX_PARSE      1   ///<Unpacking received packet
+#define LMS_STAGE_RX_FIFO_PUSH  2   ///<Pushing received samples into FIFO
+#define LMS_STAGE_RX_APP_READ   3   ///<LMS_RecvStream()
+#define LMS_STAGE_TX_APP_WRITE  4   ///<LMS_SendStream()
+#define LMS_STAGE_TX_FIFO_POP   5   ///<Taking samples for transmission out of FIFO
+#define LMS_STAGE_TX_BUILD      6   ///<Packing samples into packet
+#define LMS_STAGE_TX_USB_WAIT   7   ///<Waiting for USB write transfer
+#define LMS_STAGE_APP_PROCESS   8   ///<Application processing, reported by application
+#define LMS_STAGE_COUNT         9
+
+/**Latency statistics of one streaming stage, all durations in nanoseconds*/
+typedef struct
+{
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    uint64_t mean;
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t p999;
+} lms_stream_stage_stats_t;
+
+/**
+ * Enable/disable stream profiling. Can be changed while streaming.
+ *
+ * @param histograms    collect per-stage latency histograms
+ * @param trace         additionally record a timeline for LMS_WriteStreamTrace()
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_SetStreamProfiling(bool histograms, bool trace);
+
+/**
+ * Get latency statistics of one streaming stage.
+ *
+ * @param stage     one of LMS_STAGE_* values
+ * @param stats     Stage statistics. See the ::lms_stream_stage_stats_t for description
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_GetStreamStageStats(int stage, lms_stream_stage_stats_t* stats);
+
+/**
+ * @param stage     one of LMS_STAGE_* values
+ * @return  short name of the stage
+ */
+API_EXPORT const char* CALL_CONV LMS_GetStreamStageName(int stage);
+
+/**
+ * Clear all stage histograms and the recorded timeline.
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_ResetStreamProfiling(void);
+
+/**
+ * Write the recorded timeline (last 65536 events) in Chrome trace format.
+ *
+ * @param filename  output file, open with chrome://tracing or Perfetto
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_WriteStreamTrace(const char* filename);
+
 /**
  * Uploads waveform to on board memory for later use
  * @param device        Device handle previously obtained by LMS_Open().
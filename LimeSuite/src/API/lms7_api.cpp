@@ -9,6 +9,9 @@
 #include "Logger.h"
 #include "LMS64CProtocol.h"
 #include "Streamer.h"
+#include "StreamProfiler.h"
+#include "StreamBuffer.h"
+#include "Channelizer.h"
 
 using namespace std;
 
@@ -1189,7 +1192,33 @@ API_EXPORT int CALL_CONV LMS_RecvStream(lms_stream_t *stream, void *samples, siz
     }
     else metadata.timestamp = 0;
 
-    int status = channel->Read(samples, sample_count, &metadata, timeout_ms);
+    int status;
+    {
+        lime::StageTimer timer(lime::STAGE_RX_APP_READ);
+        status = channel->Read(samples, sample_count, &metadata, timeout_ms);
+    }
+    if (meta)
+        meta->timestamp = metadata.timestamp;
+    return status;
+}
+
+API_EXPORT int CALL_CONV LMS_RecvStreamAligned(lms_stream_t **streams, size_t stream_count, void **samples, size_t sample_count, lms_stream_meta_t *meta, unsigned timeout_ms)
+{
+    if (streams==nullptr || samples==nullptr || stream_count > 255)
+        return -1;
+    std::vector<lime::StreamChannel*> channels(stream_count);
+    for (size_t i = 0; i < stream_count; ++i)
+    {
+        if (streams[i]==nullptr || streams[i]->handle==0)
+            return -1;
+        channels[i] = (lime::StreamChannel*)streams[i]->handle;
+    }
+    lime::StreamChannel::Metadata metadata;
+    int status;
+    {
+        lime::StageTimer timer(lime::STAGE_RX_APP_READ);
+        status = lime::StreamChannel::ReadAligned(channels.data(), stream_count, samples, sample_count, &metadata, timeout_ms);
+    }
     if (meta)
         meta->timestamp = metadata.timestamp;
     return status;
@@ -1210,9 +1239,128 @@ API_EXPORT int CALL_CONV LMS_SendStream(lms_stream_t *stream, const void *sample
     }
     else metadata.timestamp = 0;
 
+    lime::StageTimer timer(lime::STAGE_TX_APP_WRITE);
     return channel->Write(samples, sample_count, &metadata, timeout_ms);
 }
 
+API_EXPORT int CALL_CONV LMS_AcquireRecvBuffer(lms_stream_t *stream, const void **samples, lms_stream_meta_t *meta, unsigned timeout_ms)
+{
+    if (stream==nullptr || stream->handle==0 || samples==nullptr)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    lime::StreamChannel::Metadata metadata;
+    const lime::complex16_t* ptr = nullptr;
+    int status;
+    {
+        lime::StageTimer timer(lime::STAGE_RX_APP_READ);
+        status = channel->AcquireRead(&ptr, &metadata, timeout_ms);
+    }
+    *samples = ptr;
+    if (meta && status > 0)
+        meta->timestamp = metadata.timestamp;
+    return status;
+}
+
+API_EXPORT int CALL_CONV LMS_ReleaseRecvBuffer(lms_stream_t *stream, size_t sample_count)
+{
+    if (stream==nullptr || stream->handle==0)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    return channel->ReleaseRead(sample_count) ? 0 : 1;
+}
+
+API_EXPORT int CALL_CONV LMS_AcquireSendBuffer(lms_stream_t *stream, void **samples, unsigned timeout_ms)
+{
+    if (stream==nullptr || stream->handle==0 || samples==nullptr)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    lime::complex16_t* ptr = nullptr;
+    int status;
+    {
+        lime::StageTimer timer(lime::STAGE_TX_APP_WRITE);
+        status = channel->AcquireWrite(&ptr, timeout_ms);
+    }
+    *samples = ptr;
+    return status;
+}
+
+API_EXPORT int CALL_CONV LMS_CommitSendBuffer(lms_stream_t *stream, size_t sample_count, const lms_stream_meta_t *meta)
+{
+    if (stream==nullptr || stream->handle==0)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    lime::StreamChannel::Metadata metadata;
+    metadata.flags = 0;
+    if (meta)
+    {
+        metadata.flags |= meta->waitForTimestamp * lime::RingFIFO::SYNC_TIMESTAMP;
+        metadata.flags |= meta->flushPartialPacket * lime::RingFIFO::END_BURST;
+        metadata.timestamp = meta->timestamp;
+    }
+    else metadata.timestamp = 0;
+
+    return channel->CommitWrite(sample_count, &metadata);
+}
+
+API_EXPORT int CALL_CONV LMS_SetStreamBufferOptions(unsigned options)
+{
+    uint32_t flags = 0;
+    if (options & LMS_BUFFER_HUGEPAGES)
+        flags |= lime::DefaultStreamAllocator::HUGE_PAGES;
+    if (options & LMS_BUFFER_LOCK)
+        flags |= lime::DefaultStreamAllocator::LOCK_MEMORY;
+    lime::DefaultStreamAllocator::Instance().SetOptions(flags);
+    return 0;
+}
+
+API_EXPORT int CALL_CONV LMS_SetStreamProfiling(bool histograms, bool trace)
+{
+    lime::StreamProfiler &profiler = lime::StreamProfiler::Instance();
+    profiler.SetEnabled(histograms || trace);
+    profiler.SetTracing(trace);
+    return 0;
+}
+
+API_EXPORT int CALL_CONV LMS_GetStreamStageStats(int stage, lms_stream_stage_stats_t* stats)
+{
+    if (stage < 0 || stage >= LMS_STAGE_COUNT || stats == nullptr)
+    {
+        lime::ReportError(EINVAL, "Invalid stream stage.");
+        return -1;
+    }
+    lime::StreamProfiler::StageStats info = lime::StreamProfiler::Instance().GetStats((lime::StreamStage)stage);
+    stats->count = info.count;
+    stats->min = info.min_ns;
+    stats->max = info.max_ns;
+    stats->mean = info.mean_ns;
+    stats->p50 = info.p50_ns;
+    stats->p90 = info.p90_ns;
+    stats->p99 = info.p99_ns;
+    stats->p999 = info.p999_ns;
+    return 0;
+}
+
+API_EXPORT const char* CALL_CONV LMS_GetStreamStageName(int stage)
+{
+    return lime::StreamProfiler::StageName((lime::StreamStage)stage);
+}
+
+API_EXPORT int CALL_CONV LMS_ResetStreamProfiling(void)
+{
+    lime::StreamProfiler::Instance().Reset();
+    return 0;
+}
+
+API_EXPORT int CALL_CONV LMS_WriteStreamTrace(const char* filename)
+{
+    if (filename == nullptr)
+    {
+        lime::ReportError(EINVAL, "Trace file name cannot be NULL.");
+        return -1;
+    }
+    return lime::StreamProfiler::Instance().WriteTrace(filename) == 0 ? 0 : -1;
+}
+
 API_EXPORT int CALL_CONV LMS_UploadWFM(lms_device_t *device,
                                          const void **samples, uint8_t chCount,
                                          size_t sample_count, int format)
@@ -1273,6 +1421,279 @@ API_EXPORT int CALL_CONV LMS_GetStreamStatus(lms_stream_t *stream, lms_stream_st
     return 0;
 }
 
+API_EXPORT int CALL_CONV LMS_GetStreamTelemetry(lms_stream_t *stream, lms_stream_telemetry_t* telemetry)
+{
+    assert(stream != nullptr);
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    if(channel == nullptr)
+        return -1;
+    lime::StreamChannel::Telemetry info = channel->GetTelemetry();
+
+    telemetry->active = info.active;
+    telemetry->fifoFilledCount = info.fifoItemsCount;
+    telemetry->fifoSize = info.fifoSize;
+    telemetry->fifoHighWater = info.fifoHighWater;
+    telemetry->underrun = info.underrun;
+    telemetry->overrun = info.overrun;
+    telemetry->droppedPackets = info.droppedPackets;
+    telemetry->linkBytes = info.linkBytes;
+    telemetry->linkRate = info.linkRate;
+    telemetry->timestamp = info.timestamp;
+    return 0;
+}
+
+API_EXPORT int CALL_CONV LMS_SetStreamThreadOptions(lms_stream_t *stream, const lms_stream_thread_t *options)
+{
+    if (stream==nullptr || stream->handle==0 || options==nullptr)
+        return -1;
+    lime::StreamConfig::ThreadOptions threadOptions;
+    threadOptions.cpuMask = options->cpuMask;
+    threadOptions.priority = options->priority;
+    switch (options->policy)
+    {
+        case LMS_SCHED_DEFAULT:
+            threadOptions.policy = lime::StreamConfig::ThreadOptions::POLICY_DEFAULT;
+            break;
+        case LMS_SCHED_FIFO:
+            threadOptions.policy = lime::StreamConfig::ThreadOptions::POLICY_FIFO;
+            break;
+        case LMS_SCHED_RR:
+            threadOptions.policy = lime::StreamConfig::ThreadOptions::POLICY_RR;
+            break;
+        default:
+            lime::ReportError(EINVAL, "Invalid scheduling policy.");
+            return -1;
+    }
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    channel->config.threadOptions = threadOptions;
+    return 0;
+}
+
+API_EXPORT int CALL_CONV LMS_SetStreamTransferDepth(lms_stream_t *stream, unsigned depth)
+{
+    if (stream==nullptr || stream->handle==0)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    channel->config.transferDepth = depth;
+    return 0;
+}
+
+API_EXPORT int CALL_CONV LMS_GetStreamTransferStats(lms_stream_t *stream, lms_stream_transfers_t *stats)
+{
+    if (stream==nullptr || stream->handle==0 || stats==nullptr)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    lime::IConnection::TransferStats info;
+    if (channel->mStreamer->dataPort->GetTransferStats(channel->config.isTx, &info) != 0)
+        return -1;
+    stats->depth = info.depth;
+    stats->inUse = info.inUse;
+    stats->highWater = info.highWater;
+    stats->acquired = info.acquired;
+    stats->exhausted = info.exhausted;
+    return 0;
+}
+
+API_EXPORT int CALL_CONV LMS_SetStreamGapFill(lms_stream_t *stream, bool enable)
+{
+    if (stream==nullptr || stream->handle==0)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    if (channel->config.isTx)
+    {
+        lime::ReportError(EINVAL, "Gap filling is only available for Rx streams.");
+        return -1;
+    }
+    channel->config.fillGaps = enable;
+    return 0;
+}
+
+API_EXPORT int CALL_CONV LMS_GetStreamLossStats(lms_stream_t *stream, lms_stream_loss_t *loss)
+{
+    if (stream==nullptr || stream->handle==0 || loss==nullptr)
+        return -1;
+    static_assert(LMS_LOSS_HISTOGRAM_SIZE == lime::StreamChannel::LossStats::histogramSize, "loss histogram size mismatch");
+    static_assert(LMS_LOSS_EVENTS_SIZE == lime::StreamChannel::LossStats::eventsSize, "loss events size mismatch");
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    lime::StreamChannel::LossStats stats = channel->GetLossStats();
+    for (int i = 0; i < LMS_LOSS_HISTOGRAM_SIZE; ++i)
+        loss->histogram[i] = stats.histogram[i];
+    loss->eventsCount = stats.eventsCount;
+    loss->filledSamples = stats.filledSamples;
+    loss->recentCount = stats.recentCount;
+    for (int i = 0; i < LMS_LOSS_EVENTS_SIZE; ++i)
+    {
+        loss->recentTimestamp[i] = stats.recentTimestamp[i];
+        loss->recentPackets[i] = stats.recentPackets[i];
+    }
+    return 0;
+}
+
+API_EXPORT int CALL_CONV LMS_SetStreamHistory(lms_stream_t *stream, double seconds)
+{
+    if (stream==nullptr || stream->handle==0)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    return channel->SetHistory(seconds);
+}
+
+API_EXPORT int CALL_CONV LMS_RecvStreamHistory(lms_stream_t *stream, uint64_t timestamp, void *samples, size_t sample_count, lms_stream_meta_t *meta)
+{
+    if (stream==nullptr || stream->handle==0)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    lime::StreamChannel::Metadata metadata;
+    int status = channel->ReadHistory(timestamp, samples, sample_count, &metadata);
+    if (meta && status >= 0)
+        meta->timestamp = metadata.timestamp;
+    return status;
+}
+
+API_EXPORT int CALL_CONV LMS_SetStreamTrigger(lms_stream_t *stream, const lms_stream_trigger_t *trigger)
+{
+    if (stream==nullptr || stream->handle==0 || trigger==nullptr)
+        return -1;
+    lime::TriggerEngine::Config config;
+    switch (trigger->mode)
+    {
+        case LMS_TRIGGER_OFF:
+            config.mode = lime::TriggerEngine::Config::MODE_OFF;
+            break;
+        case LMS_TRIGGER_POWER:
+            config.mode = lime::TriggerEngine::Config::MODE_POWER;
+            break;
+        case LMS_TRIGGER_EDGE:
+            config.mode = lime::TriggerEngine::Config::MODE_EDGE;
+            break;
+        case LMS_TRIGGER_CORRELATION:
+            config.mode = lime::TriggerEngine::Config::MODE_CORRELATION;
+            if (trigger->pattern == nullptr || trigger->patternLength == 0)
+            {
+                lime::ReportError(EINVAL, "Correlation trigger needs a pattern.");
+                return -1;
+            }
+            break;
+        default:
+            lime::ReportError(EINVAL, "Invalid trigger mode.");
+            return -1;
+    }
+    config.threshold = trigger->threshold;
+    config.preTrigger = trigger->preTrigger;
+    config.postTrigger = trigger->postTrigger;
+    config.singleShot = trigger->singleShot;
+    if (config.mode == lime::TriggerEngine::Config::MODE_CORRELATION)
+    {
+        config.pattern.resize(trigger->patternLength);
+        for (unsigned i = 0; i < trigger->patternLength; ++i)
+        {
+            config.pattern[i].i = trigger->pattern[2*i];
+            config.pattern[i].q = trigger->pattern[2*i+1];
+        }
+    }
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    return channel->SetTrigger(config);
+}
+
+API_EXPORT int CALL_CONV LMS_GetStreamTriggerCount(lms_stream_t *stream)
+{
+    if (stream==nullptr || stream->handle==0)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    return channel->GetTriggerCount();
+}
+
+API_EXPORT int CALL_CONV LMS_SetupStreamDDC(lms_stream_t *stream, lms_stream_t *output, float_type frequency, unsigned decimation)
+{
+    if (stream==nullptr || stream->handle==0 || output==nullptr)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    lime::StreamChannel* ddc = channel->AddDDC(frequency, decimation);
+    if (ddc == nullptr)
+        return -1;
+    *output = *stream;
+    output->handle = size_t(ddc);
+    return 0;
+}
+
+API_EXPORT int CALL_CONV LMS_SetStreamDDCFrequency(lms_stream_t *output, float_type frequency)
+{
+    if (output==nullptr || output->handle==0)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)output->handle;
+    return channel->SetDDCFrequency(frequency);
+}
+
+API_EXPORT int CALL_CONV LMS_SetupStreamChannelizer(lms_stream_t *stream, unsigned channels, lms_stream_t *outputs)
+{
+    if (stream==nullptr || stream->handle==0)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    if (stream->isTx)
+        return channel->SetupChannelizer(channels, nullptr);
+    if (outputs == nullptr || channels > lime::FilterBank::maxChannels)
+        return -1;
+    lime::StreamChannel* handles[lime::FilterBank::maxChannels];
+    if (channel->SetupChannelizer(channels, handles) != 0)
+        return -1;
+    for (unsigned k = 0; k < channels; ++k)
+    {
+        outputs[k] = *stream;
+        outputs[k].handle = size_t(handles[k]);
+    }
+    return 0;
+}
+
+API_EXPORT int CALL_CONV LMS_SendStreamChannels(lms_stream_t *stream, const void * const *samples, size_t sample_count, const lms_stream_meta_t *meta, unsigned timeout_ms)
+{
+    if (stream==nullptr || stream->handle==0 || samples==nullptr)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    lime::StreamChannel::Metadata metadata;
+    metadata.flags = 0;
+    if (meta)
+    {
+        metadata.flags |= meta->waitForTimestamp * lime::RingFIFO::SYNC_TIMESTAMP;
+        metadata.flags |= meta->flushPartialPacket * lime::RingFIFO::END_BURST;
+        metadata.timestamp = meta->timestamp;
+    }
+    else metadata.timestamp = 0;
+    return channel->WriteChannels(samples, sample_count, &metadata, timeout_ms);
+}
+
+API_EXPORT int CALL_CONV LMS_SetStreamCallback(lms_stream_t *stream, lms_stream_cb_t callback, void *user_data, bool direct)
+{
+    if (stream==nullptr || stream->handle==0)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    if (callback == nullptr)
+        return channel->SetCallback(nullptr, direct);
+    const bool isTx = stream->isTx;
+    return channel->SetCallback([callback, user_data, isTx](void* samples, uint32_t count, lime::StreamChannel::Metadata* meta)
+    {
+        lms_stream_meta_t metadata;
+        metadata.timestamp = meta->timestamp;
+        metadata.waitForTimestamp = false;
+        metadata.flushPartialPacket = false;
+        const int ret = callback(samples, count, &metadata, user_data);
+        if (isTx)
+        {
+            meta->timestamp = metadata.timestamp;
+            meta->flags = metadata.waitForTimestamp * lime::RingFIFO::SYNC_TIMESTAMP;
+            meta->flags |= metadata.flushPartialPacket * lime::RingFIFO::END_BURST;
+        }
+        return ret;
+    }, direct);
+}
+
+API_EXPORT int CALL_CONV LMS_SetStreamFloatConversion(lms_stream_t *stream, float scale, float offset_i, float offset_q)
+{
+    if (stream==nullptr || stream->handle==0)
+        return -1;
+    lime::StreamChannel* channel = (lime::StreamChannel*)stream->handle;
+    channel->SetFloatConversion(scale, offset_i, offset_q);
+    return 0;
+}
+
 API_EXPORT const lms_dev_info_t* CALL_CONV LMS_GetDeviceInfo(lms_device_t *device)
 {
     if (device == nullptr)
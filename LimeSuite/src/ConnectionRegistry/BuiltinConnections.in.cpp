@@ -11,6 +11,7 @@
 //#cmakedefine ENABLE_FTDI
 //#cmakedefine ENABLE_PCIE_XILLYBUS
 //#cmakedefine ENABLE_REMOTE
+//#cmakedefine ENABLE_EMULATOR
 
 //void __loadConnectionEVB7COMEntry(void);
 void __loadConnectionFX3Entry(void);
@@ -19,6 +20,7 @@ void __loadConnectionFX3Entry(void);
 //void __loadConnectionFT601Entry(void);
 //void __loadConnectionXillybusEntry(void);
 //void __loadConnectionRemoteEntry(void);
+void __loadConnectionEmulatorEntry(void);
 
 void __loadAllConnections(void)
 {
@@ -49,4 +51,8 @@ void __loadAllConnections(void)
 //    #ifdef ENABLE_REMOTE
 //    __loadConnectionRemoteEntry();
 //    #endif
+
+    //#ifdef ENABLE_EMULATOR
+    __loadConnectionEmulatorEntry();
+    //#endif
 }
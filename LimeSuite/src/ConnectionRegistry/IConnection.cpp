@@ -49,6 +49,11 @@ int IConnection::TransactSPI(const int addr, const uint32_t *writeData, uint32_t
     return ReportError("TransactSPI not supported");
 }
 
+int IConnection::FlushControl(void)
+{
+    return 0;
+}
+
 int IConnection::WriteI2C(const int addr, const std::string &data)
 {
     return ReportError("WriteI2C not supported");
@@ -124,6 +129,22 @@ int IConnection::CheckStreamSize(int size)const
     return 0;
 }
 
+int IConnection::SetTransferDepth(bool, int)
+{
+    return GetBuffersCount();
+}
+
+int IConnection::GetTransferStats(bool, TransferStats* stats)
+{
+    memset(stats, 0, sizeof(TransferStats));
+    return -1;
+}
+
+int IConnection::WaitForCompletions(bool, int, int*, int, unsigned)
+{
+    return -1;
+}
+
 int IConnection::ResetStreamBuffers()
 {
     return 0;
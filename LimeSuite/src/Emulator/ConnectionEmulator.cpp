@@ -0,0 +1,342 @@
+/**
+    @file ConnectionEmulator.cpp
+    @brief In-process LMS64C device emulating the control plane of a LimeSDR-USB
+*/
+
+#include "ConnectionEmulator.h"
+#include "LMS7002M_parameters.h"
+#include "Logger.h"
+#include <ADCUnits.h>
+#include <algorithm>
+#include <chrono>
+#include <string.h>
+#include <thread>
+
+using namespace lime;
+
+extern std::vector<const LMS7Parameter*> LMS7parameterList;
+
+//reported as LimeSDR-USB 1.4 with matching firmware and gateware, so version checks pass
+static const uint8_t emulatedFirmware = 4;
+static const uint8_t emulatedHardware = 4;
+static const uint8_t emulatedProtocol = 1;
+static const uint16_t emulatedGateware = 2;
+static const uint16_t emulatedGatewareRevision = 17;
+
+//responses buffered before the host has to read them
+static const int maxRequestsInFlight = 4;
+
+//VCO ranges of the chip, CSW sweeps each range from lowest to highest frequency
+static const double sxVCORanges[3][2] = {{3800e6, 5222e6}, {4961e6, 6754e6}, {6306e6, 7714e6}};
+static const double cgenVCORange[2] = {1930e6, 2940e6};
+//CSW codes on each side of the ideal one that still keep the tuning voltage within the comparator window
+static const double lockCodes = 2;
+
+//gateware counts reference clock cycles while the FX3 clock counts this many
+static const double fx3Clock_Hz = 100.6e6;
+static const double fx3Count = 16777210;
+
+static const uint16_t fpgaStatusAddr = 0x0021;
+static const uint16_t clkTestCtrlAddr = 0x0061;
+static const uint16_t clkTestStatusAddr = 0x0065;
+static const uint16_t clkTestCountAddr = 0x0072;
+
+ConnectionEmulator::ConnectionEmulator(unsigned latency_us) :
+    mRefClk_Hz(30.72e6), mLatency_us(latency_us), mTransactions(0)
+{
+    memset(mGPIO, 0, sizeof(mGPIO));
+    memset(mGPIODir, 0, sizeof(mGPIODir));
+    ResetChip();
+    mFPGA[0x0000] = LMS_DEV_LIMESDR;
+    mFPGA[0x0001] = emulatedGateware;
+    mFPGA[0x0002] = emulatedGatewareRevision;
+    //PLL configuration and phase search are done as soon as they are started
+    mFPGA[fpgaStatusAddr] = 0x0005;
+}
+
+ConnectionEmulator::~ConnectionEmulator(void)
+{
+    StopControlQueue();
+}
+
+bool ConnectionEmulator::IsOpen()
+{
+    return true;
+}
+
+void ConnectionEmulator::SetLatency(unsigned latency_us)
+{
+    mLatency_us.store(latency_us);
+}
+
+void ConnectionEmulator::SetReferenceClock(double refClk_Hz)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    mRefClk_Hz = refClk_Hz;
+}
+
+uint64_t ConnectionEmulator::GetTransactionCount() const
+{
+    return mTransactions.load();
+}
+
+int ConnectionEmulator::GetControlQueueDepth(void)
+{
+    return maxRequestsInFlight;
+}
+
+//sleeping alone overshoots short latencies by tens of microseconds
+static void DelayUntil(std::chrono::steady_clock::time_point deadline)
+{
+    if (deadline - std::chrono::steady_clock::now() > std::chrono::microseconds(200))
+        std::this_thread::sleep_until(deadline - std::chrono::microseconds(100));
+    while (std::chrono::steady_clock::now() < deadline)
+        std::this_thread::yield();
+}
+
+int ConnectionEmulator::Write(const unsigned char* buffer, int length, int)
+{
+    if (length != ProtocolLMS64C::pktLength)
+    {
+        ReportError(EINVAL, "Emulator: request of %d bytes, expected %d", length, ProtocolLMS64C::pktLength);
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(mLock);
+    if (mResponses.size() >= size_t(maxRequestsInFlight))
+    {
+        ReportError(EBUSY, "Emulator: more than %d requests in flight", maxRequestsInFlight);
+        return 0;
+    }
+    Response response;
+    response.ready = std::chrono::steady_clock::now() + std::chrono::microseconds(mLatency_us.load());
+    Process(buffer, response.data.data());
+    mResponses.push_back(response);
+    mTransactions.fetch_add(1);
+    mResponseCond.notify_all();
+    return length;
+}
+
+int ConnectionEmulator::Read(unsigned char* buffer, int length, int timeout_ms)
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    Response response;
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        //as on USB, the request may still be written by another thread
+        if (!mResponseCond.wait_until(lock, deadline, [this]{return !mResponses.empty();}))
+            return 0;
+        //response later than the timeout stays queued for the next Read()
+        if (mResponses.front().ready > deadline)
+        {
+            lock.unlock();
+            DelayUntil(deadline);
+            return 0;
+        }
+        response = mResponses.front();
+        mResponses.pop_front();
+    }
+    DelayUntil(response.ready);
+    length = std::min<int>(length, ProtocolLMS64C::pktLength);
+    memcpy(buffer, response.data.data(), length);
+    return length;
+}
+
+void ConnectionEmulator::Process(const unsigned char* request, unsigned char* response)
+{
+    const int headerSize = 8;
+    const unsigned char* data = &request[headerSize];
+    unsigned char* out = &response[headerSize];
+    const uint8_t cmd = request[0];
+    const uint8_t periphID = request[3];
+    //every block is answered by 4 bytes
+    const int blockCount = std::min<int>(request[2], ProtocolLMS64C::maxDataLength/4);
+
+    memset(response, 0, ProtocolLMS64C::pktLength);
+    response[0] = cmd;
+    response[2] = request[2];
+    response[3] = periphID;
+    uint8_t status = STATUS_COMPLETED_CMD;
+    switch (cmd)
+    {
+    case CMD_GET_INFO:
+        out[0] = emulatedFirmware;
+        out[1] = LMS_DEV_LIMESDR;
+        out[2] = emulatedProtocol;
+        out[3] = emulatedHardware;
+        out[4] = EXP_BOARD_UNSUPPORTED;
+        out[17] = 1; //serial number
+        break;
+    case CMD_LMS7002_RST:
+        if (periphID != 0)
+            status = STATUS_ERROR_CMD;
+        else if (data[0] != 0) //activate or pulse
+            ResetChip();
+        break;
+    case CMD_LMS7002_WR:
+        if (periphID != 0)
+            status = STATUS_ERROR_CMD;
+        for (int i = 0; i < blockCount && periphID == 0; ++i)
+            WriteChip((data[4*i] << 8) | data[4*i+1], (data[4*i+2] << 8) | data[4*i+3]);
+        break;
+    case CMD_LMS7002_RD:
+        if (periphID != 0)
+            status = STATUS_ERROR_CMD;
+        for (int i = 0; i < blockCount && periphID == 0; ++i)
+        {
+            const uint16_t addr = (data[2*i] << 8) | data[2*i+1];
+            const uint16_t value = ReadChip(addr);
+            out[4*i] = addr >> 8;
+            out[4*i+1] = addr & 0xFF;
+            out[4*i+2] = value >> 8;
+            out[4*i+3] = value & 0xFF;
+        }
+        break;
+    case CMD_BRDSPI_WR:
+        for (int i = 0; i < blockCount; ++i)
+            WriteFPGA((data[4*i] << 8) | data[4*i+1], (data[4*i+2] << 8) | data[4*i+3]);
+        break;
+    case CMD_BRDSPI_RD:
+        for (int i = 0; i < blockCount; ++i)
+        {
+            const uint16_t addr = (data[2*i] << 8) | data[2*i+1];
+            const auto iter = mFPGA.find(addr);
+            const uint16_t value = iter == mFPGA.end() ? 0 : iter->second;
+            out[4*i] = addr >> 8;
+            out[4*i+1] = addr & 0xFF;
+            out[4*i+2] = value >> 8;
+            out[4*i+3] = value & 0xFF;
+        }
+        break;
+    case CMD_GPIO_WR:
+        memcpy(mGPIO, data, sizeof(mGPIO));
+        break;
+    case CMD_GPIO_RD:
+        memcpy(out, mGPIO, sizeof(mGPIO));
+        break;
+    case CMD_GPIO_DIR_WR:
+        memcpy(mGPIODir, data, sizeof(mGPIODir));
+        break;
+    case CMD_GPIO_DIR_RD:
+        memcpy(out, mGPIODir, sizeof(mGPIODir));
+        break;
+    case CMD_ANALOG_VAL_RD:
+        //sensors read zero
+        for (int i = 0; i < blockCount; ++i)
+        {
+            out[4*i] = data[i];
+            out[4*i+1] = RAW << 4;
+        }
+        break;
+    case CMD_SI5351_WR:
+    case CMD_SI5351_RD:
+    case CMD_ADF4002_WR:
+    case CMD_ANALOG_VAL_WR:
+    case CMD_USB_FIFO_RST:
+        //clock chips and stream FIFOs have nothing to emulate
+        break;
+    default:
+        //MCU and flash programming among others
+        status = STATUS_UNKNOWN_CMD;
+        break;
+    }
+    response[1] = status;
+}
+
+void ConnectionEmulator::ResetChip()
+{
+    mChip.reset(new LMS7002M_RegistersMap());
+    mChip->InitializeDefaultValues(LMS7parameterList);
+}
+
+//MAC selects which channel registers from 0x0100 up are accessed, both are written when it is 3
+void ConnectionEmulator::WriteChip(uint16_t addr, uint16_t value)
+{
+    const int mac = mChip->GetValue(0, LMS7param(MAC).address) & 0x3;
+    if ((mac & 0x1) || addr < 0x0100)
+        mChip->SetValue(0, addr, value);
+    if ((mac & 0x2) && addr >= 0x0100)
+        mChip->SetValue(1, addr, value);
+}
+
+uint16_t ConnectionEmulator::ReadChip(uint16_t addr)
+{
+    const int mac = mChip->GetValue(0, LMS7param(MAC).address) & 0x3;
+    const uint8_t channel = (mac == 2 && addr >= 0x0100) ? 1 : 0;
+    uint16_t value = mChip->GetValue(channel, addr);
+    //SXR registers are channel A, SXT registers are channel B
+    if (addr == LMS7param(VCO_CMPHO_CGEN).address || addr == LMS7param(VCO_CMPHO).address)
+    {
+        const bool cgen = addr == LMS7param(VCO_CMPHO_CGEN).address;
+        const uint8_t lsb = cgen ? LMS7param(VCO_CMPLO_CGEN).lsb : LMS7param(VCO_CMPLO).lsb;
+        value = (value & ~(0x3 << lsb)) | (Comparators(cgen, channel) << lsb);
+    }
+    return value;
+}
+
+uint16_t ConnectionEmulator::GetChipBits(uint8_t channel, const LMS7Parameter &param) const
+{
+    const uint16_t mask = (1 << (param.msb - param.lsb + 1)) - 1;
+    return (mChip->GetValue(channel, param.address) >> param.lsb) & mask;
+}
+
+/** @brief Comparators watching the VCO tuning voltage the synthesizer loop needs
+    @return 2 when locked, 3 when VCO runs too fast, 0 when too slow or powered down
+*/
+uint8_t ConnectionEmulator::Comparators(bool cgen, uint8_t channel) const
+{
+    double target;
+    const double* range;
+    uint16_t csw;
+    int cswBits;
+    if (cgen)
+    {
+        if (GetChipBits(0, LMS7param(PD_VCO_CGEN)) || GetChipBits(0, LMS7param(PD_VCO_COMP_CGEN)))
+            return 0;
+        const uint32_t frac = (GetChipBits(0, LMS7param(FRAC_SDM_CGEN_MSB)) << 16) | GetChipBits(0, LMS7param(FRAC_SDM_CGEN_LSB));
+        target = mRefClk_Hz * (GetChipBits(0, LMS7param(INT_SDM_CGEN)) + 1 + frac / 1048576.0);
+        range = cgenVCORange;
+        csw = GetChipBits(0, LMS7param(CSW_VCO_CGEN));
+        cswBits = LMS7param(CSW_VCO_CGEN).msb - LMS7param(CSW_VCO_CGEN).lsb + 1;
+    }
+    else
+    {
+        if (GetChipBits(channel, LMS7param(PD_VCO)) || GetChipBits(channel, LMS7param(PD_VCO_COMP)))
+            return 0;
+        const uint16_t sel = GetChipBits(channel, LMS7param(SEL_VCO));
+        if (sel > 2)
+            return 0;
+        const uint32_t frac = (GetChipBits(channel, LMS7param(FRAC_SDM_MSB)) << 16) | GetChipBits(channel, LMS7param(FRAC_SDM_LSB));
+        const int prescaler = GetChipBits(channel, LMS7param(EN_DIV2_DIVPROG)) ? 2 : 1;
+        target = mRefClk_Hz * prescaler * (GetChipBits(channel, LMS7param(INT_SDM)) + 4 + frac / 1048576.0);
+        range = sxVCORanges[sel];
+        csw = GetChipBits(channel, LMS7param(CSW_VCO));
+        cswBits = LMS7param(CSW_VCO).msb - LMS7param(CSW_VCO).lsb + 1;
+    }
+    const double step = (range[1] - range[0]) / ((1 << cswBits) - 1);
+    const double vco = range[0] + csw * step;
+    if (vco > target + lockCodes * step)
+        return 3;
+    if (vco < target - lockCodes * step)
+        return 0;
+    return 2;
+}
+
+void ConnectionEmulator::WriteFPGA(uint16_t addr, uint16_t value)
+{
+    //status registers only change by the operations they report
+    if (addr == fpgaStatusAddr || addr == clkTestStatusAddr)
+        return;
+    mFPGA[addr] = value;
+    if (addr != clkTestCtrlAddr)
+        return;
+    //reference clock measurement, done at once when started
+    if (value & 0x4)
+    {
+        const uint32_t count = mRefClk_Hz * fx3Count / fx3Clock_Hz;
+        mFPGA[clkTestCountAddr] = count & 0xFFFF;
+        mFPGA[clkTestCountAddr + 1] = count >> 16;
+        mFPGA[clkTestStatusAddr] |= 0x4;
+    }
+    else
+        mFPGA[clkTestStatusAddr] &= ~0x4;
+}
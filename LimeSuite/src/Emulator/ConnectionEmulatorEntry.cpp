@@ -0,0 +1,44 @@
+/**
+    @file ConnectionEmulatorEntry.cpp
+    @brief Registry entry of the LMS64C emulator connection
+*/
+
+#include "ConnectionEmulator.h"
+#include <stdlib.h>
+
+using namespace lime;
+
+//! make a static-initialized entry in the registry
+void __loadConnectionEmulatorEntry(void)
+{
+static ConnectionEmulatorEntry EmulatorEntry;
+}
+
+ConnectionEmulatorEntry::ConnectionEmulatorEntry(void):
+    ConnectionRegistryEntry("Emulator")
+{
+}
+
+std::vector<ConnectionHandle> ConnectionEmulatorEntry::enumerate(const ConnectionHandle &hint)
+{
+    std::vector<ConnectionHandle> handles;
+    //never listed next to real boards unless asked for
+    const char* latency = getenv("LIME_EMULATOR");
+    if (hint.module != "Emulator" && latency == nullptr)
+        return handles;
+
+    ConnectionHandle handle;
+    handle.media = "Emulated";
+    handle.name = "LMS64C emulator";
+    if (not hint.addr.empty())
+        handle.addr = hint.addr;
+    else
+        handle.addr = latency && *latency ? latency : "0";
+    handles.push_back(handle);
+    return handles;
+}
+
+IConnection *ConnectionEmulatorEntry::make(const ConnectionHandle &handle)
+{
+    return new ConnectionEmulator(strtoul(handle.addr.c_str(), nullptr, 10));
+}
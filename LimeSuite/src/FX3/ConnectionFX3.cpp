@@ -14,6 +14,7 @@
 #include <fstream>
 #include <thread>
 #include <chrono>
+#include <algorithm>
 
 using namespace std;
 
@@ -283,6 +284,7 @@ int ConnectionFX3::Open(const std::string &vidpid, const std::string &serial, co
 */
 void ConnectionFX3::Close()
 {
+    StopControlQueue();
     #ifndef __unix__
     USBDevicePrimary->Close();
     for (int i = 0; i < MAX_EP_CNT; i++)
@@ -403,31 +405,162 @@ int ConnectionFX3::Read(unsigned char *buffer, const int length, int timeout_ms)
     return len;
 }
 
+USBTransferPool::USBTransferPool() :
+    mHead(emptyIndex), mDepth(0), mInUse(0), mHighWater(0), mAcquired(0), mExhausted(0)
+{
+#ifdef __unix__
+    mCompletions = 0;
+    for (int i = 0; i < maxDepth; ++i)
+    {
+        mContexts[i].pool = this;
+        mContexts[i].handle = i;
+    }
+#endif
+    SetDepth(defaultDepth);
+}
+
+int USBTransferPool::SetDepth(int depth)
+{
+    if (mInUse.load() != 0)
+        return -1;
+    mDepth = std::min(std::max(depth, 1), maxDepth);
+    //lowest handles on top, so few transfers in flight keep reusing the same contexts
+    for (int i = 0; i < mDepth; ++i)
+        mNext[i].store(i + 1 < mDepth ? i + 1 : -1, std::memory_order_relaxed);
+    const uint64_t counter = (mHead.load() >> 32) + 1;
+    mHead.store((counter << 32) | 0);
+    mInUse.store(0);
+    mHighWater.store(0);
+    mAcquired.store(0);
+    mExhausted.store(0);
+    return 0;
+}
+
+int USBTransferPool::Acquire()
+{
+    uint64_t head = mHead.load(std::memory_order_acquire);
+    while (true)
+    {
+        const uint32_t index = uint32_t(head);
+        if (index == emptyIndex)
+        {
+            mExhausted.fetch_add(1, std::memory_order_relaxed);
+            return -1;
+        }
+        const uint64_t next = (((head >> 32) + 1) << 32) | uint32_t(mNext[index].load(std::memory_order_relaxed));
+        if (mHead.compare_exchange_weak(head, next, std::memory_order_acq_rel, std::memory_order_acquire))
+        {
+            const uint32_t inUse = mInUse.fetch_add(1, std::memory_order_relaxed) + 1;
+            uint32_t highWater = mHighWater.load(std::memory_order_relaxed);
+            while (inUse > highWater && !mHighWater.compare_exchange_weak(highWater, inUse, std::memory_order_relaxed))
+                ;
+            mAcquired.fetch_add(1, std::memory_order_relaxed);
+            return index;
+        }
+    }
+}
+
+void USBTransferPool::Release(int handle)
+{
+    uint64_t head = mHead.load(std::memory_order_relaxed);
+    uint64_t next;
+    do
+    {
+        mNext[handle].store(int32_t(uint32_t(head)), std::memory_order_relaxed);
+        next = (((head >> 32) + 1) << 32) | uint32_t(handle);
+    } while (!mHead.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed));
+    mInUse.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void USBTransferPool::GetStats(IConnection::TransferStats* stats) const
+{
+    stats->depth = mDepth;
+    stats->inUse = mInUse.load(std::memory_order_relaxed);
+    stats->highWater = mHighWater.load(std::memory_order_relaxed);
+    stats->acquired = mAcquired.load(std::memory_order_relaxed);
+    stats->exhausted = mExhausted.load(std::memory_order_relaxed);
+}
+
+#ifdef __unix__
+void USBTransferPool::Complete(int handle)
+{
+    mContexts[handle].order = mCompletions.fetch_add(1, std::memory_order_relaxed);
+    mContexts[handle].done.store(true, std::memory_order_release);
+    mEvent.Notify();
+}
+
+bool USBTransferPool::WaitFor(int handle, unsigned timeout_ms)
+{
+    const auto t1 = std::chrono::steady_clock::now();
+    while (!mContexts[handle].done.load(std::memory_order_acquire))
+    {
+        const uint32_t seq = mEvent.Prepare();
+        if (mContexts[handle].done.load(std::memory_order_acquire))
+        {
+            mEvent.Cancel();
+            break;
+        }
+        const int64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t1).count();
+        if (elapsed >= int64_t(timeout_ms)*1000)
+        {
+            mEvent.Cancel();
+            return false;
+        }
+        mEvent.Wait(seq, timeout_ms*1000 - elapsed);
+    }
+    return true;
+}
+
+int USBTransferPool::WaitCompleted(int ep, int* handles, int count, unsigned timeout_ms)
+{
+    const auto t1 = std::chrono::steady_clock::now();
+    int found[maxDepth];
+    while (true)
+    {
+        const uint32_t seq = mEvent.Prepare();
+        //finished contexts are found until they are released, nothing is taken from other endpoints,
+        //done is cleared before release, so when set the endpoint belongs to the current transfer
+        int n = 0;
+        for (int i = 0; i < mDepth; ++i)
+            if (mContexts[i].done.load(std::memory_order_acquire) && mContexts[i].ep == ep)
+                found[n++] = i;
+        if (n > 0)
+        {
+            mEvent.Cancel();
+            std::sort(found, found + n, [this](int a, int b) {
+                return int32_t(mContexts[a].order - mContexts[b].order) < 0;
+            });
+            n = std::min(n, count);
+            std::copy(found, found + n, handles);
+            return n;
+        }
+        const int64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t1).count();
+        if (elapsed >= int64_t(timeout_ms)*1000)
+        {
+            mEvent.Cancel();
+            return 0;
+        }
+        mEvent.Wait(seq, timeout_ms*1000 - elapsed);
+    }
+}
+#endif
+
 #ifdef __unix__
 /**	@brief Function for handling libusb callbacks
 */
 void callback_libusbtransfer(libusb_transfer *trans)
 {
 	USBTransferContext *context = reinterpret_cast<USBTransferContext*>(trans->user_data);
-	std::unique_lock<std::mutex> lck(context->transferLock);
 	switch(trans->status)
 	{
-    case LIBUSB_TRANSFER_CANCELLED:
-        context->bytesXfered = trans->actual_length;
-        context->done.store(true);
-        break;
-    case LIBUSB_TRANSFER_COMPLETED:
-        context->bytesXfered = trans->actual_length;
-        context->done.store(true);
-        break;
     case LIBUSB_TRANSFER_ERROR:
         lime::error("USB TRANSFER ERROR");
-        context->bytesXfered = trans->actual_length;
-        context->done.store(true);
-        break;
+        //fall through
+    case LIBUSB_TRANSFER_CANCELLED:
+    case LIBUSB_TRANSFER_COMPLETED:
     case LIBUSB_TRANSFER_TIMED_OUT:
         context->bytesXfered = trans->actual_length;
-        context->done.store(true);
+        context->pool->Complete(context->handle);
         break;
     case LIBUSB_TRANSFER_OVERFLOW:
         lime::error("USB transfer overflow");
@@ -439,8 +572,6 @@ void callback_libusbtransfer(libusb_transfer *trans)
         lime::error("USB transfer no device");
         break;
 	}
-	lck.unlock();
-	context->cv.notify_one();
 }
 #endif
 
@@ -454,18 +585,8 @@ void callback_libusbtransfer(libusb_transfer *trans)
 int ConnectionFX3::BeginDataReading(char *buffer, uint32_t length, int ep)
 {
     const unsigned char streamBulkInAddr = 0x81;
-    int i = 0;
-	bool contextFound = false;
-	//find not used context
-    for(i = 0; i<USB_MAX_CONTEXTS; i++)
-    {
-        if(!contexts[i].used)
-        {
-            contextFound = true;
-            break;
-        }
-    }
-    if(!contextFound)
+    const int i = contexts.Acquire();
+    if(i < 0)
     {
         lime::error("No contexts left for reading data");
         return -1;
@@ -481,6 +602,7 @@ int ConnectionFX3::BeginDataReading(char *buffer, uint32_t length, int ep)
     #else
     libusb_transfer *tr = contexts[i].transfer;
     libusb_fill_bulk_transfer(tr, dev_handle, streamBulkInAddr, (unsigned char*)buffer, length, callback_libusbtransfer, &contexts[i], 0);
+    contexts[i].ep = ep;
     contexts[i].done = false;
     contexts[i].bytesXfered = 0;
     int status = libusb_submit_transfer(tr);
@@ -488,6 +610,7 @@ int ConnectionFX3::BeginDataReading(char *buffer, uint32_t length, int ep)
     {
         lime::error("BEGIN DATA READING %s", libusb_error_name(status));
         contexts[i].used = false;
+        contexts.Release(i);
         return -1;
     }
     #endif
@@ -509,17 +632,7 @@ bool ConnectionFX3::WaitForReading(int contextHandle, unsigned int timeout_ms)
     status = contexts[contextHandle].EndPt->WaitForXfer(contexts[contextHandle].inOvLap, timeout_ms);
 	return status;
     #else
-    auto t1 = chrono::high_resolution_clock::now();
-    auto t2 = t1;
-
-    std::unique_lock<std::mutex> lck(contexts[contextHandle].transferLock);
-    while(contexts[contextHandle].done.load() == false && std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() < timeout_ms)
-    {
-        //blocking not to waste CPU
-        contexts[contextHandle].cv.wait_for(lck, chrono::milliseconds(timeout_ms));
-        t2 = chrono::high_resolution_clock::now();
-    }
-    return contexts[contextHandle].done.load() == true;
+    return contexts.WaitFor(contextHandle, timeout_ms);
     #endif
     }
     else
@@ -543,11 +656,14 @@ int ConnectionFX3::FinishDataReading(char *buffer, uint32_t length, int contextH
     status = contexts[contextHandle].EndPt->FinishDataXfer((unsigned char*)buffer, len, contexts[contextHandle].inOvLap, contexts[contextHandle].context);
     contexts[contextHandle].used = false;
     contexts[contextHandle].reset();
+    contexts.Release(contextHandle);
     return len;
     #else
 	length = contexts[contextHandle].bytesXfered;
+	contexts[contextHandle].done = false;
 	contexts[contextHandle].used = false;
 	contexts[contextHandle].reset();
+	contexts.Release(contextHandle);
 	return length;
     #endif
     }
@@ -566,13 +682,13 @@ void ConnectionFX3::AbortReading(int ep)
         if (InEndPt[i] && InEndPt[i]->Address == ep)
 	        InEndPt[i]->Abort();
 #else
-    for(int i=0; i<USB_MAX_CONTEXTS; ++i)
+    for(int i=0; i<contexts.Depth(); ++i)
     {
         if(contexts[i].used && contexts[i].transfer->endpoint == 0x81)
             libusb_cancel_transfer( contexts[i].transfer );
     }
 #endif
-    for(int i=0; i<USB_MAX_CONTEXTS; ++i)
+    for(int i=0; i<contexts.Depth(); ++i)
     {
         if(contexts[i].used)
         {
@@ -592,18 +708,8 @@ void ConnectionFX3::AbortReading(int ep)
 int ConnectionFX3::BeginDataSending(const char *buffer, uint32_t length, int ep)
 {
     const unsigned char streamBulkOutAddr = 0x01;
-    int i = 0;
-	//find not used context
-	bool contextFound = false;
-    for(i = 0; i<USB_MAX_CONTEXTS; i++)
-    {
-        if(!contextsToSend[i].used)
-        {
-            contextFound = true;
-            break;
-        }
-    }
-    if(!contextFound)
+    const int i = contextsToSend.Acquire();
+    if(i < 0)
         return -1;
     contextsToSend[i].used = true;
     #ifndef __unix__
@@ -615,6 +721,7 @@ int ConnectionFX3::BeginDataSending(const char *buffer, uint32_t length, int ep)
 	return i;
     #else
     libusb_transfer *tr = contextsToSend[i].transfer;
+    contextsToSend[i].ep = ep;
     contextsToSend[i].done = false;
     contextsToSend[i].bytesXfered = 0;
     libusb_fill_bulk_transfer(tr, dev_handle, streamBulkOutAddr, (unsigned char*)buffer, length, callback_libusbtransfer, &contextsToSend[i], 0);
@@ -623,6 +730,7 @@ int ConnectionFX3::BeginDataSending(const char *buffer, uint32_t length, int ep)
     {
         lime::error("BEGIN DATA SENDING %s", libusb_error_name(status));
         contextsToSend[i].used = false;
+        contextsToSend.Release(i);
         return -1;
     }
     #endif
@@ -644,17 +752,7 @@ bool ConnectionFX3::WaitForSending(int contextHandle, unsigned int timeout_ms)
 	status = contextsToSend[contextHandle].EndPt->WaitForXfer(contextsToSend[contextHandle].inOvLap, timeout_ms);
 	return status;
 #   else
-    auto t1 = chrono::high_resolution_clock::now();
-    auto t2 = t1;
-
-    std::unique_lock<std::mutex> lck(contextsToSend[contextHandle].transferLock);
-    while(contextsToSend[contextHandle].done.load() == false && std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() < timeout_ms)
-    {
-        //blocking not to waste CPU
-        contextsToSend[contextHandle].cv.wait_for(lck, chrono::milliseconds(timeout_ms));
-        t2 = chrono::high_resolution_clock::now();
-    }
-	return contextsToSend[contextHandle].done == true;
+    return contextsToSend.WaitFor(contextHandle, timeout_ms);
 #   endif
     }
     return 0;
@@ -676,11 +774,14 @@ int ConnectionFX3::FinishDataSending(const char *buffer, uint32_t length, int co
         contextsToSend[contextHandle].EndPt->FinishDataXfer((unsigned char*)buffer, len, contextsToSend[contextHandle].inOvLap, contextsToSend[contextHandle].context);
         contextsToSend[contextHandle].used = false;
         contextsToSend[contextHandle].reset();
+        contextsToSend.Release(contextHandle);
         return len;
 #else
 	length = contextsToSend[contextHandle].bytesXfered;
+	contextsToSend[contextHandle].done = false;
 	contextsToSend[contextHandle].used = false;
         contextsToSend[contextHandle].reset();
+        contextsToSend.Release(contextHandle);
 	return length;
 #endif
     }
@@ -699,13 +800,13 @@ void ConnectionFX3::AbortSending(int ep)
         if (OutEndPt[i] && OutEndPt[i]->Address == ep)
             OutEndPt[i]->Abort();
 #else
-    for (int i = 0; i<USB_MAX_CONTEXTS; ++i)
+    for (int i = 0; i<contextsToSend.Depth(); ++i)
     {
         if(contextsToSend[i].used && contextsToSend[i].transfer->endpoint == 0x01)
             libusb_cancel_transfer(contextsToSend[i].transfer);
     }
 #endif
-    for (int i = 0; i<USB_MAX_CONTEXTS; ++i)
+    for (int i = 0; i<contextsToSend.Depth(); ++i)
     {
         if(contextsToSend[i].used)
         {
@@ -717,9 +818,32 @@ void ConnectionFX3::AbortSending(int ep)
 
 int ConnectionFX3::GetBuffersCount() const
 {
-    return USB_MAX_CONTEXTS;
+    return USBTransferPool::defaultDepth;
 };
 
+int ConnectionFX3::SetTransferDepth(bool tx, int depth)
+{
+    USBTransferPool &pool = tx ? contextsToSend : contexts;
+    if (pool.SetDepth(depth > 0 ? depth : USBTransferPool::defaultDepth) != 0)
+        lime::warning("%s transfer depth not changed, transfers are in flight", tx ? "Tx" : "Rx");
+    return pool.Depth();
+}
+
+int ConnectionFX3::GetTransferStats(bool tx, TransferStats* stats)
+{
+    (tx ? contextsToSend : contexts).GetStats(stats);
+    return 0;
+}
+
+int ConnectionFX3::WaitForCompletions(bool tx, int ep, int* handles, int count, unsigned timeout_ms)
+{
+#ifdef __unix__
+    return (tx ? contextsToSend : contexts).WaitCompleted(ep, handles, count, timeout_ms);
+#else
+    return -1; //CyAPI completes overlapped transfers one by one
+#endif
+}
+
 int ConnectionFX3::CheckStreamSize(int size)const
 {
     return size;
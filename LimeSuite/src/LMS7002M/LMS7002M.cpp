@@ -1179,8 +1179,10 @@ int LMS7002M::TuneCGENVCO()
     if(int status = Modify_SPI_Reg_bits (LMS7_PD_VCO_CGEN.address, 2, 1, 0) != 0)
         return status;
 
-    auto checkCSW = [this] (int cswVal){
+    bool writeFailed = false; //queued writes report failures when flushed
+    auto checkCSW = [this, &writeFailed] (int cswVal){
             Modify_SPI_Reg_bits (LMS7_CSW_VCO_CGEN, cswVal);    //write CSW value
+            writeFailed |= SPI_flush() != 0;
             this_thread::sleep_for(chrono::microseconds(50)); //comparator settling time
             return Get_SPI_Reg_bits(LMS7_VCO_CMPHO_CGEN.address, 13, 12, true); //read comparators
         };
@@ -1208,6 +1210,8 @@ int LMS7002M::TuneCGENVCO()
 
     lime::debug("csw %d; interval [%d, %d]", (cswHigh+cswLow)/2, cswLow, cswHigh);
     auto cmphl = checkCSW((cswHigh+cswLow)/2);
+    if (writeFailed)
+        return ReportError(EIO, "TuneVCO(CGEN) - SPI write failed");
     if(cmphl == 2)
         return 0;
     lime::error("TuneVCO(CGEN) - failed to lock (cmphl!=%d)", cmphl);
@@ -1231,6 +1235,7 @@ int LMS7002M::TuneVCO(VCO_Module module) // 0-cgen, 1-SXR, 2-SXT
     CSWInteval cswSearch[2];
     const char* moduleName = (module == VCO_CGEN) ? "CGEN" : ((module == VCO_SXR) ? "SXR" : "SXT");
     uint8_t cmphl; //comparators
+    bool writeFailed = false; //queued writes report failures when flushed
     uint16_t addrVCOpd; // VCO power down address
     uint16_t addrCSW_VCO;
     uint16_t addrCMP; //comparator address
@@ -1267,6 +1272,7 @@ int LMS7002M::TuneVCO(VCO_Module module) // 0-cgen, 1-SXR, 2-SXT
     //check if lock is within VCO range
     {
         Modify_SPI_Reg_bits (addrCSW_VCO , msb, lsb , 0);
+        writeFailed |= SPI_flush() != 0;
         this_thread::sleep_for(settlingTime);
         cmphl = (uint8_t)Get_SPI_Reg_bits(addrCMP, 13, 12, true);
         if(cmphl == 3) //VCO too high
@@ -1276,6 +1282,7 @@ int LMS7002M::TuneVCO(VCO_Module module) // 0-cgen, 1-SXR, 2-SXT
             return -1;
         }
         Modify_SPI_Reg_bits (addrCSW_VCO , msb, lsb , 255);
+        writeFailed |= SPI_flush() != 0;
         this_thread::sleep_for(settlingTime);
         cmphl = (uint8_t)Get_SPI_Reg_bits(addrCMP, 13, 12, true);
         if(cmphl == 0) //VCO too low
@@ -1296,6 +1303,7 @@ int LMS7002M::TuneVCO(VCO_Module module) // 0-cgen, 1-SXR, 2-SXT
         {
             cswSearch[t].high |= 1 << i; //CSW_VCO<i>=1
             Modify_SPI_Reg_bits (addrCSW_VCO, msb, lsb, cswSearch[t].high);
+            writeFailed |= SPI_flush() != 0;
             this_thread::sleep_for(settlingTime);
             cmphl = (uint8_t)Get_SPI_Reg_bits(addrCMP, 13, 12, true);
             lime::debug ("csw=%d\tcmphl=%d", cswSearch[t].high,(int16_t)cmphl);
@@ -1308,6 +1316,7 @@ int LMS7002M::TuneVCO(VCO_Module module) // 0-cgen, 1-SXR, 2-SXT
         {
             --cswSearch[t].low;
             Modify_SPI_Reg_bits(addrCSW_VCO, msb, lsb, cswSearch[t].low);
+            writeFailed |= SPI_flush() != 0;
             this_thread::sleep_for(settlingTime);
             if(Get_SPI_Reg_bits(addrCMP, 13, 12, true) != 2)
             {
@@ -1345,6 +1354,7 @@ int LMS7002M::TuneVCO(VCO_Module module) // 0-cgen, 1-SXR, 2-SXT
     {
         //check which of two values really locks
         Modify_SPI_Reg_bits(addrCSW_VCO, msb, lsb, cswLow);
+        writeFailed |= SPI_flush() != 0;
         this_thread::sleep_for(settlingTime);
         cmphl = (uint8_t)Get_SPI_Reg_bits(addrCMP, 13, 12, true);
         if(cmphl != 2)
@@ -1352,10 +1362,13 @@ int LMS7002M::TuneVCO(VCO_Module module) // 0-cgen, 1-SXR, 2-SXT
     }
     else
         Modify_SPI_Reg_bits(addrCSW_VCO, msb, lsb, cswLow+(cswHigh-cswLow)/2);
+    writeFailed |= SPI_flush() != 0;
     this_thread::sleep_for(settlingTime);
     cmphl = (uint8_t)Get_SPI_Reg_bits(addrCMP, 13, 12, true);
     lime::debug("cmphl=%d",(uint16_t)cmphl);
     this->SetActiveChannel(ch); //restore previously used channel
+    if (writeFailed)
+        return ReportError(EIO, "TuneVCO(%s) - SPI write failed", moduleName);
     if(cmphl == 2)
         return 0;
     lime::debug("TuneVCO(%s) - failed to lock (cmphl!=2)", moduleName);
@@ -1524,9 +1537,11 @@ int LMS7002M::SetFrequencySX(bool tx, float_type freq_Hz, SX_details* output)
     {
         Modify_SPI_Reg_bits(LMS7param(SEL_VCO), tuning_cache_sel_vco[freq_Hz]);
         Modify_SPI_Reg_bits(LMS7param(CSW_VCO).address, LMS7param(CSW_VCO).msb, LMS7param(CSW_VCO).lsb, tuning_cache_csw_value[freq_Hz]);
+        //failed write falls back to full tuning
+        const bool written = SPI_flush() == 0;
         this_thread::sleep_for(chrono::microseconds(50)); // probably no need for this as the interface is already very slow..
         auto cmphl = (uint8_t)Get_SPI_Reg_bits(LMS7param(VCO_CMPHO).address, 13, 12, true);
-        if(cmphl == 2) {
+        if(written && cmphl == 2) {
             lime::info("Fast Tune success; vco=%d value=%d", tuning_cache_sel_vco[freq_Hz], tuning_cache_csw_value[freq_Hz]);
             this->SetActiveChannel(ch); //restore used channel
             if (output)
@@ -2020,6 +2035,17 @@ int LMS7002M::SPI_read_batch(const uint16_t* spiAddr, uint16_t* spiData, uint16_
     return 0;
 }
 
+/** @brief Waits until register writes queued by the connection reached the chip
+    Needed before delays that let the chip settle after writes.
+    @return 0-success, other-failure of a write queued since the last flush
+*/
+int LMS7002M::SPI_flush()
+{
+    if (!controlPort)
+        return 0;
+    return controlPort->FlushControl();
+}
+
 /** @brief Performs registers test by writing known data and confirming readback data
     @return 0-registers test passed, other-failure
 */
@@ -2657,6 +2683,8 @@ float_type LMS7002M::GetTemperature()
     uint16_t biasMux = Get_SPI_Reg_bits(LMS7_MUX_BIAS_OUT);
     Modify_SPI_Reg_bits(LMS7_MUX_BIAS_OUT, 2);
 
+    if (SPI_flush() != 0)
+        lime::warning("GetTemperature - SPI write failed, temperature may be wrong");
     this_thread::sleep_for(chrono::microseconds(250));
     const uint16_t reg606 = SPI_read(0x0606, true);
     float Vtemp = (reg606 >> 8) & 0xFF;
@@ -2726,6 +2754,8 @@ int LMS7002M::CalibrateAnalogRSSI_DC_Offset()
         if(value < 0)
             wrValue |= 0x40;
         Modify_SPI_Reg_bits(LMS7param(RSSIDC_DCO1), wrValue, true);
+        if (SPI_flush() != 0)
+            return ReportError(EIO, "CalibrateAnalogRSSI_DC_Offset - SPI write failed");
         this_thread::sleep_for(chrono::microseconds(5));
         cmp = Get_SPI_Reg_bits(LMS7param(RSSIDC_CMPSTATUS), true);
         if(cmp != cmpPrev)
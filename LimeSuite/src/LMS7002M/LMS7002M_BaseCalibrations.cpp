@@ -58,6 +58,8 @@ int LMS7002M::CalibrateRP_BIAS()
 
     const uint16_t biasMux = Get_SPI_Reg_bits(LMS7_MUX_BIAS_OUT);
     Modify_SPI_Reg_bits(LMS7_MUX_BIAS_OUT, 1);
+    if (SPI_flush() != 0)
+        return ReportError(EIO, "CalibrateRP_BIAS - SPI write failed");
     this_thread::sleep_for(chrono::microseconds(250));
     uint16_t reg606 = SPI_read(0x0606, true);
     uint16_t Vref = (reg606 >> 8) & 0xFF;
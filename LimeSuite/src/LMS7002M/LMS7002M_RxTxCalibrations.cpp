@@ -190,6 +190,8 @@ static int SetExtLoopback(IConnection* port, uint8_t ch, bool enable, bool tx)
 uint32_t LMS7002M::GetRSSI(RSSI_measurements *measurements)
 {
     //delay to make sure RSSI gets enough samples to refresh before reading it
+    if (SPI_flush() != 0)
+        lime::warning("GetRSSI - SPI write failed");
     this_thread::sleep_for(chrono::microseconds(50));
     Modify_SPI_Reg_bits(LMS7_CAPTURE, 0);
     Modify_SPI_Reg_bits(LMS7_CAPTURE, 1);
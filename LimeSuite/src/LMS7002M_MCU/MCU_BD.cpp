@@ -1053,6 +1053,9 @@ void MCU_BD::SetParameter(MCU_Parameter param, float value)
             mSPI_write(0, inputRegs[2-i]);
             mSPI_write(0x0002, x0002reg | interupt7);
             mSPI_write(0x0002, x0002reg & ~interupt7);
+            //MCU takes each byte on its own interrupt
+            if (m_serPort && m_serPort->FlushControl() != 0)
+                lime::error("MCU parameter write failed");
             this_thread::sleep_for(chrono::microseconds(5));
         }
     }
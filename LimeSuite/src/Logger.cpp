@@ -66,11 +66,16 @@ static void defaultLogHandler(const lime::LogLevel level, const char *message)
 #endif
     fprintf(stderr, "%s\n", message);
     // WAT: Added custom logger.
-    if (level <= lime::LOG_LEVEL_WARNING)
+    eLogLevel watLevel;
+    switch (level)
     {
-    	printDebugLine(lime::logLevelToName(level));
+    case lime::LOG_LEVEL_CRITICAL:
+    case lime::LOG_LEVEL_ERROR: watLevel = LOG_LVL_ERROR; break;
+    case lime::LOG_LEVEL_WARNING: watLevel = LOG_LVL_WARNING; break;
+    case lime::LOG_LEVEL_INFO: watLevel = LOG_LVL_INFO; break;
+    default: watLevel = LOG_LVL_DEBUG; break;
     }
-    printDebugLine(message);
+    printDebugLine(watLevel, message);
 }
 
 static lime::LogHandler logHandler(&defaultLogHandler);
@@ -0,0 +1,130 @@
+/**
+    @file BatchController.cpp
+    @brief Runtime tuning of USB transfer size and transfers in flight
+*/
+
+#include "BatchController.h"
+#include <algorithm>
+#include <math.h>
+
+namespace lime
+{
+
+//completions are reported with USB microframe granularity, later ones were waiting for the host
+static const uint64_t lateMarginUs = 125;
+//periods without late transfers before giving up one transfer in flight
+static const uint32_t quietPeriodsToShrink = 10;
+
+BatchController::Bounds BatchController::MakeBounds(float throughputVsLatency, uint32_t maxPackets, uint32_t maxInFlight)
+{
+    Bounds bounds;
+    const float pref = std::min(1.0f, std::max(0.0f, throughputVsLatency));
+    bounds.minPackets = 1;
+    bounds.maxPackets = std::max<uint32_t>(1, FloorPow2(maxPackets));
+    bounds.maxInFlight = std::max<uint32_t>(1, maxInFlight);
+    bounds.minInFlight = std::min<uint32_t>(2, bounds.maxInFlight);
+    //0.5 ms for lowest latency up to 64 ms for highest throughput
+    bounds.latencyBudget_us = 500 * exp2f(7 * pref);
+    return bounds;
+}
+
+BatchController::BatchController(const Bounds &bounds, uint32_t initialPackets) : mBounds(bounds)
+{
+    mPackets = std::min(mBounds.maxPackets, std::max(mBounds.minPackets, FloorPow2(initialPackets)));
+    mInFlight = std::min(mBounds.maxInFlight, std::max(mBounds.minInFlight, 4u));
+    mNominalUs = 0;
+    mPacketUs = 0;
+    mPeriodStart = 0;
+    mPeriodPackets = 0;
+    mPeriodTransfers = 0;
+    mPeriodLate = 0;
+    mQuietPeriods = 0;
+}
+
+uint32_t BatchController::FloorPow2(uint32_t value)
+{
+    uint32_t pow2 = 1;
+    while (pow2 <= value / 2)
+        pow2 <<= 1;
+    return pow2;
+}
+
+void BatchController::SetPacketTime(double packet_us)
+{
+    mNominalUs = packet_us;
+    if (packet_us > 0)
+        mPacketUs = packet_us;
+}
+
+uint64_t BatchController::ExpectedCompletion(uint64_t now_us, uint32_t transfersAhead, uint32_t packets) const
+{
+    //the link moves data of transfers ahead first
+    return now_us + uint64_t((uint64_t(transfersAhead) * mPackets + packets) * mPacketUs);
+}
+
+void BatchController::OnCompletion(uint32_t packets, uint64_t expected_us, uint64_t reached_us)
+{
+    mPeriodPackets += packets;
+    ++mPeriodTransfers;
+    //without a packet time the expected completion is not known
+    if (mPacketUs > 0 && reached_us > expected_us + lateMarginUs)
+        ++mPeriodLate;
+}
+
+bool BatchController::Due(uint64_t now_us) const
+{
+    return now_us - mPeriodStart >= periodUs;
+}
+
+bool BatchController::Retune(uint64_t now_us, uint32_t fifoPackets, uint32_t fifoSize, bool tx)
+{
+    const uint64_t elapsed = now_us - mPeriodStart;
+    const uint64_t packetsDone = mPeriodPackets;
+    const uint32_t transfers = mPeriodTransfers;
+    const uint32_t late = mPeriodLate;
+    mPeriodStart = now_us;
+    mPeriodPackets = 0;
+    mPeriodTransfers = 0;
+    mPeriodLate = 0;
+    if (transfers == 0 || packetsDone == 0 || elapsed > 10*periodUs) //idle or first period
+        return false;
+
+    const double packetUs = double(elapsed) / packetsDone;
+    if (mNominalUs <= 0)
+        mPacketUs = packetUs;
+
+    uint32_t inFlight = mInFlight;
+    const bool appBehind = !tx && fifoPackets > fifoSize / 2;
+    if (2 * late > transfers || appBehind)
+    {
+        if (inFlight < mBounds.maxInFlight)
+            ++inFlight;
+        mQuietPeriods = 0;
+    }
+    else if (late == 0)
+    {
+        if (++mQuietPeriods >= quietPeriodsToShrink && inFlight > mBounds.minInFlight)
+        {
+            --inFlight;
+            mQuietPeriods = 0;
+        }
+    }
+    else
+        mQuietPeriods = 0;
+
+    //keep data in flight within latency budget
+    const double fit = mBounds.latencyBudget_us / (packetUs * inFlight);
+    uint32_t packets = FloorPow2(fit < 1 ? 1 : fit > mBounds.maxPackets ? mBounds.maxPackets : uint32_t(fit));
+    if (tx)
+        packets = std::min(packets, FloorPow2(std::max<uint32_t>(1, fifoPackets)));
+    //grow gradually, shrink at once
+    packets = std::min(packets, 2 * mPackets);
+    packets = std::min(mBounds.maxPackets, std::max(mBounds.minPackets, packets));
+
+    const bool changed = packets != mPackets || inFlight != mInFlight;
+    mPackets = packets;
+    mInFlight = inFlight;
+    return changed;
+}
+
+}
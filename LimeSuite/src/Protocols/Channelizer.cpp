@@ -0,0 +1,194 @@
+/**
+    @file Channelizer.cpp
+    @brief Polyphase filter bank splitting a stream into uniformly spaced channels and back
+*/
+
+#include "Channelizer.h"
+#include "SampleKernels.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+namespace lime
+{
+
+static inline int16_t SaturateRound(float value)
+{
+    return int16_t(lrintf(std::min(32767.0f, std::max(-32768.0f, value))));
+}
+
+FilterBank::FilterBank(uint32_t channels) : mChannels(channels), mNext(0)
+{
+    const uint32_t M = channels;
+    const uint32_t P = tapsPerBranch;
+    //Blackman windowed sinc, cutoff at half channel spacing, DC gain M/2 keeps taps below 1.0 in Q15
+    const uint32_t length = M * P;
+    std::vector<double> h(length);
+    double sum = 0;
+    for (uint32_t l = 0; l < length; ++l)
+    {
+        const double x = (l - (length - 1) / 2.0) / M;
+        const double sinc = x == 0 ? 1 : sin(M_PI * x) / (M_PI * x);
+        const double window = 0.42 - 0.5 * cos(2 * M_PI * (l + 0.5) / length) + 0.08 * cos(4 * M_PI * (l + 0.5) / length);
+        h[l] = sinc * window;
+        sum += h[l];
+    }
+    //branch p holds h[p + q*M], stored reversed for FirDecimate()
+    mTaps.resize(length);
+    for (uint32_t p = 0; p < M; ++p)
+        for (uint32_t q = 0; q < P; ++q)
+            mTaps[p * P + P - 1 - q] = lrint(32768 * h[p + q * M] * (M / 2.0) / sum);
+
+    mBranches.resize(M, std::vector<complex16_t>(P - 1));
+    mFiltered.resize(M);
+    mBlock.resize(M);
+
+    int bits = 0;
+    while ((1u << bits) < M)
+        ++bits;
+    mReversed.resize(M);
+    for (uint32_t i = 0; i < M; ++i)
+    {
+        uint32_t r = 0;
+        for (int b = 0; b < bits; ++b)
+            if (i & (1u << b))
+                r |= 1u << (bits - 1 - b);
+        mReversed[i] = r;
+    }
+    mTwiddles.resize(M / 2);
+    for (uint32_t i = 0; i < M / 2; ++i)
+        mTwiddles[i] = std::polar(1.0f, float(2 * M_PI * i / M));
+}
+
+//! In place X[k] = sum x[p]*exp(+j*2*pi*k*p/M), radix-2 decimation in time
+void FilterBank::Transform(std::complex<float>* data) const
+{
+    const uint32_t M = mChannels;
+    for (uint32_t i = 0; i < M; ++i)
+        if (i < mReversed[i])
+            std::swap(data[i], data[mReversed[i]]);
+    for (uint32_t len = 2; len <= M; len <<= 1)
+    {
+        const uint32_t half = len / 2;
+        const uint32_t step = M / len;
+        for (uint32_t start = 0; start < M; start += len)
+            for (uint32_t j = 0; j < half; ++j)
+            {
+                const std::complex<float> odd = data[start + j + half] * mTwiddles[j * step];
+                data[start + j + half] = data[start + j] - odd;
+                data[start + j] += odd;
+            }
+    }
+}
+
+void FilterBank::Reset()
+{
+    for (auto &branch : mBranches)
+        memset(branch.data(), 0, (tapsPerBranch - 1)*sizeof(complex16_t));
+}
+
+Channelizer::Channelizer(uint32_t channels) : FilterBank(channels)
+{
+    mInput.resize(channels);
+    mOutputs.resize(channels);
+}
+
+uint32_t Channelizer::Process(const complex16_t* samples, uint32_t count, uint64_t timestamp, uint64_t* outTimestamp)
+{
+    const uint32_t M = mChannels;
+    const uint32_t history = tapsPerBranch - 1;
+    //blocks end at timestamps that are multiples of M, after a discontinuity
+    //the incomplete block is padded with zeros like the filter history
+    const uint32_t pending = (timestamp + M - 1) % M;
+    if (timestamp != mNext)
+    {
+        Reset();
+        memset(mInput.data(), 0, pending*sizeof(complex16_t));
+    }
+    mNext = timestamp + count;
+    const uint32_t total = pending + count;
+    const uint32_t blocks = total / M;
+    *outTimestamp = (timestamp + M - 1 - pending) / M;
+    if (mInput.size() < total)
+        mInput.resize(total);
+    memcpy(&mInput[pending], samples, count*sizeof(complex16_t));
+
+    //branch p gets the sample M-1-p of every block, filtered at channel rate
+    for (uint32_t p = 0; p < M; ++p)
+    {
+        std::vector<complex16_t> &branch = mBranches[p];
+        if (branch.size() < history + blocks)
+            branch.resize(history + blocks);
+        if (mFiltered[p].size() < blocks)
+            mFiltered[p].resize(blocks);
+        for (uint32_t b = 0; b < blocks; ++b)
+            branch[history + b] = mInput[b * M + M - 1 - p];
+        kernels::FirDecimate(branch.data(), blocks, 1, &mTaps[p * tapsPerBranch], tapsPerBranch, mFiltered[p].data());
+        memmove(branch.data(), &branch[blocks], history*sizeof(complex16_t));
+    }
+
+    const float scale = 2.0f / M;
+    for (uint32_t k = 0; k < M; ++k)
+        if (mOutputs[k].size() < blocks)
+            mOutputs[k].resize(blocks);
+    for (uint32_t b = 0; b < blocks; ++b)
+    {
+        for (uint32_t p = 0; p < M; ++p)
+            mBlock[p] = std::complex<float>(mFiltered[p][b].i, mFiltered[p][b].q);
+        Transform(mBlock.data());
+        for (uint32_t k = 0; k < M; ++k)
+        {
+            mOutputs[k][b].i = SaturateRound(mBlock[k].real() * scale);
+            mOutputs[k][b].q = SaturateRound(mBlock[k].imag() * scale);
+        }
+    }
+    memmove(mInput.data(), &mInput[blocks * M], (total - blocks * M)*sizeof(complex16_t));
+    return blocks;
+}
+
+ChannelSynthesizer::ChannelSynthesizer(uint32_t channels) : FilterBank(channels)
+{
+}
+
+const complex16_t* ChannelSynthesizer::Process(const complex16_t* const* inputs, uint32_t count, uint64_t timestamp)
+{
+    const uint32_t M = mChannels;
+    const uint32_t history = tapsPerBranch - 1;
+    if (timestamp != mNext)
+        Reset();
+    mNext = timestamp + uint64_t(count) * M;
+    for (uint32_t p = 0; p < M; ++p)
+    {
+        if (mBranches[p].size() < history + count)
+            mBranches[p].resize(history + count);
+        if (mFiltered[p].size() < count)
+            mFiltered[p].resize(count);
+    }
+    if (mOutput.size() < count * M)
+        mOutput.resize(count * M);
+
+    //interpolation by M loses 1/M of amplitude, filter DC gain gives back M/2
+    for (uint32_t n = 0; n < count; ++n)
+    {
+        for (uint32_t k = 0; k < M; ++k)
+            mBlock[k] = inputs[k] ? std::complex<float>(inputs[k][n].i, inputs[k][n].q) : std::complex<float>();
+        Transform(mBlock.data());
+        for (uint32_t p = 0; p < M; ++p)
+        {
+            mBranches[p][history + n].i = SaturateRound(2 * mBlock[p].real());
+            mBranches[p][history + n].q = SaturateRound(2 * mBlock[p].imag());
+        }
+    }
+    //branch p makes the sample p of every output block
+    for (uint32_t p = 0; p < M; ++p)
+    {
+        std::vector<complex16_t> &branch = mBranches[p];
+        kernels::FirDecimate(branch.data(), count, 1, &mTaps[p * tapsPerBranch], tapsPerBranch, mFiltered[p].data());
+        memmove(branch.data(), &branch[count], history*sizeof(complex16_t));
+        for (uint32_t n = 0; n < count; ++n)
+            mOutput[n * M + p] = mFiltered[p][n];
+    }
+    return mOutput.data();
+}
+
+}
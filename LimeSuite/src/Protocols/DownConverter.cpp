@@ -0,0 +1,127 @@
+/**
+    @file DownConverter.cpp
+    @brief Host side digital down-converter of received samples
+*/
+
+#include "DownConverter.h"
+#include "SampleKernels.h"
+#include <math.h>
+#include <string.h>
+
+namespace lime
+{
+
+static const int oscillatorBits = 12;
+
+//! One period of exp(j*phase) in Q15
+static const std::vector<complex16_t>& OscillatorTable()
+{
+    static const std::vector<complex16_t> table = []()
+    {
+        std::vector<complex16_t> values(1 << oscillatorBits);
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            const double phase = 2 * M_PI * i / values.size();
+            values[i].i = lrint(32767 * cos(phase));
+            values[i].q = lrint(32767 * sin(phase));
+        }
+        return values;
+    }();
+    return table;
+}
+
+//! Blackman windowed half-band low-pass, every other tap except the center one is zero
+static const std::vector<int16_t>& HalfBandTaps()
+{
+    static const std::vector<int16_t> taps = []()
+    {
+        const int length = 23;
+        const int center = length / 2;
+        std::vector<double> h(length);
+        double sum = 0;
+        for (int j = 0; j < length; ++j)
+        {
+            const int n = j - center;
+            const double ideal = n == 0 ? 0.5 : (n % 2 ? sin(M_PI * n / 2) / (M_PI * n) : 0);
+            const double window = 0.42 - 0.5 * cos(2 * M_PI * j / (length - 1)) + 0.08 * cos(4 * M_PI * j / (length - 1));
+            h[j] = ideal * window;
+            sum += h[j];
+        }
+        std::vector<int16_t> values(length);
+        for (int j = 0; j < length; ++j)
+            values[j] = lrint(32768 * h[j] / sum); //unity gain at DC
+        return values;
+    }();
+    return taps;
+}
+
+DownConverter::DownConverter(double frequency, uint32_t decimation) : mDecimation(decimation)
+{
+    SetFrequency(frequency);
+    const uint32_t history = HalfBandTaps().size() - 1;
+    for (uint32_t d = decimation; d > 1; d >>= 1)
+    {
+        Stage stage;
+        stage.input.resize(history);
+        stage.next = 0;
+        mStages.push_back(stage);
+    }
+}
+
+void DownConverter::SetFrequency(double frequency)
+{
+    mPhaseIncrement.store(uint32_t(int64_t(llround(frequency * 4294967296.0))), std::memory_order_relaxed);
+}
+
+double DownConverter::GetFrequency() const
+{
+    return int32_t(mPhaseIncrement.load(std::memory_order_relaxed)) / 4294967296.0;
+}
+
+const complex16_t* DownConverter::Process(const complex16_t* samples, uint32_t count, uint64_t timestamp, uint32_t* outCount, uint64_t* outTimestamp)
+{
+    //buffers grow with the first packet only
+    if (mOscillator.size() < count)
+    {
+        mOscillator.resize(count);
+        mMixed.resize(count);
+    }
+    const std::vector<complex16_t> &table = OscillatorTable();
+    const uint32_t increment = mPhaseIncrement.load(std::memory_order_relaxed);
+    uint32_t phase = uint32_t(increment * timestamp);
+    for (uint32_t i = 0; i < count; ++i, phase += increment)
+        mOscillator[i] = table[phase >> (32 - oscillatorBits)];
+    kernels::MixDown(samples, mOscillator.data(), count, mMixed.data());
+
+    const std::vector<int16_t> &taps = HalfBandTaps();
+    const uint32_t history = taps.size() - 1;
+    const complex16_t* data = mMixed.data();
+    uint32_t n = count;
+    uint64_t ts = timestamp;
+    for (auto &stage : mStages)
+    {
+        if (n == 0)
+            break;
+        if (stage.input.size() < history + n)
+            stage.input.resize(history + n);
+        if (ts != stage.next)
+            memset(stage.input.data(), 0, history*sizeof(complex16_t));
+        memcpy(&stage.input[history], data, n*sizeof(complex16_t));
+        //outputs are produced at odd input timestamps
+        const uint32_t first = (ts & 1) ? 0 : 1;
+        const uint32_t outputs = n > first ? (n - first + 1) / 2 : 0;
+        if (stage.output.size() < outputs)
+            stage.output.resize(outputs);
+        kernels::FirDecimate(&stage.input[first], outputs, 2, taps.data(), taps.size(), stage.output.data());
+        memmove(stage.input.data(), &stage.input[n], history*sizeof(complex16_t));
+        stage.next = ts + n;
+        data = stage.output.data();
+        ts = (ts + first) >> 1;
+        n = outputs;
+    }
+    *outCount = n;
+    *outTimestamp = ts;
+    return data;
+}
+
+}
@@ -40,7 +40,8 @@ static int convertStatus(const int &status, const LMS64CProtocol::GenericPacket
     return ReportError(EPROTO, status2string(pkt.status));
 }
 
-LMS64CProtocol::LMS64CProtocol(void)
+LMS64CProtocol::LMS64CProtocol(void) :
+    mControlBusy(false), mControlQuit(false), mControlError(0)
 {
     //set a sane-default for the rate
     _cachedRefClockRate = 61.44e6/2;
@@ -52,6 +53,7 @@ LMS64CProtocol::LMS64CProtocol(void)
 
 LMS64CProtocol::~LMS64CProtocol(void)
 {
+    StopControlQueue();
 #ifdef REMOTE_CONTROL
     CloseRemote();
 #endif
@@ -126,6 +128,10 @@ int LMS64CProtocol::ReadI2C(const int addr, const size_t numBytes, std::string &
  **********************************************************************/
 int LMS64CProtocol::WriteLMS7002MSPI(const uint32_t *writeData, size_t size, unsigned periphID)
 {
+    //queued writes fail late, FlushControl() reports it
+    if (QueueControl(CMD_LMS7002_WR, periphID, writeData, size, nullptr))
+        return 0;
+
     GenericPacket pkt;
     pkt.cmd = CMD_LMS7002_WR;
     pkt.periphID = periphID;
@@ -146,6 +152,9 @@ int LMS64CProtocol::WriteLMS7002MSPI(const uint32_t *writeData, size_t size, uns
 
 int LMS64CProtocol::ReadLMS7002MSPI(const uint32_t *writeData, uint32_t *readData, size_t size, unsigned periphID)
 {
+    if (GetType() != SPI_PORT)
+        return ReadLMS7002MSPIAsync(writeData, readData, size, periphID).get();
+
     GenericPacket pkt;
     pkt.cmd = CMD_LMS7002_RD;
     pkt.periphID = periphID;
@@ -169,6 +178,216 @@ int LMS64CProtocol::ReadLMS7002MSPI(const uint32_t *writeData, uint32_t *readDat
     return convertStatus(status, pkt);
 }
 
+std::future<int> LMS64CProtocol::ReadLMS7002MSPIAsync(const uint32_t *writeData, uint32_t *readData, size_t size, unsigned periphID)
+{
+    if (GetType() == SPI_PORT)
+    {
+        std::promise<int> done;
+        done.set_value(ReadLMS7002MSPI(writeData, readData, size, periphID));
+        return done.get_future();
+    }
+    return QueueRead(CMD_LMS7002_RD, periphID, writeData, readData, size);
+}
+
+/***********************************************************************
+ * Control queue
+ **********************************************************************/
+/** Default keeps one request in flight, writes are still queued and packed.
+    FX3 uses it: its Read() picks the endpoint by a flag the latest Write() set,
+    so a second request sent before the response is read breaks the pairing.
+*/
+int LMS64CProtocol::GetControlQueueDepth(void)
+{
+    return 1;
+}
+
+int LMS64CProtocol::FlushControl(void)
+{
+    std::unique_lock<std::mutex> lck(mQueueLock);
+    WaitControlIdle(lck);
+    const int status = mControlError;
+    mControlError = 0;
+    return status;
+}
+
+void LMS64CProtocol::WaitControlIdle(std::unique_lock<std::mutex> &lck)
+{
+    mIdleCond.wait(lck, [this]{return mControlQueue.empty() && !mControlBusy;});
+}
+
+void LMS64CProtocol::StopControlQueue(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(mQueueLock);
+        if (!mControlThread.joinable())
+            return;
+        mControlQuit = true;
+    }
+    mQueueCond.notify_one();
+    mControlThread.join();
+}
+
+/** @brief Appends registers to the control queue
+    @return false if connection has no LMS64C packets and request has to be transferred now
+*/
+bool LMS64CProtocol::QueueControl(eCMD_LMS cmd, unsigned periphID, const uint32_t* words, size_t size, std::shared_ptr<PendingRead> read)
+{
+    if (GetType() == SPI_PORT)
+        return false;
+    {
+        std::lock_guard<std::mutex> lock(mQueueLock);
+        if (!mControlThread.joinable())
+        {
+            mControlQuit = false;
+            mControlThread = std::thread(&LMS64CProtocol::ControlLoop, this);
+        }
+        for (size_t i = 0; i < size; ++i)
+        {
+            ControlEntry entry = {cmd, periphID, words[i], read};
+            mControlQueue.push_back(entry);
+        }
+    }
+    mQueueCond.notify_one();
+    return true;
+}
+
+std::future<int> LMS64CProtocol::QueueRead(eCMD_LMS cmd, unsigned periphID, const uint32_t* words, uint32_t* data, size_t size)
+{
+    std::shared_ptr<PendingRead> read(new PendingRead);
+    read->data = data;
+    read->size = size;
+    read->packed = 0;
+    read->status = 0;
+    std::future<int> result = read->done.get_future();
+    if (size == 0)
+        read->done.set_value(0);
+    else
+        QueueControl(cmd, periphID, words, size, read);
+    return result;
+}
+
+/** @brief Moves consecutive registers of the same request type from the queue into one packet
+    Called with mQueueLock held and requests in the queue.
+*/
+void LMS64CProtocol::PackControl(ControlSlot &slot)
+{
+    const eCMD_LMS cmd = mControlQueue.front().cmd;
+    const unsigned periphID = mControlQueue.front().periphID;
+    slot.read = mControlQueue.front().read;
+    slot.offset = slot.read ? slot.read->packed : 0;
+    slot.status = 0;
+    //14 registers fit both as writes and as reads
+    const size_t maxCount = ProtocolLMS64C::maxDataLength/4;
+    const int headerSize = 8;
+    memset(slot.out, 0, sizeof(slot.out));
+    slot.out[0] = cmd;
+    slot.out[1] = STATUS_UNDEFINED;
+    slot.out[3] = periphID;
+    unsigned char* data = &slot.out[headerSize];
+    size_t count = 0;
+    while (count < maxCount && !mControlQueue.empty())
+    {
+        const ControlEntry &entry = mControlQueue.front();
+        if (entry.cmd != cmd || entry.periphID != periphID || entry.read != slot.read)
+            break;
+        const uint16_t addr = cmd == CMD_BRDSPI_RD ? entry.word & 0xFFFF : (entry.word >> 16) & 0x7fff;
+        *data++ = addr >> 8;
+        *data++ = addr & 0xFF;
+        if (cmd == CMD_LMS7002_WR)
+        {
+            *data++ = (entry.word >> 8) & 0xFF;
+            *data++ = entry.word & 0xFF;
+        }
+        mControlQueue.pop_front();
+        ++count;
+    }
+    slot.out[2] = count;
+    slot.count = count;
+    if (slot.read)
+        slot.read->packed += count;
+}
+
+void LMS64CProtocol::CompleteControl(ControlSlot &slot)
+{
+    GenericPacket pkt;
+    pkt.status = eCMD_STATUS(slot.in[1]);
+    const int status = convertStatus(slot.status, pkt);
+    if (!slot.read)
+    {
+        if (status != 0)
+        {
+            std::lock_guard<std::mutex> lock(mQueueLock);
+            mControlError = status;
+        }
+        return;
+    }
+    const int headerSize = 8;
+    if (status == 0)
+        for (size_t i = 0; i < slot.count; ++i)
+            slot.read->data[slot.offset + i] = (slot.in[headerSize + 4*i + 2] << 8) | slot.in[headerSize + 4*i + 3];
+    else
+        slot.read->status = status;
+    if (slot.offset + slot.count == slot.read->size)
+        slot.read->done.set_value(slot.read->status);
+    slot.read.reset();
+}
+
+/** @brief Sends queued requests until the queue is empty
+    Holds mControlPortLock while requests are in flight, so TransferPacket()
+    and other control threads can not interleave their responses.
+*/
+void LMS64CProtocol::ControlLoop(void)
+{
+    const size_t depth = std::max(1, GetControlQueueDepth());
+    std::vector<ControlSlot> slots(depth); //ring of requests in flight
+    size_t head = 0;
+    size_t inFlight = 0;
+    std::unique_lock<std::mutex> lck(mQueueLock);
+    while (true)
+    {
+        mQueueCond.wait(lck, [this]{return mControlQuit || !mControlQueue.empty();});
+        if (mControlQueue.empty())
+            return;
+        mControlBusy = true;
+        lck.unlock();
+        std::unique_lock<std::mutex> port(mControlPortLock);
+        lck.lock();
+        while (inFlight > 0 || !mControlQueue.empty())
+        {
+            //requests coming while the port is busy are packed together
+            if (inFlight < depth && !mControlQueue.empty())
+            {
+                ControlSlot &slot = slots[(head + inFlight) % depth];
+                PackControl(slot);
+                ++inFlight;
+                lck.unlock();
+                if (callback_logData)
+                    callback_logData(true, slot.out, sizeof(slot.out));
+                if (Write(slot.out, sizeof(slot.out)) != sizeof(slot.out))
+                    slot.status = ReportError(EIO, "Write(%d bytes) failed", int(sizeof(slot.out)));
+                lck.lock();
+                continue;
+            }
+            ControlSlot &slot = slots[head];
+            head = (head + 1) % depth;
+            --inFlight;
+            lck.unlock();
+            if (slot.status == 0)
+            {
+                if (Read(slot.in, sizeof(slot.in)) != sizeof(slot.in))
+                    slot.status = ReportError(EIO, "Read(%d bytes) failed", int(sizeof(slot.in)));
+                else if (callback_logData)
+                    callback_logData(false, slot.in, sizeof(slot.in));
+            }
+            CompleteControl(slot);
+            lck.lock();
+        }
+        mControlBusy = false;
+        port.unlock();
+        mIdleCond.notify_all();
+    }
+}
+
 /***********************************************************************
  * Si5351 SPI access
  **********************************************************************/
@@ -254,6 +473,9 @@ int LMS64CProtocol::WriteRegisters(const uint32_t *addrs, const uint32_t *data,
 
 int LMS64CProtocol::ReadRegisters(const uint32_t *addrs, uint32_t *data, const size_t size)
 {
+    if (GetType() != SPI_PORT)
+        return ReadRegistersAsync(addrs, data, size).get();
+
     GenericPacket pkt;
     pkt.cmd = CMD_BRDSPI_RD;
     for (size_t i = 0; i < size; ++i)
@@ -275,6 +497,17 @@ int LMS64CProtocol::ReadRegisters(const uint32_t *addrs, uint32_t *data, const s
     return convertStatus(status, pkt);
 }
 
+std::future<int> LMS64CProtocol::ReadRegistersAsync(const uint32_t *addrs, uint32_t *data, const size_t size)
+{
+    if (GetType() == SPI_PORT)
+    {
+        std::promise<int> done;
+        done.set_value(ReadRegisters(addrs, data, size));
+        return done.get_future();
+    }
+    return QueueRead(CMD_BRDSPI_RD, 0, addrs, data, size);
+}
+
 /***********************************************************************
  * Device Information
  **********************************************************************/
@@ -363,6 +596,11 @@ LMS64CProtocol::FPGAinfo LMS64CProtocol::GetFPGAInfo()
 */
 int LMS64CProtocol::TransferPacket(GenericPacket& pkt)
 {
+    {
+        //queued requests go out first
+        std::unique_lock<std::mutex> lck(mQueueLock);
+        WaitControlIdle(lck);
+    }
     std::lock_guard<std::mutex> lock(mControlPortLock);
     int status = 0;
     if(IsOpen() == false) ReportError(ENOTCONN, "connection is not open");
@@ -390,8 +628,8 @@ int LMS64CProtocol::TransferPacket(GenericPacket& pkt)
     int outLen = 0;
     unsigned char* outBuffer = NULL;
     outBuffer = PreparePacket(pkt, outLen, protocol);
-    unsigned char* inBuffer = new unsigned char[outLen];
-    memset(inBuffer, 0, outLen);
+    mInBuffer.assign(std::max(outLen, 1), 0);
+    unsigned char* inBuffer = mInBuffer.data();
 
     int outBufPos = 0;
     int inDataPos = 0;
@@ -469,7 +707,6 @@ int LMS64CProtocol::TransferPacket(GenericPacket& pkt)
         ParsePacket(pkt, inBuffer, inDataPos, protocol);
     }
     delete[] outBuffer;
-    delete[] inBuffer;
     return convertStatus(status, pkt);
 }
 
@@ -654,6 +891,10 @@ int LMS64CProtocol::ProgramWrite(const char *data_src, const size_t length, cons
     {
         return ReportError(ENOTCONN, "connection is not open");
     }
+    {
+        std::unique_lock<std::mutex> lck(mQueueLock);
+        WaitControlIdle(lck);
+    }
 
     const int pktSize = 32;
     int data_left = length;
@@ -0,0 +1,857 @@
+/**
+    @file SampleKernels.cpp
+    @brief Sample format conversion and measurement kernels of the streaming path.
+
+    12-bit link format stores one I/Q pair in 3 bytes: I[7:0], Q[3:0]I[11:8], Q[11:4].
+    The SIMD kernels shuffle every 3 bytes into two 16-bit lanes (b0,b1) and (b1,b2)
+    and sign extend them with shifts, packing does the reverse.
+*/
+
+#include "SampleKernels.h"
+#include <string.h>
+#include <math.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LIME_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace lime
+{
+namespace kernels
+{
+
+static int Unpack12_tail(const uint8_t* buffer, int b, int bufLen, bool mimo, complex16_t** samples, int collected)
+{
+    int16_t sample;
+    while (b<bufLen)
+    {
+        //I sample
+        sample = buffer[b++];
+        sample |= (buffer[b] << 8);
+        sample <<= 4;
+        samples[0][collected].i = sample >> 4;
+        //Q sample
+        sample =  buffer[b++];
+        sample |= buffer[b++] << 8;
+        samples[0][collected].q = sample >> 4;
+        if (mimo)
+        {
+            //I sample
+            sample = buffer[b++];
+            sample |= (buffer[b] << 8);
+            sample <<= 4;
+            samples[1][collected].i = sample >> 4;
+            //Q sample
+            sample =  buffer[b++];
+            sample |= buffer[b++] << 8;
+            samples[1][collected].q = sample >> 4;
+        }
+        collected++;
+    }
+    return collected;
+}
+
+static int Pack12_tail(const complex16_t* const* samples, int src, int samplesCount, bool mimo, uint8_t* buffer, int b)
+{
+    for(; src<samplesCount; ++src)
+    {
+        buffer[b++] = samples[0][src].i;
+        buffer[b++] = ((samples[0][src].i >> 8) & 0x0F) | (samples[0][src].q << 4);
+        buffer[b++] = samples[0][src].q >> 4;
+        if (mimo)
+        {
+            buffer[b++] = samples[1][src].i;
+            buffer[b++] = ((samples[1][src].i >> 8) & 0x0F) | (samples[1][src].q << 4);
+            buffer[b++] = samples[1][src].q >> 4;
+        }
+    }
+    return b;
+}
+
+static int Deinterleave16_tail(const uint8_t* buffer, int bufLen, complex16_t** samples, int i)
+{
+    const complex16_t* ptr = (const complex16_t*)buffer;
+    const int collected = bufLen/sizeof(complex16_t)/2;
+    for(; i<collected; i++)
+    {
+        samples[0][i] = ptr[2*i];
+        samples[1][i] = ptr[2*i+1];
+    }
+    return collected;
+}
+
+static int Interleave16_tail(const complex16_t* const* samples, int samplesCount, uint8_t* buffer, int src)
+{
+    complex16_t* ptr = (complex16_t*)buffer;
+    for(; src<samplesCount; ++src)
+    {
+        ptr[2*src] = samples[0][src];
+        ptr[2*src+1] = samples[1][src];
+    }
+    return samplesCount*2*sizeof(complex16_t);
+}
+
+//goes backwards so that in place conversion does not overwrite unconverted samples
+static void Int16ToFloat_tail(const complex16_t* src, float* dst, int from, int to, float scale, float offsetI, float offsetQ)
+{
+    for (int i = to-1; i >= from; --i)
+    {
+        const float q = src[i].q*scale + offsetQ;
+        const float in = src[i].i*scale + offsetI;
+        dst[2*i+1] = q;
+        dst[2*i] = in;
+    }
+}
+
+static inline int16_t Saturate16(float value)
+{
+    if (!(value > -32768.0f)) //also catches NaN
+        return -32768;
+    if (value > 32767.0f)
+        return 32767;
+    return lrintf(value);
+}
+
+static void FloatToInt16_tail(const float* src, complex16_t* dst, int from, int to, float scale, float offsetI, float offsetQ)
+{
+    for (int i = from; i < to; ++i)
+    {
+        dst[i].i = Saturate16(src[2*i]*scale + offsetI);
+        dst[i].q = Saturate16(src[2*i+1]*scale + offsetQ);
+    }
+}
+
+static inline uint32_t Power(const complex16_t &sample)
+{
+    return uint32_t(int32_t(sample.i)*sample.i) + uint32_t(int32_t(sample.q)*sample.q);
+}
+
+static uint64_t Energy_tail(const complex16_t* src, int from, int to)
+{
+    uint64_t energy = 0;
+    for (int i = from; i < to; ++i)
+        energy += Power(src[i]);
+    return energy;
+}
+
+static int FindPower_tail(const complex16_t* src, int from, int to, uint32_t threshold, bool above)
+{
+    for (int i = from; i < to; ++i)
+        if ((Power(src[i]) > threshold) == above)
+            return i;
+    return -1;
+}
+
+//pattern elements k0 and above of output n
+static inline void CorrelateOne_tail(const complex16_t* src, int n, int k0, const complex16_t* pattern, int patternLength, int32_t &re, int32_t &im)
+{
+    for (int k = k0; k < patternLength; ++k)
+    {
+        const complex16_t x = src[n+k];
+        re += int32_t(x.i)*pattern[k].i + int32_t(x.q)*pattern[k].q;
+        im += int32_t(x.q)*pattern[k].i - int32_t(x.i)*pattern[k].q;
+    }
+}
+
+uint64_t Energy_scalar(const complex16_t* src, int samplesCount)
+{
+    return Energy_tail(src, 0, samplesCount);
+}
+
+int FindPower_scalar(const complex16_t* src, int samplesCount, uint32_t threshold, bool above)
+{
+    return FindPower_tail(src, 0, samplesCount, threshold, above);
+}
+
+void Correlate_scalar(const complex16_t* src, int outputs, const complex16_t* pattern, int patternLength, int32_t* re, int32_t* im)
+{
+    for (int n = 0; n < outputs; ++n)
+    {
+        re[n] = 0;
+        im[n] = 0;
+        CorrelateOne_tail(src, n, 0, pattern, patternLength, re[n], im[n]);
+    }
+}
+
+static inline int16_t RoundQ15(int32_t value)
+{
+    value = (value + (1 << 14)) >> 15;
+    return value > 32767 ? 32767 : value < -32768 ? -32768 : value;
+}
+
+static void MixDown_tail(const complex16_t* src, const complex16_t* lo, int from, int to, complex16_t* dst)
+{
+    for (int i = from; i < to; ++i)
+    {
+        const int32_t re = int32_t(src[i].i)*lo[i].i + int32_t(src[i].q)*lo[i].q;
+        const int32_t im = int32_t(src[i].q)*lo[i].i - int32_t(src[i].i)*lo[i].q;
+        dst[i].i = RoundQ15(re);
+        dst[i].q = RoundQ15(im);
+    }
+}
+
+//taps from j0 on of output m
+static inline void FirOne_tail(const complex16_t* src, int j0, const int16_t* taps, int tapsCount, int32_t &accI, int32_t &accQ)
+{
+    for (int j = j0; j < tapsCount; ++j)
+    {
+        accI += int32_t(src[j].i)*taps[j];
+        accQ += int32_t(src[j].q)*taps[j];
+    }
+}
+
+void MixDown_scalar(const complex16_t* src, const complex16_t* lo, int samplesCount, complex16_t* dst)
+{
+    MixDown_tail(src, lo, 0, samplesCount, dst);
+}
+
+void FirDecimate_scalar(const complex16_t* src, int outputs, int decimation, const int16_t* taps, int tapsCount, complex16_t* dst)
+{
+    for (int m = 0; m < outputs; ++m)
+    {
+        int32_t accI = 0, accQ = 0;
+        FirOne_tail(&src[m*decimation], 0, taps, tapsCount, accI, accQ);
+        dst[m].i = RoundQ15(accI);
+        dst[m].q = RoundQ15(accQ);
+    }
+}
+
+//pattern with (-Q, I) pairs, multiply-add of samples with it gives the imaginary part of x*conj(p)
+static void RotatePattern(const complex16_t* pattern, int patternLength, complex16_t* rotated)
+{
+    for (int k = 0; k < patternLength; ++k)
+    {
+        rotated[k].i = -pattern[k].q;
+        rotated[k].q = pattern[k].i;
+    }
+}
+
+int Unpack12_scalar(const uint8_t* buffer, int bufLen, bool mimo, complex16_t** samples)
+{
+    return Unpack12_tail(buffer, 0, bufLen, mimo, samples, 0);
+}
+
+int Pack12_scalar(const complex16_t* const* samples, int samplesCount, bool mimo, uint8_t* buffer)
+{
+    return Pack12_tail(samples, 0, samplesCount, mimo, buffer, 0);
+}
+
+void Int16ToFloat_scalar(const complex16_t* src, float* dst, int samplesCount, float scale, float offsetI, float offsetQ)
+{
+    Int16ToFloat_tail(src, dst, 0, samplesCount, scale, offsetI, offsetQ);
+}
+
+void FloatToInt16_scalar(const float* src, complex16_t* dst, int samplesCount, float scale, float offsetI, float offsetQ)
+{
+    FloatToInt16_tail(src, dst, 0, samplesCount, scale, offsetI, offsetQ);
+}
+
+static int Deinterleave16_scalar(const uint8_t* buffer, int bufLen, complex16_t** samples)
+{
+    return Deinterleave16_tail(buffer, bufLen, samples, 0);
+}
+
+static int Interleave16_scalar(const complex16_t* const* samples, int samplesCount, uint8_t* buffer)
+{
+    return Interleave16_tail(samples, samplesCount, buffer, 0);
+}
+
+#ifdef LIME_X86_KERNELS
+
+//---------------------------------------------------------------- SSE2/SSSE3
+
+//sign extends I from lanes (b0,b1) and Q from lanes (b1,b2)
+__attribute__((target("ssse3")))
+static inline __m128i Sign12_ssse3(__m128i x)
+{
+    const __m128i lowMask = _mm_set1_epi32(0x0000FFFF);
+    const __m128i i = _mm_srai_epi16(_mm_slli_epi16(x, 4), 4);
+    const __m128i q = _mm_srai_epi16(x, 4);
+    return _mm_or_si128(_mm_and_si128(lowMask, i), _mm_andnot_si128(lowMask, q));
+}
+
+//4 I/Q pairs into 12 bytes in the low part of the register
+__attribute__((target("ssse3")))
+static inline __m128i Pack4_ssse3(__m128i x)
+{
+    const __m128i shuf = _mm_setr_epi8(0,1,2, 4,5,6, 8,9,10, 12,13,14, -1,-1,-1,-1);
+    const __m128i w = _mm_or_si128(_mm_and_si128(x, _mm_set1_epi32(0xFFF)),
+                                   _mm_and_si128(_mm_srli_epi32(x, 4), _mm_set1_epi32(0xFFF000)));
+    return _mm_shuffle_epi8(w, shuf);
+}
+
+__attribute__((target("sse2")))
+static inline void Store12(uint8_t* dst, __m128i v)
+{
+    _mm_storel_epi64((__m128i*)dst, v);
+    const uint32_t high = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+    memcpy(dst+8, &high, sizeof(high));
+}
+
+__attribute__((target("ssse3")))
+static int Unpack12_ssse3(const uint8_t* buffer, int bufLen, bool mimo, complex16_t** samples)
+{
+    const __m128i shuf = _mm_setr_epi8(0,1,1,2, 3,4,4,5, 6,7,7,8, 9,10,10,11);
+    int b = 0;
+    int collected = 0;
+    //every step consumes 12 bytes but loads 16
+    if (!mimo)
+    {
+        for (; b + 16 <= bufLen; b += 12, collected += 4)
+        {
+            const __m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(buffer+b)), shuf);
+            _mm_storeu_si128((__m128i*)&samples[0][collected], Sign12_ssse3(x));
+        }
+    }
+    else
+    {
+        for (; b + 16 <= bufLen; b += 12, collected += 2)
+        {
+            const __m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(buffer+b)), shuf);
+            //A0 B0 A1 B1 -> A0 A1 B0 B1
+            const __m128i v = _mm_shuffle_epi32(Sign12_ssse3(x), _MM_SHUFFLE(3,1,2,0));
+            _mm_storel_epi64((__m128i*)&samples[0][collected], v);
+            _mm_storel_epi64((__m128i*)&samples[1][collected], _mm_unpackhi_epi64(v, v));
+        }
+    }
+    return Unpack12_tail(buffer, b, bufLen, mimo, samples, collected);
+}
+
+__attribute__((target("ssse3")))
+static int Pack12_ssse3(const complex16_t* const* samples, int samplesCount, bool mimo, uint8_t* buffer)
+{
+    int b = 0;
+    int src = 0;
+    if (!mimo)
+    {
+        for (; src + 4 <= samplesCount; src += 4, b += 12)
+            Store12(buffer+b, Pack4_ssse3(_mm_loadu_si128((const __m128i*)&samples[0][src])));
+    }
+    else
+    {
+        for (; src + 4 <= samplesCount; src += 4, b += 24)
+        {
+            const __m128i a = _mm_loadu_si128((const __m128i*)&samples[0][src]);
+            const __m128i c = _mm_loadu_si128((const __m128i*)&samples[1][src]);
+            Store12(buffer+b, Pack4_ssse3(_mm_unpacklo_epi32(a, c)));
+            Store12(buffer+b+12, Pack4_ssse3(_mm_unpackhi_epi32(a, c)));
+        }
+    }
+    return Pack12_tail(samples, src, samplesCount, mimo, buffer, b);
+}
+
+__attribute__((target("sse2")))
+static int Deinterleave16_sse2(const uint8_t* buffer, int bufLen, complex16_t** samples)
+{
+    const int collected = bufLen/sizeof(complex16_t)/2;
+    int i = 0;
+    for (; i + 2 <= collected; i += 2)
+    {
+        const __m128i x = _mm_loadu_si128((const __m128i*)(buffer + i*2*sizeof(complex16_t)));
+        const __m128i v = _mm_shuffle_epi32(x, _MM_SHUFFLE(3,1,2,0));
+        _mm_storel_epi64((__m128i*)&samples[0][i], v);
+        _mm_storel_epi64((__m128i*)&samples[1][i], _mm_unpackhi_epi64(v, v));
+    }
+    return Deinterleave16_tail(buffer, bufLen, samples, i);
+}
+
+__attribute__((target("sse2")))
+static int Interleave16_sse2(const complex16_t* const* samples, int samplesCount, uint8_t* buffer)
+{
+    int src = 0;
+    for (; src + 4 <= samplesCount; src += 4)
+    {
+        const __m128i a = _mm_loadu_si128((const __m128i*)&samples[0][src]);
+        const __m128i c = _mm_loadu_si128((const __m128i*)&samples[1][src]);
+        _mm_storeu_si128((__m128i*)(buffer + src*2*sizeof(complex16_t)), _mm_unpacklo_epi32(a, c));
+        _mm_storeu_si128((__m128i*)(buffer + (src+2)*2*sizeof(complex16_t)), _mm_unpackhi_epi32(a, c));
+    }
+    return Interleave16_tail(samples, samplesCount, buffer, src);
+}
+
+__attribute__((target("sse2")))
+static void Int16ToFloat_sse2(const complex16_t* src, float* dst, int samplesCount, float scale, float offsetI, float offsetQ)
+{
+    const __m128 vScale = _mm_set1_ps(scale);
+    const __m128 vOffset = _mm_setr_ps(offsetI, offsetQ, offsetI, offsetQ);
+    const int blocks = samplesCount / 4;
+    Int16ToFloat_tail(src, dst, blocks*4, samplesCount, scale, offsetI, offsetQ);
+    //backwards, each block is loaded before its destination overlaps anything unconverted
+    for (int k = blocks-1; k >= 0; --k)
+    {
+        const __m128i x = _mm_loadu_si128((const __m128i*)&src[4*k]);
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+        _mm_storeu_ps(&dst[8*k+4], _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(hi), vScale), vOffset));
+        _mm_storeu_ps(&dst[8*k], _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(lo), vScale), vOffset));
+    }
+}
+
+__attribute__((target("sse2")))
+static void FloatToInt16_sse2(const float* src, complex16_t* dst, int samplesCount, float scale, float offsetI, float offsetQ)
+{
+    const __m128 vScale = _mm_set1_ps(scale);
+    const __m128 vOffset = _mm_setr_ps(offsetI, offsetQ, offsetI, offsetQ);
+    const __m128 vMin = _mm_set1_ps(-32768.0f);
+    const __m128 vMax = _mm_set1_ps(32767.0f);
+    int i = 0;
+    for (; i + 4 <= samplesCount; i += 4)
+    {
+        //clamp before conversion, out of range floats would convert to 0x80000000
+        __m128 a = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&src[2*i]), vScale), vOffset);
+        __m128 b = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&src[2*i+4]), vScale), vOffset);
+        a = _mm_min_ps(_mm_max_ps(a, vMin), vMax);
+        b = _mm_min_ps(_mm_max_ps(b, vMin), vMax);
+        _mm_storeu_si128((__m128i*)&dst[i], _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+    }
+    FloatToInt16_tail(src, dst, i, samplesCount, scale, offsetI, offsetQ);
+}
+
+//multiply-add of a sample with itself gives I*I+Q*Q, it is only used as unsigned
+//since -32768,-32768 wraps to 0x80000000
+__attribute__((target("sse2")))
+static uint64_t Energy_sse2(const complex16_t* src, int samplesCount)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    int i = 0;
+    for (; i + 4 <= samplesCount; i += 4)
+    {
+        const __m128i x = _mm_loadu_si128((const __m128i*)&src[i]);
+        const __m128i p = _mm_madd_epi16(x, x);
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(p, zero));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(p, zero));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    return lanes[0] + lanes[1] + Energy_tail(src, i, samplesCount);
+}
+
+__attribute__((target("sse2")))
+static int FindPower_sse2(const complex16_t* src, int samplesCount, uint32_t threshold, bool above)
+{
+    //unsigned compare through signed one with flipped sign bits
+    const __m128i bias = _mm_set1_epi32(0x80000000);
+    const __m128i vThreshold = _mm_set1_epi32(threshold ^ 0x80000000);
+    const int invert = above ? 0 : 0xF;
+    int i = 0;
+    for (; i + 4 <= samplesCount; i += 4)
+    {
+        const __m128i x = _mm_loadu_si128((const __m128i*)&src[i]);
+        const __m128i p = _mm_xor_si128(_mm_madd_epi16(x, x), bias);
+        const int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(p, vThreshold))) ^ invert;
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    return FindPower_tail(src, i, samplesCount, threshold, above);
+}
+
+__attribute__((target("sse2")))
+static inline int32_t HorizontalSum_sse2(__m128i v)
+{
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1,0,3,2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2,3,0,1)));
+    return _mm_cvtsi128_si32(v);
+}
+
+__attribute__((target("sse2")))
+static void Correlate_sse2(const complex16_t* src, int outputs, const complex16_t* pattern, int patternLength, int32_t* re, int32_t* im)
+{
+    complex16_t rotated[maxCorrelationLength];
+    RotatePattern(pattern, patternLength, rotated);
+    const int blocks = patternLength / 4;
+    for (int n = 0; n < outputs; ++n)
+    {
+        __m128i accRe = _mm_setzero_si128();
+        __m128i accIm = _mm_setzero_si128();
+        for (int k = 0; k < blocks*4; k += 4)
+        {
+            const __m128i x = _mm_loadu_si128((const __m128i*)&src[n+k]);
+            accRe = _mm_add_epi32(accRe, _mm_madd_epi16(x, _mm_loadu_si128((const __m128i*)&pattern[k])));
+            accIm = _mm_add_epi32(accIm, _mm_madd_epi16(x, _mm_loadu_si128((const __m128i*)&rotated[k])));
+        }
+        re[n] = HorizontalSum_sse2(accRe);
+        im[n] = HorizontalSum_sse2(accIm);
+        CorrelateOne_tail(src, n, blocks*4, pattern, patternLength, re[n], im[n]);
+    }
+}
+
+__attribute__((target("sse2")))
+static inline __m128i RoundQ15_sse2(__m128i re, __m128i im)
+{
+    const __m128i half = _mm_set1_epi32(1 << 14);
+    re = _mm_srai_epi32(_mm_add_epi32(re, half), 15);
+    im = _mm_srai_epi32(_mm_add_epi32(im, half), 15);
+    return _mm_packs_epi32(_mm_unpacklo_epi32(re, im), _mm_unpackhi_epi32(re, im));
+}
+
+__attribute__((target("sse2")))
+static void MixDown_sse2(const complex16_t* src, const complex16_t* lo, int samplesCount, complex16_t* dst)
+{
+    //(I, Q)*(c, s) gives real part, (0, Q)*(s, c) - (I, 0)*(s, c) the imaginary one,
+    //subtracting 32-bit products avoids negating s, which has no 16-bit result for -32768
+    const __m128i keepI = _mm_set1_epi32(0x0000FFFF);
+    int i = 0;
+    for (; i + 4 <= samplesCount; i += 4)
+    {
+        const __m128i x = _mm_loadu_si128((const __m128i*)&src[i]);
+        const __m128i l = _mm_loadu_si128((const __m128i*)&lo[i]);
+        const __m128i swapped = _mm_shufflehi_epi16(_mm_shufflelo_epi16(l, _MM_SHUFFLE(2,3,0,1)), _MM_SHUFFLE(2,3,0,1));
+        const __m128i im = _mm_sub_epi32(_mm_madd_epi16(_mm_andnot_si128(keepI, x), swapped),
+                                         _mm_madd_epi16(_mm_and_si128(keepI, x), swapped));
+        _mm_storeu_si128((__m128i*)&dst[i], RoundQ15_sse2(_mm_madd_epi16(x, l), im));
+    }
+    MixDown_tail(src, lo, i, samplesCount, dst);
+}
+
+__attribute__((target("sse2")))
+static void FirDecimate_sse2(const complex16_t* src, int outputs, int decimation, const int16_t* taps, int tapsCount, complex16_t* dst)
+{
+    //taps paired with zeros select I or Q of interleaved samples in multiply-add
+    int16_t tapsI[2*maxFirLength];
+    int16_t tapsQ[2*maxFirLength];
+    for (int j = 0; j < tapsCount; ++j)
+    {
+        tapsI[2*j] = taps[j];
+        tapsI[2*j+1] = 0;
+        tapsQ[2*j] = 0;
+        tapsQ[2*j+1] = taps[j];
+    }
+    const int blocks = tapsCount / 4;
+    for (int m = 0; m < outputs; ++m)
+    {
+        const complex16_t* x = &src[m*decimation];
+        __m128i accI = _mm_setzero_si128();
+        __m128i accQ = _mm_setzero_si128();
+        for (int j = 0; j < blocks*4; j += 4)
+        {
+            const __m128i v = _mm_loadu_si128((const __m128i*)&x[j]);
+            accI = _mm_add_epi32(accI, _mm_madd_epi16(v, _mm_loadu_si128((const __m128i*)&tapsI[2*j])));
+            accQ = _mm_add_epi32(accQ, _mm_madd_epi16(v, _mm_loadu_si128((const __m128i*)&tapsQ[2*j])));
+        }
+        int32_t sumI = HorizontalSum_sse2(accI);
+        int32_t sumQ = HorizontalSum_sse2(accQ);
+        FirOne_tail(x, blocks*4, taps, tapsCount, sumI, sumQ);
+        dst[m].i = RoundQ15(sumI);
+        dst[m].q = RoundQ15(sumQ);
+    }
+}
+
+//---------------------------------------------------------------- AVX2
+
+__attribute__((target("avx2")))
+static inline __m256i Sign12_avx2(__m256i x)
+{
+    const __m256i lowMask = _mm256_set1_epi32(0x0000FFFF);
+    const __m256i i = _mm256_srai_epi16(_mm256_slli_epi16(x, 4), 4);
+    const __m256i q = _mm256_srai_epi16(x, 4);
+    return _mm256_blendv_epi8(q, i, lowMask);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i Pack8_avx2(__m256i x)
+{
+    const __m256i shuf = _mm256_setr_epi8(0,1,2, 4,5,6, 8,9,10, 12,13,14, -1,-1,-1,-1,
+                                          0,1,2, 4,5,6, 8,9,10, 12,13,14, -1,-1,-1,-1);
+    const __m256i w = _mm256_or_si256(_mm256_and_si256(x, _mm256_set1_epi32(0xFFF)),
+                                      _mm256_and_si256(_mm256_srli_epi32(x, 4), _mm256_set1_epi32(0xFFF000)));
+    return _mm256_shuffle_epi8(w, shuf);
+}
+
+//loads 2x12 bytes, one group into each 128-bit lane
+__attribute__((target("avx2")))
+static inline __m256i Load24(const uint8_t* src)
+{
+    const __m128i lo = _mm_loadu_si128((const __m128i*)src);
+    const __m128i hi = _mm_loadu_si128((const __m128i*)(src+12));
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+__attribute__((target("avx2")))
+static int Unpack12_avx2(const uint8_t* buffer, int bufLen, bool mimo, complex16_t** samples)
+{
+    const __m256i shuf = _mm256_setr_epi8(0,1,1,2, 3,4,4,5, 6,7,7,8, 9,10,10,11,
+                                          0,1,1,2, 3,4,4,5, 6,7,7,8, 9,10,10,11);
+    int b = 0;
+    int collected = 0;
+    //every step consumes 24 bytes but loads 28
+    if (!mimo)
+    {
+        for (; b + 28 <= bufLen; b += 24, collected += 8)
+        {
+            const __m256i x = _mm256_shuffle_epi8(Load24(buffer+b), shuf);
+            _mm256_storeu_si256((__m256i*)&samples[0][collected], Sign12_avx2(x));
+        }
+    }
+    else
+    {
+        for (; b + 28 <= bufLen; b += 24, collected += 4)
+        {
+            const __m256i x = _mm256_shuffle_epi8(Load24(buffer+b), shuf);
+            //A0 B0 A1 B1 | A2 B2 A3 B3 -> A0 A1 B0 B1 | A2 A3 B2 B3 -> A0 A1 A2 A3 | B0 B1 B2 B3
+            __m256i v = _mm256_shuffle_epi32(Sign12_avx2(x), _MM_SHUFFLE(3,1,2,0));
+            v = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3,1,2,0));
+            _mm_storeu_si128((__m128i*)&samples[0][collected], _mm256_castsi256_si128(v));
+            _mm_storeu_si128((__m128i*)&samples[1][collected], _mm256_extracti128_si256(v, 1));
+        }
+    }
+    return Unpack12_tail(buffer, b, bufLen, mimo, samples, collected);
+}
+
+__attribute__((target("avx2")))
+static int Pack12_avx2(const complex16_t* const* samples, int samplesCount, bool mimo, uint8_t* buffer)
+{
+    int b = 0;
+    int src = 0;
+    if (!mimo)
+    {
+        for (; src + 8 <= samplesCount; src += 8, b += 24)
+        {
+            const __m256i v = Pack8_avx2(_mm256_loadu_si256((const __m256i*)&samples[0][src]));
+            Store12(buffer+b, _mm256_castsi256_si128(v));
+            Store12(buffer+b+12, _mm256_extracti128_si256(v, 1));
+        }
+    }
+    else
+    {
+        for (; src + 8 <= samplesCount; src += 8, b += 48)
+        {
+            const __m256i a = _mm256_loadu_si256((const __m256i*)&samples[0][src]);
+            const __m256i c = _mm256_loadu_si256((const __m256i*)&samples[1][src]);
+            //A0 B0 A1 B1 | A4 B4 A5 B5 and A2 B2 A3 B3 | A6 B6 A7 B7
+            const __m256i lo = Pack8_avx2(_mm256_unpacklo_epi32(a, c));
+            const __m256i hi = Pack8_avx2(_mm256_unpackhi_epi32(a, c));
+            Store12(buffer+b, _mm256_castsi256_si128(lo));
+            Store12(buffer+b+12, _mm256_castsi256_si128(hi));
+            Store12(buffer+b+24, _mm256_extracti128_si256(lo, 1));
+            Store12(buffer+b+36, _mm256_extracti128_si256(hi, 1));
+        }
+    }
+    return Pack12_tail(samples, src, samplesCount, mimo, buffer, b);
+}
+
+__attribute__((target("avx2")))
+static void Int16ToFloat_avx2(const complex16_t* src, float* dst, int samplesCount, float scale, float offsetI, float offsetQ)
+{
+    const __m256 vScale = _mm256_set1_ps(scale);
+    const __m256 vOffset = _mm256_setr_ps(offsetI, offsetQ, offsetI, offsetQ, offsetI, offsetQ, offsetI, offsetQ);
+    const int blocks = samplesCount / 8;
+    Int16ToFloat_tail(src, dst, blocks*8, samplesCount, scale, offsetI, offsetQ);
+    for (int k = blocks-1; k >= 0; --k)
+    {
+        const __m256i x = _mm256_loadu_si256((const __m256i*)&src[8*k]);
+        const __m256i lo = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(x));
+        const __m256i hi = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(x, 1));
+        _mm256_storeu_ps(&dst[16*k+8], _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(hi), vScale), vOffset));
+        _mm256_storeu_ps(&dst[16*k], _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(lo), vScale), vOffset));
+    }
+}
+
+__attribute__((target("avx2")))
+static void FloatToInt16_avx2(const float* src, complex16_t* dst, int samplesCount, float scale, float offsetI, float offsetQ)
+{
+    const __m256 vScale = _mm256_set1_ps(scale);
+    const __m256 vOffset = _mm256_setr_ps(offsetI, offsetQ, offsetI, offsetQ, offsetI, offsetQ, offsetI, offsetQ);
+    const __m256 vMin = _mm256_set1_ps(-32768.0f);
+    const __m256 vMax = _mm256_set1_ps(32767.0f);
+    int i = 0;
+    for (; i + 8 <= samplesCount; i += 8)
+    {
+        __m256 a = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(&src[2*i]), vScale), vOffset);
+        __m256 b = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(&src[2*i+8]), vScale), vOffset);
+        a = _mm256_min_ps(_mm256_max_ps(a, vMin), vMax);
+        b = _mm256_min_ps(_mm256_max_ps(b, vMin), vMax);
+        //packs works per 128-bit lane, permute restores sample order
+        const __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        _mm256_storeu_si256((__m256i*)&dst[i], _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3,1,2,0)));
+    }
+    FloatToInt16_tail(src, dst, i, samplesCount, scale, offsetI, offsetQ);
+}
+
+__attribute__((target("avx2")))
+static uint64_t Energy_avx2(const complex16_t* src, int samplesCount)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = zero;
+    int i = 0;
+    for (; i + 8 <= samplesCount; i += 8)
+    {
+        const __m256i x = _mm256_loadu_si256((const __m256i*)&src[i]);
+        const __m256i p = _mm256_madd_epi16(x, x);
+        acc = _mm256_add_epi64(acc, _mm256_unpacklo_epi32(p, zero));
+        acc = _mm256_add_epi64(acc, _mm256_unpackhi_epi32(p, zero));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + Energy_tail(src, i, samplesCount);
+}
+
+__attribute__((target("avx2")))
+static int FindPower_avx2(const complex16_t* src, int samplesCount, uint32_t threshold, bool above)
+{
+    const __m256i bias = _mm256_set1_epi32(0x80000000);
+    const __m256i vThreshold = _mm256_set1_epi32(threshold ^ 0x80000000);
+    const int invert = above ? 0 : 0xFF;
+    int i = 0;
+    for (; i + 8 <= samplesCount; i += 8)
+    {
+        const __m256i x = _mm256_loadu_si256((const __m256i*)&src[i]);
+        const __m256i p = _mm256_xor_si256(_mm256_madd_epi16(x, x), bias);
+        const int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(p, vThreshold))) ^ invert;
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    return FindPower_tail(src, i, samplesCount, threshold, above);
+}
+
+__attribute__((target("avx2")))
+static void Correlate_avx2(const complex16_t* src, int outputs, const complex16_t* pattern, int patternLength, int32_t* re, int32_t* im)
+{
+    complex16_t rotated[maxCorrelationLength];
+    RotatePattern(pattern, patternLength, rotated);
+    const int blocks = patternLength / 8;
+    for (int n = 0; n < outputs; ++n)
+    {
+        __m256i accRe = _mm256_setzero_si256();
+        __m256i accIm = _mm256_setzero_si256();
+        for (int k = 0; k < blocks*8; k += 8)
+        {
+            const __m256i x = _mm256_loadu_si256((const __m256i*)&src[n+k]);
+            accRe = _mm256_add_epi32(accRe, _mm256_madd_epi16(x, _mm256_loadu_si256((const __m256i*)&pattern[k])));
+            accIm = _mm256_add_epi32(accIm, _mm256_madd_epi16(x, _mm256_loadu_si256((const __m256i*)&rotated[k])));
+        }
+        re[n] = HorizontalSum_sse2(_mm_add_epi32(_mm256_castsi256_si128(accRe), _mm256_extracti128_si256(accRe, 1)));
+        im[n] = HorizontalSum_sse2(_mm_add_epi32(_mm256_castsi256_si128(accIm), _mm256_extracti128_si256(accIm, 1)));
+        CorrelateOne_tail(src, n, blocks*8, pattern, patternLength, re[n], im[n]);
+    }
+}
+
+#endif // LIME_X86_KERNELS
+
+//---------------------------------------------------------------- dispatch
+
+struct KernelSet
+{
+    const char* isa;
+    int (*unpack12)(const uint8_t*, int, bool, complex16_t**);
+    int (*pack12)(const complex16_t* const*, int, bool, uint8_t*);
+    int (*deinterleave16)(const uint8_t*, int, complex16_t**);
+    int (*interleave16)(const complex16_t* const*, int, uint8_t*);
+    void (*int16ToFloat)(const complex16_t*, float*, int, float, float, float);
+    void (*floatToInt16)(const float*, complex16_t*, int, float, float, float);
+    uint64_t (*energy)(const complex16_t*, int);
+    int (*findPower)(const complex16_t*, int, uint32_t, bool);
+    void (*correlate)(const complex16_t*, int, const complex16_t*, int, int32_t*, int32_t*);
+    void (*mixDown)(const complex16_t*, const complex16_t*, int, complex16_t*);
+    void (*firDecimate)(const complex16_t*, int, int, const int16_t*, int, complex16_t*);
+};
+
+static KernelSet SelectKernels()
+{
+    KernelSet set = {"scalar", Unpack12_scalar, Pack12_scalar, Deinterleave16_scalar, Interleave16_scalar,
+                      Int16ToFloat_scalar, FloatToInt16_scalar, Energy_scalar, FindPower_scalar, Correlate_scalar,
+                      MixDown_scalar, FirDecimate_scalar};
+#ifdef LIME_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))
+    {
+        set.deinterleave16 = Deinterleave16_sse2;
+        set.interleave16 = Interleave16_sse2;
+        set.int16ToFloat = Int16ToFloat_sse2;
+        set.floatToInt16 = FloatToInt16_sse2;
+        set.energy = Energy_sse2;
+        set.findPower = FindPower_sse2;
+        set.correlate = Correlate_sse2;
+        set.mixDown = MixDown_sse2;
+        set.firDecimate = FirDecimate_sse2;
+    }
+    if (__builtin_cpu_supports("ssse3"))
+    {
+        set.isa = "ssse3";
+        set.unpack12 = Unpack12_ssse3;
+        set.pack12 = Pack12_ssse3;
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        set.isa = "avx2";
+        set.unpack12 = Unpack12_avx2;
+        set.pack12 = Pack12_avx2;
+        set.int16ToFloat = Int16ToFloat_avx2;
+        set.floatToInt16 = FloatToInt16_avx2;
+        set.energy = Energy_avx2;
+        set.findPower = FindPower_avx2;
+        set.correlate = Correlate_avx2;
+    }
+#endif
+    return set;
+}
+
+static const KernelSet& Kernels()
+{
+    static const KernelSet set = SelectKernels();
+    return set;
+}
+
+const char* SelectedISA()
+{
+    return Kernels().isa;
+}
+
+int Unpack12(const uint8_t* buffer, int bufLen, bool mimo, complex16_t** samples)
+{
+    return Kernels().unpack12(buffer, bufLen, mimo, samples);
+}
+
+int Pack12(const complex16_t* const* samples, int samplesCount, bool mimo, uint8_t* buffer)
+{
+    return Kernels().pack12(samples, samplesCount, mimo, buffer);
+}
+
+int Deinterleave16(const uint8_t* buffer, int bufLen, complex16_t** samples)
+{
+    return Kernels().deinterleave16(buffer, bufLen, samples);
+}
+
+int Interleave16(const complex16_t* const* samples, int samplesCount, uint8_t* buffer)
+{
+    return Kernels().interleave16(samples, samplesCount, buffer);
+}
+
+void Int16ToFloat(const complex16_t* src, float* dst, int samplesCount, float scale, float offsetI, float offsetQ)
+{
+    Kernels().int16ToFloat(src, dst, samplesCount, scale, offsetI, offsetQ);
+}
+
+void FloatToInt16(const float* src, complex16_t* dst, int samplesCount, float scale, float offsetI, float offsetQ)
+{
+    Kernels().floatToInt16(src, dst, samplesCount, scale, offsetI, offsetQ);
+}
+
+uint64_t Energy(const complex16_t* src, int samplesCount)
+{
+    return Kernels().energy(src, samplesCount);
+}
+
+int FindPower(const complex16_t* src, int samplesCount, uint32_t threshold, bool above)
+{
+    return Kernels().findPower(src, samplesCount, threshold, above);
+}
+
+void Correlate(const complex16_t* src, int outputs, const complex16_t* pattern, int patternLength, int32_t* re, int32_t* im)
+{
+    Kernels().correlate(src, outputs, pattern, patternLength, re, im);
+}
+
+void MixDown(const complex16_t* src, const complex16_t* lo, int samplesCount, complex16_t* dst)
+{
+    Kernels().mixDown(src, lo, samplesCount, dst);
+}
+
+void FirDecimate(const complex16_t* src, int outputs, int decimation, const int16_t* taps, int tapsCount, complex16_t* dst)
+{
+    Kernels().firDecimate(src, outputs, decimation, taps, tapsCount, dst);
+}
+
+}
+}
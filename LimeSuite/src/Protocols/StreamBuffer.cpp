@@ -0,0 +1,179 @@
+/**
+    @file StreamBuffer.cpp
+    @brief Memory allocation for streaming buffers (USB transfers and FIFOs)
+*/
+
+#include "StreamBuffer.h"
+#include "Logger.h"
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <malloc.h>
+#endif
+
+namespace lime
+{
+
+static const size_t pageSize = 4096;
+static std::atomic<StreamAllocator*> currentAllocator(nullptr);
+
+static inline size_t RoundUp(size_t value, size_t step)
+{
+    return (value + step - 1) / step * step;
+}
+
+StreamAllocator* StreamAllocator::Get()
+{
+    StreamAllocator* allocator = currentAllocator.load(std::memory_order_acquire);
+    return allocator ? allocator : &DefaultStreamAllocator::Instance();
+}
+
+void StreamAllocator::Set(StreamAllocator* allocator)
+{
+    currentAllocator.store(allocator, std::memory_order_release);
+}
+
+DefaultStreamAllocator::DefaultStreamAllocator() : mOptions(0)
+{
+}
+
+DefaultStreamAllocator& DefaultStreamAllocator::Instance()
+{
+    static DefaultStreamAllocator allocator;
+    return allocator;
+}
+
+void DefaultStreamAllocator::SetOptions(uint32_t options)
+{
+    mOptions.store(options);
+}
+
+uint32_t DefaultStreamAllocator::GetOptions() const
+{
+    return mOptions.load();
+}
+
+#ifdef __linux__
+
+void* DefaultStreamAllocator::Allocate(size_t &bytes)
+{
+    const uint32_t options = mOptions.load();
+    const bool huge = (options & HUGE_PAGES) && bytes >= hugePageSize;
+    bytes = RoundUp(bytes ? bytes : 1, huge ? hugePageSize : pageSize);
+
+    void* ptr = MAP_FAILED;
+    if (huge)
+    {
+        //explicit huge pages need a reserved pool, otherwise ask for transparent ones
+        ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr == MAP_FAILED)
+        {
+            ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (ptr != MAP_FAILED)
+                madvise(ptr, bytes, MADV_HUGEPAGE);
+        }
+    }
+    else
+        ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED)
+        return nullptr;
+
+    if (options & LOCK_MEMORY)
+    {
+        //lock pages as they are faulted in, so they still land on the node that touches them first
+#ifdef MLOCK_ONFAULT
+        int status = mlock2(ptr, bytes, MLOCK_ONFAULT);
+#else
+        int status = mlock(ptr, bytes);
+#endif
+        if (status != 0)
+            lime::warning("Failed to lock %zu bytes of stream buffers, check RLIMIT_MEMLOCK", bytes);
+    }
+    return ptr;
+}
+
+void DefaultStreamAllocator::Free(void* ptr, size_t bytes)
+{
+    if (ptr)
+        munmap(ptr, bytes);
+}
+
+#else
+
+void* DefaultStreamAllocator::Allocate(size_t &bytes)
+{
+    bytes = RoundUp(bytes ? bytes : 1, pageSize);
+#ifdef _WIN32
+    void* ptr = _aligned_malloc(bytes, pageSize);
+#else
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, pageSize, bytes) != 0)
+        ptr = nullptr;
+#endif
+    if (ptr)
+        memset(ptr, 0, bytes);
+    return ptr;
+}
+
+void DefaultStreamAllocator::Free(void* ptr, size_t bytes)
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+#endif
+
+StreamBuffer::StreamBuffer() : mPtr(nullptr), mSize(0), mReserved(0), mAllocator(nullptr)
+{
+}
+
+StreamBuffer::StreamBuffer(size_t bytes) : mPtr(nullptr), mSize(0), mReserved(0), mAllocator(nullptr)
+{
+    Allocate(bytes);
+}
+
+StreamBuffer::~StreamBuffer()
+{
+    Release();
+}
+
+void StreamBuffer::Allocate(size_t bytes)
+{
+    Release();
+    StreamAllocator* allocator = StreamAllocator::Get();
+    size_t reserved = bytes;
+    void* ptr = allocator->Allocate(reserved);
+    if (ptr == nullptr)
+        throw std::bad_alloc();
+    mPtr = ptr;
+    mSize = bytes;
+    mReserved = reserved;
+    mAllocator = allocator;
+}
+
+void StreamBuffer::Release()
+{
+    if (mPtr)
+        mAllocator->Free(mPtr, mReserved);
+    mPtr = nullptr;
+    mSize = 0;
+    mReserved = 0;
+    mAllocator = nullptr;
+}
+
+void StreamBuffer::Touch()
+{
+    volatile char* bytes = static_cast<char*>(mPtr);
+    for (size_t i = 0; i < mSize; i += pageSize)
+        bytes[i] = 0;
+}
+
+}
@@ -0,0 +1,275 @@
+/**
+    @file StreamExecutor.cpp
+    @brief Coroutine tasks awaiting stream operations on a small thread pool
+*/
+
+#include "StreamExecutor.h"
+
+#ifdef LIME_STREAM_COROUTINES
+#include "Logger.h"
+#include <algorithm>
+
+namespace lime
+{
+
+//reactor re-checks at least this often, notifications normally wake it much earlier
+static const auto reactorPeriod = std::chrono::seconds(1);
+
+//! Coroutine owning itself, used for spawned tasks
+struct StreamExecutor::Detached
+{
+    struct promise_type
+    {
+        Detached get_return_object() const {return Detached();}
+        std::suspend_never initial_suspend() const noexcept {return {};}
+        std::suspend_never final_suspend() const noexcept {return {};}
+        void return_void() const {}
+        void unhandled_exception() const {std::terminate();}
+    };
+};
+
+StreamExecutor::StreamExecutor(unsigned threads) : mStopping(false), mQuit(false), mTasks(0)
+{
+    for (unsigned i = 0; i < std::max(1u, threads); ++i)
+        mWorkers.push_back(std::thread(&StreamExecutor::WorkerLoop, this));
+    mReactor = std::thread(&StreamExecutor::ReactorLoop, this);
+}
+
+StreamExecutor::~StreamExecutor()
+{
+    Stop();
+    {
+        std::lock_guard<std::mutex> lck(mQueueLock);
+        mQuit = true;
+    }
+    mQueueCond.notify_all();
+    mEvent.Notify();
+    for (auto &worker : mWorkers)
+        worker.join();
+    mReactor.join();
+    for (auto channel : mChannels)
+        channel->SetEvent(nullptr);
+}
+
+void StreamExecutor::Spawn(Task<void> task)
+{
+    {
+        std::lock_guard<std::mutex> lck(mTasksLock);
+        ++mTasks;
+    }
+    Launch(std::move(task));
+}
+
+StreamExecutor::Detached StreamExecutor::Launch(Task<void> task)
+{
+    co_await Schedule();
+    try
+    {
+        co_await task;
+    }
+    catch (const std::exception &e)
+    {
+        lime::error("Stream task failed: %s", e.what());
+    }
+    catch (...)
+    {
+        lime::error("Stream task failed: unknown exception");
+    }
+    std::lock_guard<std::mutex> lck(mTasksLock);
+    --mTasks;
+    mTasksCond.notify_all();
+}
+
+void StreamExecutor::Stop()
+{
+    mStopping.store(true, std::memory_order_release);
+    mEvent.Notify();
+    std::unique_lock<std::mutex> lck(mTasksLock);
+    mTasksCond.wait(lck, [this]{return mTasks == 0;});
+}
+
+void StreamExecutor::Release(StreamChannel* channel)
+{
+    std::lock_guard<std::mutex> lck(mWaitersLock);
+    auto iter = std::find(mChannels.begin(), mChannels.end(), channel);
+    if (iter == mChannels.end())
+        return;
+    mChannels.erase(iter);
+    channel->SetEvent(nullptr);
+}
+
+void StreamExecutor::Post(std::coroutine_handle<> handle)
+{
+    {
+        std::lock_guard<std::mutex> lck(mQueueLock);
+        mQueue.push_back(handle);
+    }
+    mQueueCond.notify_one();
+}
+
+bool StreamExecutor::IsReady(StreamChannel* channel)
+{
+    uint32_t filled, size;
+    channel->GetFIFOPackets(&filled, &size);
+    return channel->config.isTx ? filled < size : filled > 0;
+}
+
+//! @return false if the task has to continue without suspending
+bool StreamExecutor::Enqueue(StreamChannel* channel, std::coroutine_handle<> handle)
+{
+    {
+        std::lock_guard<std::mutex> lck(mWaitersLock);
+        if (Stopping())
+            return false;
+        if (std::find(mChannels.begin(), mChannels.end(), channel) == mChannels.end())
+        {
+            channel->SetEvent(&mEvent);
+            mChannels.push_back(channel);
+        }
+        mWaiters.push_back(Waiter{channel, handle});
+    }
+    //reactor re-checks, covers packets that came before the event was set
+    mEvent.Notify();
+    return true;
+}
+
+bool StreamExecutor::EnqueueTimer(std::chrono::steady_clock::time_point deadline, std::coroutine_handle<> handle)
+{
+    {
+        std::lock_guard<std::mutex> lck(mWaitersLock);
+        if (Stopping())
+            return false;
+        mTimers.push_back(Timer{deadline, handle});
+    }
+    mEvent.Notify();
+    return true;
+}
+
+void StreamExecutor::WorkerLoop()
+{
+    while (true)
+    {
+        std::coroutine_handle<> handle;
+        {
+            std::unique_lock<std::mutex> lck(mQueueLock);
+            mQueueCond.wait(lck, [this]{return mQuit || !mQueue.empty();});
+            if (mQueue.empty())
+                return;
+            handle = mQueue.front();
+            mQueue.pop_front();
+        }
+        handle.resume();
+    }
+}
+
+void StreamExecutor::ReactorLoop()
+{
+    std::vector<std::coroutine_handle<> > ready;
+    while (true)
+    {
+        const uint32_t seq = mEvent.Prepare();
+        const bool stopping = Stopping();
+        const auto now = std::chrono::steady_clock::now();
+        auto wake = now + reactorPeriod;
+        {
+            std::lock_guard<std::mutex> lck(mWaitersLock);
+            for (size_t i = 0; i < mWaiters.size(); )
+            {
+                if (stopping || IsReady(mWaiters[i].channel))
+                {
+                    ready.push_back(mWaiters[i].handle);
+                    mWaiters[i] = mWaiters.back();
+                    mWaiters.pop_back();
+                }
+                else
+                    ++i;
+            }
+            for (size_t i = 0; i < mTimers.size(); )
+            {
+                if (stopping || mTimers[i].deadline <= now)
+                {
+                    ready.push_back(mTimers[i].handle);
+                    mTimers[i] = mTimers.back();
+                    mTimers.pop_back();
+                }
+                else
+                {
+                    wake = std::min(wake, mTimers[i].deadline);
+                    ++i;
+                }
+            }
+        }
+        if (!ready.empty())
+        {
+            mEvent.Cancel();
+            for (auto handle : ready)
+                Post(handle);
+            ready.clear();
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lck(mQueueLock);
+            if (mQuit)
+            {
+                mEvent.Cancel();
+                return;
+            }
+        }
+        const auto wait = std::chrono::duration_cast<std::chrono::microseconds>(wake - now).count();
+        mEvent.Wait(seq, std::max<int64_t>(1, wait));
+    }
+}
+
+Task<int> StreamExecutor::Read(StreamChannel* channel, void* samples, uint32_t count, StreamChannel::Metadata* meta)
+{
+    if (channel->config.isTx)
+        co_return -1;
+    const size_t sampleSize = channel->config.format == StreamConfig::FMT_FLOAT32 ? 2*sizeof(float) : sizeof(complex16_t);
+    meta->flags = 0;
+    uint32_t done = 0;
+    while (done < count)
+    {
+        StreamChannel::Metadata chunk = {0, 0};
+        const int n = channel->Read(static_cast<char*>(samples) + done*sampleSize, count - done, &chunk, 0);
+        if (n < 0)
+            co_return -1;
+        if (done == 0 && n > 0)
+            meta->timestamp = chunk.timestamp;
+        meta->flags |= chunk.flags;
+        done += n;
+        if (done == count)
+            break;
+        //awaits are kept out of conditions, some compilers mishandle them there
+        const bool ready = co_await Ready(channel);
+        if (!ready)
+            break;
+    }
+    co_return done;
+}
+
+Task<int> StreamExecutor::Write(StreamChannel* channel, const void* samples, uint32_t count, const StreamChannel::Metadata* meta)
+{
+    if (!channel->config.isTx)
+        co_return -1;
+    const size_t sampleSize = channel->config.format == StreamConfig::FMT_FLOAT32 ? 2*sizeof(float) : sizeof(complex16_t);
+    uint32_t done = 0;
+    while (done < count)
+    {
+        const StreamChannel::Metadata chunk = {meta->timestamp + done, meta->flags};
+        const int n = channel->Write(static_cast<const char*>(samples) + done*sampleSize, count - done, &chunk, 0);
+        if (n < 0)
+            co_return -1;
+        done += n;
+        if (done == count)
+            break;
+        //awaits are kept out of conditions, some compilers mishandle them there
+        const bool ready = co_await Ready(channel);
+        if (!ready)
+            break;
+    }
+    co_return done;
+}
+
+}
+
+#endif // LIME_STREAM_COROUTINES
@@ -0,0 +1,201 @@
+/**
+    @file StreamProfiler.cpp
+    @brief Per-stage latency histograms and timeline tracing of the streaming path
+*/
+
+#include "StreamProfiler.h"
+#include "Logger.h"
+#include <cstdio>
+
+namespace lime
+{
+
+static const char* stageNames[STAGE_COUNT] = {
+    "rx_usb_wait",
+    "rx_parse",
+    "rx_fifo_push",
+    "rx_app_read",
+    "tx_app_write",
+    "tx_fifo_pop",
+    "tx_build",
+    "tx_usb_wait",
+    "app_process"
+};
+
+static uint32_t ThreadIndex()
+{
+    static std::atomic<uint32_t> threadsCount(0);
+    thread_local uint32_t index = ++threadsCount;
+    return index;
+}
+
+StreamProfiler& StreamProfiler::Instance()
+{
+    static StreamProfiler profiler;
+    return profiler;
+}
+
+StreamProfiler::StreamProfiler() : enabled(false), tracing(false), traceIndex(0)
+{
+    trace = new TraceEvent[traceSize];
+    for (uint32_t i = 0; i < traceSize; ++i)
+        trace[i].seq.store(0);
+    Reset();
+}
+
+const char* StreamProfiler::StageName(StreamStage stage)
+{
+    if (stage < 0 || stage >= STAGE_COUNT)
+        return "unknown";
+    return stageNames[stage];
+}
+
+void StreamProfiler::SetEnabled(bool enable)
+{
+    if (!enable)
+        tracing.store(false);
+    enabled.store(enable);
+}
+
+void StreamProfiler::SetTracing(bool enable)
+{
+    //tracing needs the timers to be running
+    if (enable)
+        enabled.store(true);
+    tracing.store(enable);
+}
+
+int StreamProfiler::BucketIndex(uint64_t value)
+{
+    if (value < linearBuckets)
+        return value;
+    const int msb = 63 - __builtin_clzll(value);
+    const int sub = (value >> (msb - subBucketBits)) & ((1 << subBucketBits) - 1);
+    return linearBuckets + (msb - 4) * (1 << subBucketBits) + sub;
+}
+
+uint64_t StreamProfiler::BucketValue(int index)
+{
+    if (index < linearBuckets)
+        return index;
+    const int msb = (index - linearBuckets) / (1 << subBucketBits) + 4;
+    const int sub = (index - linearBuckets) % (1 << subBucketBits);
+    const uint64_t low = uint64_t((1 << subBucketBits) + sub) << (msb - subBucketBits);
+    //middle of the bucket
+    return low + ((uint64_t(1) << (msb - subBucketBits)) >> 1);
+}
+
+void StreamProfiler::Record(StreamStage stage, uint64_t start_ns, uint64_t duration_ns)
+{
+    Histogram &h = histograms[stage];
+    h.buckets[BucketIndex(duration_ns)].fetch_add(1, std::memory_order_relaxed);
+    h.count.fetch_add(1, std::memory_order_relaxed);
+    h.sum.fetch_add(duration_ns, std::memory_order_relaxed);
+    uint64_t cur = h.max.load(std::memory_order_relaxed);
+    while (duration_ns > cur && !h.max.compare_exchange_weak(cur, duration_ns, std::memory_order_relaxed));
+    cur = h.min.load(std::memory_order_relaxed);
+    while (duration_ns < cur && !h.min.compare_exchange_weak(cur, duration_ns, std::memory_order_relaxed));
+
+    if (!tracing.load(std::memory_order_relaxed))
+        return;
+    const uint64_t index = traceIndex.fetch_add(1, std::memory_order_relaxed);
+    TraceEvent &ev = trace[index & (traceSize - 1)];
+    ev.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    ev.start_ns = start_ns;
+    ev.duration_ns = duration_ns;
+    ev.thread = ThreadIndex();
+    ev.stage = stage;
+    ev.seq.store(index + 1, std::memory_order_release);
+}
+
+StreamProfiler::StageStats StreamProfiler::GetStats(StreamStage stage) const
+{
+    StageStats stats;
+    memset(&stats, 0, sizeof(stats));
+    if (stage < 0 || stage >= STAGE_COUNT)
+        return stats;
+
+    const Histogram &h = histograms[stage];
+    uint64_t counts[bucketsCount];
+    uint64_t total = 0;
+    for (int i = 0; i < bucketsCount; ++i)
+    {
+        counts[i] = h.buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0)
+        return stats;
+
+    stats.count = total;
+    stats.min_ns = h.min.load(std::memory_order_relaxed);
+    stats.max_ns = h.max.load(std::memory_order_relaxed);
+    stats.mean_ns = h.sum.load(std::memory_order_relaxed) / total;
+
+    const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    uint64_t* results[] = {&stats.p50_ns, &stats.p90_ns, &stats.p99_ns, &stats.p999_ns};
+    uint64_t seen = 0;
+    int q = 0;
+    for (int i = 0; i < bucketsCount && q < 4; ++i)
+    {
+        seen += counts[i];
+        while (q < 4 && seen >= quantiles[q] * total)
+        {
+            uint64_t value = BucketValue(i);
+            if (value > stats.max_ns)
+                value = stats.max_ns;
+            *results[q++] = value;
+        }
+    }
+    return stats;
+}
+
+void StreamProfiler::Reset()
+{
+    for (int s = 0; s < STAGE_COUNT; ++s)
+    {
+        Histogram &h = histograms[s];
+        for (int i = 0; i < bucketsCount; ++i)
+            h.buckets[i].store(0, std::memory_order_relaxed);
+        h.count.store(0, std::memory_order_relaxed);
+        h.sum.store(0, std::memory_order_relaxed);
+        h.min.store(UINT64_MAX, std::memory_order_relaxed);
+        h.max.store(0, std::memory_order_relaxed);
+    }
+    traceIndex.store(0);
+    for (uint32_t i = 0; i < traceSize; ++i)
+        trace[i].seq.store(0, std::memory_order_relaxed);
+}
+
+int StreamProfiler::WriteTrace(const char* filename) const
+{
+    FILE* fp = fopen(filename, "w");
+    if (fp == nullptr)
+        return ReportError(errno, "Failed to open trace file %s", filename);
+
+    const uint64_t end = traceIndex.load(std::memory_order_acquire);
+    const uint64_t begin = end > traceSize ? end - traceSize : 0;
+    fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    bool first = true;
+    for (uint64_t i = begin; i < end; ++i)
+    {
+        const TraceEvent &ev = trace[i & (traceSize - 1)];
+        if (ev.seq.load(std::memory_order_acquire) != i + 1)
+            continue;
+        const uint64_t start = ev.start_ns;
+        const uint64_t duration = ev.duration_ns;
+        const uint32_t thread = ev.thread;
+        const uint16_t stage = ev.stage;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (ev.seq.load(std::memory_order_relaxed) != i + 1) //overwritten while reading
+            continue;
+        fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+            first ? "" : ",\n", StageName((StreamStage)stage), thread, start / 1000.0, duration / 1000.0);
+        first = false;
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+    return 0;
+}
+
+}
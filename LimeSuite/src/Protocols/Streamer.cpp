@@ -4,8 +4,20 @@
 #include <ciso646>
 #include "Logger.h"
 #include "Streamer.h"
+#include "StreamProfiler.h"
+#include "SampleKernels.h"
+#include "StreamBuffer.h"
+#include "BatchController.h"
+#include "TransferQueue.h"
+#include "DownConverter.h"
+#include "Channelizer.h"
 #include "IConnection.h"
 #include <complex>
+#include <algorithm>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace lime
 {
@@ -14,90 +26,415 @@ StreamChannel::StreamChannel(Streamer* streamer) :
     mActive(false)
 {
     mStreamer = streamer;
+    ResetCounters();
+    SetFloatConversion(1.0f/32767.0f, 0, 0);
+    fifo = nullptr;
+    used = false;
+    hasDDC = false;
+    channelizer = nullptr;
+    ddc = nullptr;
+    ddcParent = nullptr;
+    synthesizer = nullptr;
+    callbackDirect = false;
+    callbackStopped = false;
+    stopDispatcher = false;
+}
+
+StreamChannel::StreamChannel(const StreamChannel& other) :
+    mActive(false)
+{
+    mStreamer = other.mStreamer;
+    ResetCounters();
+    SetFloatConversion(1.0f/32767.0f, 0, 0);
+    fifo = nullptr;
+    used = false;
+    hasDDC = false;
+    channelizer = nullptr;
+    ddc = nullptr;
+    ddcParent = nullptr;
+    synthesizer = nullptr;
+    callbackDirect = false;
+    callbackStopped = false;
+    stopDispatcher = false;
+}
+
+void StreamChannel::ResetCounters()
+{
     overflow = 0;
     underflow = 0;
     pktLost = 0;
-    fifo = nullptr;
-    used = false;
+    reportedOverflow = 0;
+    reportedUnderflow = 0;
+    reportedPktLost = 0;
+    std::lock_guard<std::mutex> lck(lossLock);
+    memset(&loss, 0, sizeof(loss));
+    recentNext = 0;
 }
 
 StreamChannel::~StreamChannel()
 {
+    if (dispatcher.joinable())
+    {
+        stopDispatcher = true;
+        fifo->Interrupt();
+        dispatcher.join();
+    }
+    for (auto output : ddcOutputs)
+        delete output;
+    for (auto output : channelizerOutputs)
+        delete output;
+    if (channelizer)
+        delete channelizer;
+    if (ddc)
+        delete ddc;
+    if (synthesizer)
+        delete synthesizer;
     if (fifo)
         delete fifo;
 }
 
-void StreamChannel::Setup(StreamConfig conf)
+/** @brief Allocates channel FIFO
+    @param packetSamples samples of this channel in one link packet, used as FIFO packet size
+*/
+void StreamChannel::Setup(StreamConfig conf, uint32_t packetSamples)
 {
     used = true;
     config = conf;
-    overflow = 0;
-    underflow = 0;
-    pktLost = 0;
-    if (config.bufferLength == 0) //default size
-        config.bufferLength = 1024*8*SamplesPacket::maxSamplesInPacket;
-    else
+    ResetCounters();
+    size_t fifoSize = 1024*8; //default size in packets
+    if (config.bufferLength != 0)
     {
-        size_t fifoSize = 64;
-        while(fifoSize < conf.bufferLength/SamplesPacket::maxSamplesInPacket)
+        fifoSize = 64;
+        while(fifoSize*packetSamples < conf.bufferLength)
             fifoSize <<= 1;
-        this->config.bufferLength = fifoSize*SamplesPacket::maxSamplesInPacket;
     }
+    config.bufferLength = fifoSize*packetSamples;
     if (fifo)
         delete fifo;
-    fifo = new RingFIFO(config.bufferLength);
+    fifo = new RingFIFO(config.bufferLength, packetSamples, config.isTx ? 0 : config.historyLength);
+
+    SetFloatConversion(config.isTx ? 32767.0f : 1.0f/32767.0f, 0, 0);
+    //Tx float samples are converted here before going into FIFO, Rx converts in place
+    if (config.format == StreamConfig::FMT_FLOAT32 && config.isTx)
+        scratch.resize(scratchPackets*packetSamples);
+    else
+        std::vector<complex16_t>().swap(scratch);
 }
 
 void StreamChannel::Close()
 {
     if (mActive)
         Stop();
+    if (ddcParent)
+    {
+        //outputs are owned by their parent channel
+        ddcParent->RemoveOutput(this);
+        delete this;
+        return;
+    }
+    //last stream of its channel pair, running streams go on without the pair
+    int paused = 0;
+    const int ch = config.channelID&1;
+    if (mStreamer && used && mStreamer->configured &&
+        !(config.isTx ? mStreamer->mRxStreams[ch].used : mStreamer->mTxStreams[ch].used))
+        paused = mStreamer->PauseThreads();
+    {
+        std::lock_guard<std::mutex> lck(ddcLock);
+        hasDDC = false;
+        for (auto output : ddcOutputs)
+            delete output;
+        ddcOutputs.clear();
+        for (auto output : channelizerOutputs)
+            delete output;
+        channelizerOutputs.clear();
+        if (channelizer)
+            delete channelizer;
+        channelizer = nullptr;
+    }
+    if (synthesizer)
+        delete synthesizer;
+    synthesizer = nullptr;
+    std::vector<complex16_t>().swap(channelInput);
     if (fifo)
         delete fifo;
     fifo = nullptr;
+    std::vector<complex16_t>().swap(scratch);
     used = false;
+    if (paused)
+        mStreamer->ApplyLayout(paused);
 }
 
 int StreamChannel::Write(const void* samples, const uint32_t count, const Metadata *meta, const int32_t timeout_ms)
 {
-    int pushed = 0;
     if(config.format == StreamConfig::FMT_FLOAT32 && config.isTx)
     {
+        //converted in chunks through the scratch buffer, end of burst only marks the last chunk
         const float* samplesFloat = (const float*)samples;
-        int16_t* samplesShort = new int16_t[2*count];
-        for(size_t i=0; i<2*count; ++i)
-            samplesShort[i] = samplesFloat[i]*32767.0f;
-        const complex16_t* ptr = (const complex16_t*)samplesShort ;
-        pushed = fifo->push_samples(ptr, count, 1, meta->timestamp, timeout_ms, meta->flags);
-        delete[] samplesShort;
-    }
-    else
-    {
-        const complex16_t* ptr = (const complex16_t*)samples;
-        pushed = fifo->push_samples(ptr, count, 1, meta->timestamp, timeout_ms, meta->flags);
+        const auto t1 = std::chrono::steady_clock::now();
+        uint32_t pushed = 0;
+        while (pushed < count)
+        {
+            const uint32_t chunk = std::min<uint32_t>(count - pushed, scratch.size());
+            const uint32_t chunkFlags = (pushed + chunk < count) ? meta->flags & ~RingFIFO::END_BURST : meta->flags;
+            const int32_t elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-t1).count();
+            kernels::FloatToInt16(&samplesFloat[2*pushed], scratch.data(), chunk, convScale, convOffsetI, convOffsetQ);
+            const uint32_t n = fifo->push_samples(scratch.data(), chunk, 1, meta->timestamp + pushed,
+                                                  elapsed < timeout_ms ? timeout_ms - elapsed : 0, chunkFlags);
+            pushed += n;
+            if (n < chunk)
+                break;
+        }
+        return pushed;
     }
-    return pushed;
+    const complex16_t* ptr = (const complex16_t*)samples;
+    return fifo->push_samples(ptr, count, 1, meta->timestamp, timeout_ms, meta->flags);
 }
 
 int StreamChannel::Read(void* samples, const uint32_t count, Metadata* meta, const int32_t timeout_ms)
 {
-    int popped = 0;
+    complex16_t* ptr = (complex16_t*)samples;
+    int popped = fifo->pop_samples(ptr, count, 1, &meta->timestamp, timeout_ms, &meta->flags);
     if(config.format == StreamConfig::FMT_FLOAT32 && !config.isTx)
+        kernels::Int16ToFloat(ptr, (float*)samples, popped, convScale, convOffsetI, convOffsetQ); //in place
+    return popped;
+}
+
+/** @brief Copies received samples starting at given timestamp, including already read ones
+    Works alongside Read(), the stream itself is not affected. Data is available
+    for the history length set by SetHistory() plus what is still in FIFO.
+    @param timestamp timestamp of the first wanted sample
+    @param meta returns timestamp of the first copied sample, later than timestamp if older data is gone
+    @return number of samples copied, fewer than count if they are not received yet, -1 on error
+*/
+int StreamChannel::ReadHistory(const uint64_t timestamp, void* samples, const uint32_t count, Metadata* meta)
+{
+    if (fifo == nullptr || config.isTx)
     {
-        //in place conversion
-        complex16_t* ptr = (complex16_t*)samples;
-        int16_t* samplesShort = (int16_t*)samples;
-        float* samplesFloat = (float*)samples;
-        popped = fifo->pop_samples(ptr, count, 1, &meta->timestamp, timeout_ms, &meta->flags);
-        for(int i=2*popped-1; i>=0; --i)
-            samplesFloat[i] = (float)samplesShort[i]/32767.0f;
+        lime::error("History is only available for Rx streams");
+        return -1;
     }
-    else
+    complex16_t* ptr = (complex16_t*)samples;
+    meta->flags = 0;
+    meta->timestamp = timestamp;
+    const uint32_t copied = fifo->ReadHistory(timestamp, ptr, count, &meta->timestamp);
+    if(config.format == StreamConfig::FMT_FLOAT32)
+        kernels::Int16ToFloat(ptr, (float*)samples, copied, convScale, convOffsetI, convOffsetQ); //in place
+    return copied;
+}
+
+/** @brief Keeps the last seconds of received samples for ReadHistory()
+    Reallocates the FIFO, so the stream must not be running.
+    @param seconds history length at current sample rate, 0 disables history
+*/
+int StreamChannel::SetHistory(const double seconds)
+{
+    if (fifo == nullptr || config.isTx)
     {
-        complex16_t* ptr = (complex16_t*)samples;
-        popped = fifo->pop_samples(ptr, count, 1, &meta->timestamp, timeout_ms, &meta->flags);
+        lime::error("History is only available for Rx streams");
+        return -1;
     }
-    return popped;
+    if (mActive)
+    {
+        lime::error("Stream has to be stopped to change history length");
+        return -1;
+    }
+    config.historyLength = seconds > 0 ? uint64_t(seconds*mStreamer->GetSampleRate(false)) : 0;
+    const uint32_t packetSamples = fifo->PacketSamples();
+    delete fifo;
+    fifo = nullptr;
+    try
+    {
+        fifo = new RingFIFO(config.bufferLength, packetSamples, config.historyLength);
+    }
+    catch (const std::bad_alloc &ex)
+    {
+        config.historyLength = 0;
+        fifo = new RingFIFO(config.bufferLength, packetSamples);
+        lime::error("Not enough memory for stream history");
+        return -1;
+    }
+    return 0;
+}
+
+/** @brief Reads equally sized, timestamp aligned blocks from several Rx channels
+    The first call of a read starts at the newest head timestamp among channels,
+    older samples of other channels can not be aligned and are dropped. Sample i
+    of every block has timestamp meta->timestamp + i, positions a channel has no
+    samples for (lost or overwritten packets) are filled with zeros.
+    Samples are only taken out of FIFOs once all channels can provide them,
+    so a timeout leaves the channels aligned for the next call.
+    @param channels Rx channels of the same device
+    @param chCount number of channels
+    @param samples destination array for each channel, in the format of that channel
+    @param count number of samples to read for each channel
+    @param meta returns timestamp of the first sample of the blocks
+    @return number of samples in each block, less than count on timeout, -1 on error
+*/
+int StreamChannel::ReadAligned(StreamChannel* const* channels, const uint8_t chCount, void* const* samples, const uint32_t count, Metadata* meta, const int32_t timeout_ms)
+{
+    if (chCount == 0)
+        return 0;
+    for (uint8_t c = 0; c < chCount; ++c)
+        if (channels[c] == nullptr || channels[c]->fifo == nullptr || channels[c]->config.isTx)
+        {
+            lime::error("Aligned read needs set up Rx streams");
+            return -1;
+        }
+
+    const auto t1 = std::chrono::steady_clock::now();
+    auto remaining_ms = [&]() -> uint32_t
+    {
+        const int32_t elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-t1).count();
+        return elapsed < timeout_ms ? timeout_ms - elapsed : 0;
+    };
+
+    meta->timestamp = 0;
+    meta->flags = 0;
+    uint64_t start = 0;
+    for (uint8_t c = 0; c < chCount; ++c)
+    {
+        uint32_t cnt;
+        uint64_t ts;
+        if (channels[c]->fifo->AcquireRead(&cnt, &ts, nullptr, remaining_ms()) == nullptr)
+            return 0;
+        start = std::max(start, ts);
+    }
+
+    uint32_t pos = 0;
+    while (pos < count)
+    {
+        //find how far all channels can advance: samples from the head, or zeros up to a later head
+        const uint64_t at = start + pos;
+        uint32_t step = count - pos;
+        bool timeout = false;
+        for (uint8_t c = 0; c < chCount && !timeout; ++c)
+        {
+            RingFIFO* fifo = channels[c]->fifo;
+            while (true)
+            {
+                uint32_t cnt;
+                uint64_t ts;
+                if (fifo->AcquireRead(&cnt, &ts, nullptr, remaining_ms()) == nullptr)
+                {
+                    timeout = true;
+                    break;
+                }
+                if (ts + cnt <= at) //too old to be aligned
+                    channels[c]->ReleaseRead(cnt);
+                else if (ts < at)
+                    channels[c]->ReleaseRead(at - ts);
+                else
+                {
+                    step = std::min<uint64_t>(step, ts > at ? ts - at : cnt);
+                    break;
+                }
+            }
+        }
+        if (timeout)
+            break;
+
+        for (uint8_t c = 0; c < chCount; ++c)
+        {
+            complex16_t* dest = static_cast<complex16_t*>(samples[c]) + pos;
+            uint32_t cnt;
+            uint64_t ts;
+            const complex16_t* src = channels[c]->fifo->AcquireRead(&cnt, &ts, nullptr, 0);
+            //head can only have moved on if the producer overwrote it, that data is lost as well
+            if (src && ts == at && cnt >= step)
+            {
+                memcpy(dest, src, step*sizeof(complex16_t));
+                if (!channels[c]->ReleaseRead(step))
+                    memset(dest, 0, step*sizeof(complex16_t));
+            }
+            else
+                memset(dest, 0, step*sizeof(complex16_t));
+        }
+        pos += step;
+    }
+
+    for (uint8_t c = 0; c < chCount; ++c)
+    {
+        StreamChannel* ch = channels[c];
+        if (ch->config.format == StreamConfig::FMT_FLOAT32)
+            kernels::Int16ToFloat((complex16_t*)samples[c], (float*)samples[c], pos, ch->convScale, ch->convOffsetI, ch->convOffsetQ);
+    }
+    meta->timestamp = start;
+    return pos;
+}
+
+/** @brief Sets scale and DC offset applied when converting float samples
+    Rx: float = int16*scale + offset, Tx: int16 = float*scale + offset, saturated.
+    Defaults are 1/32767 for Rx, 32767 for Tx and no offset.
+*/
+void StreamChannel::SetFloatConversion(float scale, float offsetI, float offsetQ)
+{
+    convScale = scale;
+    convOffsetI = offsetI;
+    convOffsetQ = offsetQ;
+}
+
+/** @brief Borrows received samples of the oldest FIFO packet without copying
+    @param samples returns pointer to the samples, valid until ReleaseRead()
+    @return number of samples available at samples, 0 on timeout, -1 on error
+*/
+int StreamChannel::AcquireRead(const complex16_t** samples, Metadata* meta, const int32_t timeout_ms)
+{
+    //FIFO always holds 16-bit samples, float conversion only happens in Read()
+    if (config.format == StreamConfig::FMT_FLOAT32 && !config.isTx)
+    {
+        lime::error("Zero-copy access is not available for float samples");
+        return -1;
+    }
+    uint32_t count = 0;
+    *samples = fifo->AcquireRead(&count, &meta->timestamp, &meta->flags, timeout_ms);
+    return *samples ? count : 0;
+}
+
+/** @brief Returns count samples borrowed by AcquireRead()
+    @return false if the samples were overwritten while borrowed and have to be discarded
+*/
+bool StreamChannel::ReleaseRead(const uint32_t count)
+{
+    if (fifo->ReleaseRead(count))
+        return true;
+    overflow++;
+    return false;
+}
+
+/** @brief Borrows a FIFO packet to be filled in place
+    @param samples returns pointer to the packet samples
+    @param overwrite drop the oldest packet instead of waiting if FIFO is full
+    @return number of samples that fit into the packet, 0 on timeout, -1 on error
+*/
+int StreamChannel::AcquireWrite(complex16_t** samples, const int32_t timeout_ms, const bool overwrite)
+{
+    if (config.format == StreamConfig::FMT_FLOAT32 && config.isTx)
+    {
+        lime::error("Zero-copy access is not available for float samples");
+        return -1;
+    }
+    *samples = fifo->AcquireWrite(timeout_ms, overwrite);
+    return *samples ? fifo->PacketSamples() : 0;
+}
+
+//! @brief Publishes count samples written into the packet returned by AcquireWrite()
+int StreamChannel::CommitWrite(const uint32_t count, const Metadata* meta)
+{
+    if (count > fifo->PacketSamples())
+    {
+        lime::error("Too many samples for one packet");
+        return -1;
+    }
+    fifo->CommitWrite(count, meta->timestamp, meta->flags);
+    return count;
+}
+
+//! @brief FIFO fill and capacity in link packets, does not touch GetInfo() counters
+void StreamChannel::GetFIFOPackets(uint32_t* filled, uint32_t* size)
+{
+    RingFIFO::BufferInfo info = fifo->GetInfo();
+    *filled = info.itemsFilled / fifo->PacketSamples();
+    *size = info.size / fifo->PacketSamples();
 }
 
 StreamChannel::Info StreamChannel::GetInfo()
@@ -108,25 +445,467 @@ StreamChannel::Info StreamChannel::GetInfo()
     stats.fifoSize = info.size;
     stats.fifoItemsCount = info.itemsFilled;
     stats.active = mActive;
-    stats.droppedPackets = pktLost;
-    stats.overrun = overflow;
-    stats.overrun = underflow;
-    pktLost = 0;
-    overflow = 0;
-    underflow = 0;
+    //report counts since the previous call, the counters themselves keep running
+    const uint32_t lost = pktLost.load();
+    const uint32_t over = overflow.load();
+    const uint32_t under = underflow.load();
+    stats.droppedPackets = lost - reportedPktLost;
+    stats.overrun = over - reportedOverflow;
+    stats.underrun = under - reportedUnderflow;
+    reportedPktLost = lost;
+    reportedOverflow = over;
+    reportedUnderflow = under;
+    if(config.isTx)
+    {
+        stats.timestamp = mStreamer->txLastTimestamp;
+        stats.linkRate = mStreamer->txDataRate_Bps.load();
+    }
+    else
+    {
+        stats.timestamp = mStreamer->rxLastTimestamp;
+        stats.linkRate = mStreamer->rxDataRate_Bps.load();
+    }
+    return stats;
+}
+
+StreamChannel::Telemetry StreamChannel::GetTelemetry()
+{
+    Telemetry stats;
+    memset(&stats,0,sizeof(stats));
+    RingFIFO::BufferInfo info = fifo->GetInfo();
+    stats.active = mActive;
+    stats.fifoSize = info.size;
+    stats.fifoItemsCount = info.itemsFilled;
+    stats.fifoHighWater = info.highWater;
+    stats.overrun = overflow.load();
+    stats.underrun = underflow.load();
+    stats.droppedPackets = pktLost.load();
     if(config.isTx)
     {
         stats.timestamp = mStreamer->txLastTimestamp;
         stats.linkRate = mStreamer->txDataRate_Bps.load();
+        stats.linkBytes = mStreamer->txBytesTotal.load();
     }
     else
     {
         stats.timestamp = mStreamer->rxLastTimestamp;
         stats.linkRate = mStreamer->rxDataRate_Bps.load();
+        stats.linkBytes = mStreamer->rxBytesTotal.load();
+    }
+    return stats;
+}
+
+StreamChannel::LossStats StreamChannel::GetLossStats()
+{
+    std::lock_guard<std::mutex> lck(lossLock);
+    LossStats stats = loss;
+    //unroll the ring so that events come oldest first
+    for (uint32_t i = 0; i < loss.recentCount; ++i)
+    {
+        const uint32_t index = (recentNext + LossStats::eventsSize - loss.recentCount + i) % LossStats::eventsSize;
+        stats.recentTimestamp[i] = loss.recentTimestamp[index];
+        stats.recentPackets[i] = loss.recentPackets[index];
     }
     return stats;
 }
 
+/** @brief Records Rx packet loss and fills the gap with zeros if enabled
+    Called by the Rx thread before the packet following the gap is written to FIFO.
+    @param timestamp timestamp of the first missing sample
+    @param packets number of missing link packets
+    @param samples number of missing samples
+*/
+void StreamChannel::RecordLoss(const uint64_t timestamp, const uint32_t packets, const uint64_t samples)
+{
+    const uint32_t packetSamples = fifo->PacketSamples();
+    uint64_t filled = 0;
+    //gated streams only get trigger windows, zeros would bypass the trigger
+    if (config.fillGaps && !trigger.Armed())
+    {
+        //older samples would be overwritten by the following ones anyway
+        const uint64_t toFill = std::min<uint64_t>(samples, uint64_t(fifo->GetInfo().size / packetSamples)*packetSamples);
+        const uint64_t firstTimestamp = timestamp + samples - toFill;
+        while (filled < toFill)
+        {
+            const uint32_t chunk = std::min<uint64_t>(packetSamples, toFill - filled);
+            complex16_t* slot = fifo->AcquireWrite(100, true);
+            if (slot == nullptr)
+                break;
+            memset(slot, 0, chunk*sizeof(complex16_t));
+            fifo->CommitWrite(chunk, firstTimestamp + filled,
+                              RingFIFO::OVERWRITE_OLD | RingFIFO::SYNC_TIMESTAMP | RingFIFO::GAP_FILLED);
+            filled += chunk;
+        }
+    }
+
+    int bucket = 0;
+    while ((packets >> (bucket+1)) && bucket < LossStats::histogramSize-1)
+        ++bucket;
+    std::lock_guard<std::mutex> lck(lossLock);
+    loss.histogram[bucket]++;
+    loss.eventsCount++;
+    loss.filledSamples += filled;
+    loss.recentTimestamp[recentNext] = timestamp;
+    loss.recentPackets[recentNext] = packets;
+    recentNext = (recentNext + 1) % LossStats::eventsSize;
+    if (loss.recentCount < LossStats::eventsSize)
+        loss.recentCount++;
+}
+
+/** @brief Rx thread: whether next packet can be parsed straight into a FIFO slot
+    Taking a slot with overwrite drops the oldest FIFO packet, so gated channels
+    and channels feeding a direct callback parse elsewhere and take FIFO space
+    only for samples that go to FIFO.
+*/
+bool StreamChannel::ReceivesInSlot()
+{
+    if (trigger.Armed())
+        return false;
+    return !callbackDirect || callbackStopped.load(std::memory_order_relaxed);
+}
+
+/** @brief Writes a received packet to FIFO, through trigger engine when it is armed
+    @param inSlot samples are in the FIFO slot returned by AcquireWrite(),
+    taken after ReceivesInSlot(), the packet bypasses trigger and callback
+    @return false if FIFO did not take all samples
+*/
+bool StreamChannel::PushReceived(complex16_t* samples, const bool inSlot, const uint32_t count, const Metadata* meta)
+{
+    if (inSlot)
+        return CommitWrite(count, meta) == int(count);
+    if (trigger.Armed())
+        return trigger.Process(fifo, samples, count, meta->timestamp, meta->flags);
+    if (callbackDirect && !callbackStopped.load(std::memory_order_relaxed))
+    {
+        //samples the callback does not take go to FIFO
+        Metadata offered = *meta;
+        int taken = callback(samples, count, &offered);
+        if (taken < 0)
+        {
+            callbackStopped = true;
+            taken = 0;
+        }
+        if (uint32_t(taken) >= count)
+            return true;
+        Metadata rest = *meta;
+        rest.timestamp += taken;
+        return Write((const void*)(samples + taken), count - taken, &rest, 100) == int(count - taken);
+    }
+    return Write((const void*)samples, count, meta, 100) == int(count);
+}
+
+/** @brief Configures capture of trigger windows only, can be changed while streaming
+    MODE_OFF passes all received samples again.
+*/
+int StreamChannel::SetTrigger(const TriggerEngine::Config &options)
+{
+    if (config.isTx)
+    {
+        lime::error("Trigger is only available for Rx streams");
+        return -1;
+    }
+    trigger.Configure(options);
+    return 0;
+}
+
+//! @brief Number of trigger windows delivered since the last SetTrigger()
+uint32_t StreamChannel::GetTriggerCount() const
+{
+    return trigger.Triggers();
+}
+
+/** @brief Creates a narrowband output of this Rx channel
+    Received samples are mixed down by frequency and decimated on the host,
+    the output is read as a regular stream and started and stopped on its own.
+    It only gets samples while this channel is active, Close() removes it.
+    @param frequency sub-band center relative to the stream center, Hz
+    @param decimation power of two up to DownConverter::maxDecimation
+    @return new output channel, nullptr on failure
+*/
+StreamChannel* StreamChannel::AddDDC(const double frequency, const uint32_t decimation)
+{
+    if (config.isTx || ddcParent || fifo == nullptr)
+    {
+        lime::error("DDC is only available for set up Rx streams");
+        return nullptr;
+    }
+    if (decimation == 0 || decimation > DownConverter::maxDecimation || (decimation & (decimation - 1)))
+    {
+        lime::error("DDC decimation must be a power of two up to %u", DownConverter::maxDecimation);
+        return nullptr;
+    }
+    const double rate = mStreamer->GetSampleRate(false);
+    if (rate <= 0 || fabs(frequency) > rate / 2)
+    {
+        lime::error("DDC frequency outside of the received band");
+        return nullptr;
+    }
+    const uint32_t packetSamples = fifo->PacketSamples();
+    StreamConfig outputConfig = config;
+    outputConfig.bufferLength = config.bufferLength / decimation;
+    outputConfig.historyLength = 0;
+    outputConfig.fillGaps = false;
+    StreamChannel* output = new StreamChannel(mStreamer);
+    output->Setup(outputConfig, std::max<uint32_t>(1, packetSamples / decimation));
+    output->ddc = new DownConverter(frequency / rate, decimation);
+    output->ddcParent = this;
+    std::lock_guard<std::mutex> lck(ddcLock);
+    ddcOutputs.push_back(output);
+    hasDDC = true;
+    return output;
+}
+
+/** @brief Retunes DDC output while streaming
+    @param frequency sub-band center relative to the stream center, Hz
+*/
+int StreamChannel::SetDDCFrequency(const double frequency)
+{
+    if (ddc == nullptr)
+    {
+        lime::error("Stream is not a DDC output");
+        return -1;
+    }
+    const double rate = mStreamer->GetSampleRate(false);
+    if (rate <= 0 || fabs(frequency) > rate / 2)
+    {
+        lime::error("DDC frequency outside of the received band");
+        return -1;
+    }
+    ddc->SetFrequency(frequency / rate);
+    return 0;
+}
+
+/** @brief Splits this Rx channel into uniformly spaced channels, or enables WriteChannels() for Tx
+    Rx channel k is centered at k*rate/channels, the upper half are negative frequencies,
+    and is read through its own output channel running at rate/channels.
+    @param channels power of two up to FilterBank::maxChannels
+    @param outputs Rx: returns channels output channels, Close() removes them one by one; Tx: unused
+*/
+int StreamChannel::SetupChannelizer(const uint32_t channels, StreamChannel** outputs)
+{
+    if (ddcParent || fifo == nullptr)
+    {
+        lime::error("Channelizer needs a set up stream");
+        return -1;
+    }
+    if (channels < 2 || channels > FilterBank::maxChannels || (channels & (channels - 1)))
+    {
+        lime::error("Channel count must be a power of two from 2 to %u", FilterBank::maxChannels);
+        return -1;
+    }
+    if (config.isTx)
+    {
+        if (synthesizer)
+            delete synthesizer;
+        synthesizer = new ChannelSynthesizer(channels);
+        return 0;
+    }
+    if (outputs == nullptr)
+        return -1;
+    std::lock_guard<std::mutex> lck(ddcLock);
+    if (channelizer)
+    {
+        lime::error("Stream already has a channelizer");
+        return -1;
+    }
+    const uint32_t packetSamples = fifo->PacketSamples();
+    StreamConfig outputConfig = config;
+    outputConfig.bufferLength = config.bufferLength / channels;
+    outputConfig.historyLength = 0;
+    outputConfig.fillGaps = false;
+    channelizer = new Channelizer(channels);
+    for (uint32_t k = 0; k < channels; ++k)
+    {
+        StreamChannel* output = new StreamChannel(mStreamer);
+        output->Setup(outputConfig, std::max<uint32_t>(1, packetSamples / channels));
+        output->ddcParent = this;
+        channelizerOutputs.push_back(output);
+        outputs[k] = output;
+    }
+    hasDDC = true;
+    return 0;
+}
+
+/** @brief Combines samples of all channels set by SetupChannelizer() and writes them to Tx FIFO
+    @param samples count samples for each channel, nullptr for silent channels
+    @param meta timestamp is at stream rate, channels*count samples are written, nullptr for no timestamp and flags
+    @return number of samples written per channel, -1 on error
+*/
+int StreamChannel::WriteChannels(const void* const* samples, const uint32_t count, const Metadata* meta, const int32_t timeout_ms)
+{
+    if (synthesizer == nullptr)
+    {
+        lime::error("Stream has no channelizer set up");
+        return -1;
+    }
+    const uint32_t channels = synthesizer->Channels();
+    const complex16_t* inputs[FilterBank::maxChannels];
+    for (uint32_t k = 0; k < channels; ++k)
+        inputs[k] = (const complex16_t*)samples[k];
+    if (config.format == StreamConfig::FMT_FLOAT32)
+    {
+        if (channelInput.size() < channels*count)
+            channelInput.resize(channels*count);
+        for (uint32_t k = 0; k < channels; ++k)
+            if (samples[k])
+            {
+                kernels::FloatToInt16((const float*)samples[k], &channelInput[k*count], count, convScale, convOffsetI, convOffsetQ);
+                inputs[k] = &channelInput[k*count];
+            }
+    }
+    const uint64_t timestamp = meta ? meta->timestamp : 0;
+    const uint32_t flags = meta ? meta->flags : 0;
+    const complex16_t* out = synthesizer->Process(inputs, count, timestamp);
+    const uint32_t pushed = fifo->push_samples(out, channels*count, 1, timestamp, timeout_ms, flags);
+    return pushed / channels;
+}
+
+//! Drops output from DDC or channelizer outputs, the channelizer goes with its last output
+void StreamChannel::RemoveOutput(StreamChannel* output)
+{
+    std::lock_guard<std::mutex> lck(ddcLock);
+    ddcOutputs.erase(std::remove(ddcOutputs.begin(), ddcOutputs.end(), output), ddcOutputs.end());
+    std::replace(channelizerOutputs.begin(), channelizerOutputs.end(), output, (StreamChannel*)nullptr);
+    if (channelizer && std::count(channelizerOutputs.begin(), channelizerOutputs.end(), nullptr) == int(channelizerOutputs.size()))
+    {
+        delete channelizer;
+        channelizer = nullptr;
+        channelizerOutputs.clear();
+    }
+    hasDDC = !ddcOutputs.empty() || channelizer;
+}
+
+//! Pushes samples to output FIFO, counts overflow if it does not take all of them
+static void PushOutput(StreamChannel* output, RingFIFO* fifo, const complex16_t* samples, const uint32_t count, const uint64_t timestamp)
+{
+    if (fifo->push_samples(samples, count, 1, timestamp, 100, RingFIFO::OVERWRITE_OLD | RingFIFO::SYNC_TIMESTAMP) != count)
+        output->overflow++;
+}
+
+/** @brief Rx thread: feeds a received packet to active DDC and channelizer outputs
+    @param timestamp timestamp of the first sample, outputs use it divided by their decimation
+*/
+void StreamChannel::ProcessOutputs(const complex16_t* samples, const uint32_t count, const uint64_t timestamp)
+{
+    if (!hasDDC.load(std::memory_order_relaxed))
+        return;
+    std::lock_guard<std::mutex> lck(ddcLock);
+    for (auto output : ddcOutputs)
+    {
+        if (!output->mActive)
+            continue;
+        uint32_t outCount;
+        uint64_t outTimestamp;
+        const complex16_t* out = output->ddc->Process(samples, count, timestamp, &outCount, &outTimestamp);
+        if (outCount)
+            PushOutput(output, output->fifo, out, outCount, outTimestamp);
+    }
+    if (channelizer == nullptr)
+        return;
+    //runs while any output is active, so that active ones stay continuous
+    bool active = false;
+    for (auto output : channelizerOutputs)
+        active |= output && output->mActive;
+    if (!active)
+        return;
+    uint64_t outTimestamp;
+    const uint32_t outCount = channelizer->Process(samples, count, timestamp, &outTimestamp);
+    if (outCount == 0)
+        return;
+    for (uint32_t k = 0; k < channelizerOutputs.size(); ++k)
+    {
+        StreamChannel* output = channelizerOutputs[k];
+        if (output && output->mActive)
+            PushOutput(output, output->fifo, channelizer->Output(k), outCount, outTimestamp);
+    }
+}
+
+/** @brief Sets function the stream calls instead of being polled with Read()/Write(), stream has to be stopped
+    From Start() a dispatcher thread waits on FIFO and passes every received packet,
+    or every free Tx packet to be filled, to the function. FIFO gives back-pressure:
+    Rx samples not taken stay in FIFO, which drops the oldest packets when full,
+    and the Tx function is not called while FIFO is full. When the function takes or
+    fills nothing the dispatcher retries after the time of one packet.
+    The function must not start, stop or close the stream.
+    @param function callback, empty one removes it
+    @param direct Rx only: called by the Rx thread for every packet before FIFO,
+           without thread hop, samples not taken go to FIFO. The function has to return
+           quickly, not available for FMT_FLOAT32 and trigger windows
+*/
+int StreamChannel::SetCallback(Callback function, const bool direct)
+{
+    if (mActive)
+    {
+        lime::error("Stream has to be stopped to change callback");
+        return -1;
+    }
+    if (direct && (config.isTx || config.format == StreamConfig::FMT_FLOAT32))
+    {
+        lime::error("Direct callback is only available for integer Rx streams");
+        return -1;
+    }
+    callback = function;
+    callbackDirect = direct && callback;
+    return 0;
+}
+
+//! Dispatcher thread of a callback stream, runs from Start() to Stop()
+void StreamChannel::DispatchLoop()
+{
+    const uint32_t packetSamples = fifo->PacketSamples();
+    const double rate = mStreamer->GetSampleRate(config.isTx);
+    const auto idle = std::chrono::microseconds(rate > 0 ? int64_t(1e6 * packetSamples / rate) + 1 : 1000);
+    const bool floats = config.format == StreamConfig::FMT_FLOAT32;
+    if (floats)
+        callbackFloats.resize(2*packetSamples);
+    //waits are ended by Interrupt() in Stop(), the timeout only bounds them
+    const uint32_t timeout_ms = 1000;
+    while (!stopDispatcher.load(std::memory_order_relaxed))
+    {
+        Metadata meta = {0, 0};
+        int done;
+        if (config.isTx)
+        {
+            complex16_t* slot = fifo->AcquireWrite(timeout_ms);
+            if (slot == nullptr)
+                continue;
+            done = callback(floats ? (void*)callbackFloats.data() : (void*)slot, packetSamples, &meta);
+            if (done > 0)
+            {
+                done = std::min<uint32_t>(done, packetSamples);
+                if (floats)
+                    kernels::FloatToInt16(callbackFloats.data(), slot, done, convScale, convOffsetI, convOffsetQ);
+                fifo->CommitWrite(done, meta.timestamp, meta.flags);
+            }
+        }
+        else
+        {
+            uint32_t count = 0;
+            const complex16_t* src = fifo->AcquireRead(&count, &meta.timestamp, &meta.flags, timeout_ms);
+            if (src == nullptr)
+                continue;
+            if (floats)
+                kernels::Int16ToFloat(src, callbackFloats.data(), count, convScale, convOffsetI, convOffsetQ);
+            done = callback(floats ? (void*)callbackFloats.data() : (void*)src, count, &meta);
+            if (done > 0)
+                ReleaseRead(std::min<uint32_t>(done, count));
+        }
+        if (done < 0)
+        {
+            callbackStopped = true;
+            break;
+        }
+        if (done == 0)
+            std::this_thread::sleep_for(idle);
+    }
+}
+
+//! @brief Sets wait word notified on every FIFO packet in addition to FIFO's own waiters
+void StreamChannel::SetEvent(FIFOWaitWord* event)
+{
+    fifo->SetEvent(event);
+}
+
 int StreamChannel::GetStreamSize()
 {
     return mStreamer->GetStreamSize(config.isTx);
@@ -139,20 +918,66 @@ bool StreamChannel::IsActive() const
 
 int StreamChannel::Start()
 {
-    mActive = true;
     fifo->Clear();
-    overflow = 0;
-    underflow = 0;
-    pktLost = 0;
+    callbackStopped = false;
+    if (callback && !callbackDirect && !dispatcher.joinable())
+    {
+        stopDispatcher = false;
+        dispatcher = std::thread(&StreamChannel::DispatchLoop, this);
+    }
+    mActive = true;
+    //GetInfo() counts from here on, the cumulative counters keep running
+    reportedOverflow = overflow.load();
+    reportedUnderflow = underflow.load();
+    reportedPktLost = pktLost.load();
     return mStreamer->UpdateThreads();
 }
 
 int StreamChannel::Stop()
 {
     mActive = false;
+    if (dispatcher.joinable())
+    {
+        stopDispatcher = true;
+        fifo->Interrupt();
+        dispatcher.join();
+    }
     return mStreamer->UpdateThreads();
 }
 
+/** @brief Applies CPU affinity and scheduling policy to the calling thread
+    Failures are only reported, the thread keeps running with default settings.
+*/
+static void SetCurrentThreadOptions(const StreamConfig::ThreadOptions &options, const char* name)
+{
+#ifdef __linux__
+    if (options.cpuMask)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int i = 0; i < 64 && i < CPU_SETSIZE; ++i)
+            if (options.cpuMask & (uint64_t(1) << i))
+                CPU_SET(i, &cpus);
+        const int status = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (status != 0)
+            lime::warning("%s thread: failed to set CPU affinity (%s)", name, strerror(status));
+    }
+    if (options.policy != StreamConfig::ThreadOptions::POLICY_DEFAULT)
+    {
+        sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = options.priority;
+        const int policy = options.policy == StreamConfig::ThreadOptions::POLICY_FIFO ? SCHED_FIFO : SCHED_RR;
+        const int status = pthread_setschedparam(pthread_self(), policy, &param);
+        if (status != 0)
+            lime::warning("%s thread: failed to set real-time priority %i (%s)", name, options.priority, strerror(status));
+    }
+#else
+    if (options.cpuMask || options.policy != StreamConfig::ThreadOptions::POLICY_DEFAULT)
+        lime::warning("%s thread: affinity and scheduling options are only supported on Linux", name);
+#endif
+}
+
 Streamer::Streamer(FPGA* f, LMS7002M* chip, int id) : mRxStreams(2, this), mTxStreams(2, this)
 {
     lms = chip,
@@ -163,8 +988,15 @@ Streamer::Streamer(FPGA* f, LMS7002M* chip, int id) : mRxStreams(2, this), mTxSt
     rxLastTimestamp = 0;
     terminateRx = false;
     terminateTx = false;
+    rxControl.state = ThreadControl::RUN;
+    txControl.state = ThreadControl::RUN;
+    rxControl.keepTimestamps = false;
+    txControl.keepTimestamps = false;
+    configured = false;
     rxDataRate_Bps = 0;
     txDataRate_Bps = 0;
+    rxBytesTotal = 0;
+    txBytesTotal = 0;
     txBatchSize = 1;
     rxBatchSize = 1;
     streamSize = 1;
@@ -172,12 +1004,9 @@ Streamer::Streamer(FPGA* f, LMS7002M* chip, int id) : mRxStreams(2, this), mTxSt
 
 Streamer::~Streamer()
 {
-    terminateTx.store(true);
-    if (txThread.joinable())
-        txThread.join();
-    terminateRx.store(true);
-    if (rxThread.joinable())
-        rxThread.join();
+    JoinThread(txThread, terminateTx, txControl);
+    JoinThread(rxThread, terminateRx, rxControl);
+    configured = false; //channels being destroyed must not change layout
 }
 
 
@@ -191,17 +1020,31 @@ StreamChannel* Streamer::SetupStream(const StreamConfig& config)
         return nullptr;
     }
 
-    if ((!mTxStreams[ch].used) && (!mRxStreams[ch].used) && (txThread.joinable() || rxThread.joinable()))
+    //a new channel pair joins running streams without stopping them,
+    //when nothing streams the next start sets up FPGA for the new stream too
+    int paused = 0;
+    if ((!mTxStreams[ch].used) && (!mRxStreams[ch].used))
+        paused = PauseThreads();
+    else if (!IsRunning(false) && !IsRunning(true))
+        configured = false;
+
+
+    //FIFO packets are sized for the link format and channel count the stream will be started with,
+    //if that changes later packets are split or parsed through a temporary frame
+    bool packed = config.format == StreamConfig::FMT_INT12;
+    for (int i = 0; i < 2; ++i)
     {
-        lime::warning("Stopping data stream to set up a new stream");
-        UpdateThreads(true);
+        if ((mRxStreams[i].used && mRxStreams[i].config.format != StreamConfig::FMT_INT12) ||
+            (mTxStreams[i].used && mTxStreams[i].config.format != StreamConfig::FMT_INT12))
+            packed = false;
     }
-
+    const int channels = 1 + (mTxStreams[ch^1].used||mRxStreams[ch^1].used);
+    const uint32_t packetSamples = (packed ? samples12InPkt : samples16InPkt)/channels;
 
     if(config.isTx)
-        mTxStreams[ch].Setup(config);
+        mTxStreams[ch].Setup(config, packetSamples);
     else
-        mRxStreams[ch].Setup(config);
+        mRxStreams[ch].Setup(config, packetSamples);
 
     double rate = lms->GetSampleRate(config.isTx,LMS7002M::ChA)/1e6;
     streamSize = (mTxStreams[0].used||mRxStreams[0].used) + (mTxStreams[1].used||mRxStreams[1].used);
@@ -213,9 +1056,60 @@ StreamChannel* Streamer::SetupStream(const StreamConfig& config)
         else
             rxBatchSize = batch;
 
+    if (paused)
+        ApplyLayout(paused);
     return config.isTx ? &mTxStreams[ch] : &mRxStreams[ch]; //success
 }
 
+//! @brief Thread options of the first stream in given direction that has any set
+StreamConfig::ThreadOptions Streamer::GetThreadOptions(bool tx) const
+{
+    const std::vector<StreamChannel> &streams = tx ? mTxStreams : mRxStreams;
+    for(auto &i : streams)
+        if (i.used && (i.config.threadOptions.cpuMask || i.config.threadOptions.policy != StreamConfig::ThreadOptions::POLICY_DEFAULT))
+            return i.config.threadOptions;
+    return StreamConfig().threadOptions;
+}
+
+//! @brief Largest throughput preference among used streams in given direction
+float Streamer::GetLatencyPreference(bool tx) const
+{
+    const std::vector<StreamChannel> &streams = tx ? mTxStreams : mRxStreams;
+    float preference = 0;
+    for(auto &i : streams)
+        if (i.used)
+            preference = std::max(preference, i.config.performanceLatency);
+    return preference;
+}
+
+//! @brief Deepest transfer queue requested by used streams in given direction, 0 if none
+uint32_t Streamer::GetTransferDepth(bool tx) const
+{
+    const std::vector<StreamChannel> &streams = tx ? mTxStreams : mRxStreams;
+    uint32_t depth = 0;
+    for(auto &i : streams)
+        if (i.used)
+            depth = std::max(depth, i.config.transferDepth);
+    return depth;
+}
+
+static inline uint64_t NowMicroseconds()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//! @return link time of one packet, 0 when the sample rate is not known
+static double PacketTime(double sampleRate, uint32_t packetSamples)
+{
+    return sampleRate > 0 ? 1e6 * packetSamples / sampleRate : 0;
+}
+
+double Streamer::GetSampleRate(bool tx)
+{
+    return lms->GetSampleRate(tx, LMS7002M::ChA);
+}
+
 int Streamer::GetStreamSize(bool tx)
 {
     int batchSize = (tx ? txBatchSize : rxBatchSize)/streamSize;
@@ -517,6 +1411,160 @@ void Streamer::AlignQuadrature(bool restoreValues)
         lime::warning("AlignQuadrature:Channel alignment failed");
 }
 
+//! @brief Selects link format for used streams and writes it with channel enables to FPGA
+void Streamer::WriteLayout()
+{
+    //enable MIMO mode, 12 bit compressed values
+    dataLinkFormat = StreamConfig::FMT_INT12;
+    //by default use 12 bit compressed, adjust link format for stream
+
+    for(auto &i : mRxStreams)
+        if(i.used && i.config.format != StreamConfig::FMT_INT12)
+        {
+            dataLinkFormat = StreamConfig::FMT_INT16;
+            break;
+        }
+
+    for(auto &i : mTxStreams)
+        if(i.used && i.config.format != StreamConfig::FMT_INT12)
+        {
+            dataLinkFormat = StreamConfig::FMT_INT16;
+            break;
+        }
+
+    for(auto &i : mRxStreams)
+        if (i.used)
+            i.config.linkFormat = dataLinkFormat;
+    for(auto &i : mTxStreams)
+        if (i.used)
+            i.config.linkFormat = dataLinkFormat;
+
+    const uint16_t smpl_width = dataLinkFormat == StreamConfig::FMT_INT12 ? 2 : 0;
+    uint16_t mode = 0x0100;
+
+    if (lms->Get_SPI_Reg_bits(LMS7param(LML1_SISODDR)))
+        mode = 0x0040;
+    else if (lms->Get_SPI_Reg_bits(LMS7param(LML1_TRXIQPULSE)))
+        mode = 0x0180;
+
+    fpga->WriteRegister(0x0008, mode | smpl_width);
+
+    const uint16_t channelEnables = (mRxStreams[0].used||mTxStreams[0].used) + 2 * (mRxStreams[1].used||mTxStreams[1].used);
+    fpga->WriteRegister(0x0007, channelEnables);
+}
+
+/** @brief Parks running threads before channel pairs are added or removed
+    @return threads to be resumed by ApplyLayout(), bit 0 - Rx, bit 1 - Tx, 0 if nothing streams
+*/
+int Streamer::PauseThreads()
+{
+    const int running = (IsRunning(false) ? 1 : 0) | (IsRunning(true) ? 2 : 0);
+    if (!configured || running == 0)
+    {
+        //next start sets up FPGA and threads for the new channels
+        configured = false;
+        return 0;
+    }
+    if (running & 1)
+        ParkThread(rxControl);
+    if (running & 2)
+        ParkThread(txControl);
+    return running;
+}
+
+/** @brief Switches running stream to the channel pairs in use, see PauseThreads()
+    FPGA restarts streaming without resetting the timestamp and packets of the old
+    layout are dropped, so the change takes effect at a packet boundary. Streams
+    that kept running only see a short timestamp gap, reported as packet loss.
+*/
+void Streamer::ApplyLayout(int paused)
+{
+    streamSize = (mTxStreams[0].used||mRxStreams[0].used) + (mTxStreams[1].used||mRxStreams[1].used);
+    fpga->WriteRegister(0xFFFF, 1 << chipId);
+    fpga->StopStreaming();
+    dataPort->ResetStreamBuffers();
+    WriteLayout();
+    fpga->StartStreaming();
+    rxControl.keepTimestamps.store(paused & 1);
+    if (paused & 1)
+        UnparkThread(rxControl);
+    if (paused & 2)
+        UnparkThread(txControl);
+}
+
+//! @return true if thread of given direction exists and is not parked
+bool Streamer::IsRunning(bool tx) const
+{
+    const std::thread &thread = tx ? txThread : rxThread;
+    const ThreadControl &control = tx ? txControl : rxControl;
+    return thread.joinable() && control.state.load(std::memory_order_acquire) == ThreadControl::RUN;
+}
+
+//! @brief Asks streaming thread to park and waits until it stopped touching its streams or exited
+void Streamer::ParkThread(ThreadControl &control)
+{
+    int expected = ThreadControl::RUN;
+    control.state.compare_exchange_strong(expected, ThreadControl::PARK, std::memory_order_acq_rel);
+    while (true)
+    {
+        const uint32_t seq = control.ack.Prepare();
+        const int state = control.state.load(std::memory_order_acquire);
+        if (state == ThreadControl::PARKED || state == ThreadControl::EXITED)
+        {
+            control.ack.Cancel();
+            break;
+        }
+        control.ack.Wait(seq, 100000);
+    }
+}
+
+void Streamer::UnparkThread(ThreadControl &control)
+{
+    //exited thread stays so until UpdateThreads() joins and restarts it
+    int expected = control.state.load(std::memory_order_acquire);
+    while (expected != ThreadControl::EXITED
+           && !control.state.compare_exchange_weak(expected, ThreadControl::RUN, std::memory_order_acq_rel))
+        ;
+    control.wake.Notify();
+}
+
+void Streamer::JoinThread(std::thread &thread, std::atomic<bool> &terminate, ThreadControl &control)
+{
+    if (!thread.joinable())
+        return;
+    terminate.store(true);
+    control.wake.Notify();
+    thread.join();
+    control.state.store(ThreadControl::RUN);
+}
+
+/** @brief Called by streaming thread between transfers when asked to park
+    Returns when unparked or terminated, the thread then re-checks its state.
+*/
+void Streamer::Park(ThreadControl &control, const std::atomic<bool> &terminate)
+{
+    int expected = ThreadControl::PARK;
+    //unparked again before the request was seen
+    if (!control.state.compare_exchange_strong(expected, ThreadControl::PARKED, std::memory_order_acq_rel))
+        return;
+    control.ack.Notify();
+    while (true)
+    {
+        const uint32_t seq = control.wake.Prepare();
+        if (control.state.load(std::memory_order_acquire) != ThreadControl::PARKED || terminate.load())
+        {
+            control.wake.Cancel();
+            return;
+        }
+        control.wake.Wait(seq, 1000000);
+    }
+}
+
+/** @brief Brings streaming threads and FPGA in line with active streams
+    Threads are started on first use and parked when their streams stop, so
+    restarting only unparks them. FPGA is set up again and threads are
+    restarted only with stopAll or after the stream set changed.
+*/
 int Streamer::UpdateThreads(bool stopAll)
 {
     bool needTx = false;
@@ -539,20 +1587,29 @@ int Streamer::UpdateThreads(bool stopAll)
             }
     }
 
-    //stop threads if not needed
-    if((!needTx) && txThread.joinable())
+    //threads that returned on their own, e.g. on failed buffer allocation, are started again when needed
+    if (txControl.state.load(std::memory_order_acquire) == ThreadControl::EXITED)
+        JoinThread(txThread, terminateTx, txControl);
+    if (rxControl.state.load(std::memory_order_acquire) == ThreadControl::EXITED)
+        JoinThread(rxThread, terminateRx, rxControl);
+
+    const bool wasStreaming = IsRunning(false) || IsRunning(true);
+    //threads were started for other streams, or everything stops for good
+    if (stopAll || (!configured && (needTx || needRx)))
     {
-        terminateTx.store(true);
-        txThread.join();
+        JoinThread(txThread, terminateTx, txControl);
+        JoinThread(rxThread, terminateRx, rxControl);
+        configured = false;
     }
+
+    //park threads that are not needed
+    if((!needTx) && txThread.joinable())
+        ParkThread(txControl);
     if((!needRx) && rxThread.joinable())
-    {
-        terminateRx.store(true);
-        rxThread.join();
-    }
+        ParkThread(rxControl);
 
-    //configure FPGA on first start, or disable FPGA when not streaming
-    if((needTx || needRx) && (!txThread.joinable()) && (!rxThread.joinable()))
+    //configure FPGA on first start, restart streaming after all streams were stopped, or disable FPGA when not streaming
+    if((needTx || needRx) && !configured)
     {
         fpga->WriteRegister(0xFFFF, 1 << chipId);
         if (mRxStreams[0].used && mRxStreams[1].used)
@@ -564,49 +1621,19 @@ int Streamer::UpdateThreads(bool stopAll)
         //Clear device stream buffers
         dataPort->ResetStreamBuffers();
 
-        //enable MIMO mode, 12 bit compressed values
-        dataLinkFormat = StreamConfig::FMT_INT12;
-        //by default use 12 bit compressed, adjust link format for stream
-
-        for(auto &i : mRxStreams)
-            if(i.used && i.config.format != StreamConfig::FMT_INT12)
-            {
-                dataLinkFormat = StreamConfig::FMT_INT16;
-                break;
-            }
-
-        for(auto &i : mTxStreams)
-            if(i.used && i.config.format != StreamConfig::FMT_INT12)
-            {
-                dataLinkFormat = StreamConfig::FMT_INT16;
-                break;
-            }
-
-        for(auto &i : mRxStreams)
-            if (i.used)
-                i.config.linkFormat = dataLinkFormat;
-        for(auto &i : mTxStreams)
-            if (i.used)
-                i.config.linkFormat = dataLinkFormat;
-
-        const uint16_t smpl_width = dataLinkFormat == StreamConfig::FMT_INT12 ? 2 : 0;
-        uint16_t mode = 0x0100;
-
-        if (lms->Get_SPI_Reg_bits(LMS7param(LML1_SISODDR)))
-            mode = 0x0040;
-        else if (lms->Get_SPI_Reg_bits(LMS7param(LML1_TRXIQPULSE)))
-            mode = 0x0180;
-
-        fpga->WriteRegister(0x0008, mode | smpl_width);
-
-        const uint16_t channelEnables = (mRxStreams[0].used||mTxStreams[0].used) + 2 * (mRxStreams[1].used||mTxStreams[1].used);
-        fpga->WriteRegister(0x0007, channelEnables);
+        WriteLayout();
 
         uint32_t reg9 = fpga->ReadRegister(0x0009);
         const uint32_t addr[] = {0x0009, 0x0009};
         const uint32_t data[] = {reg9 | (5 << 1), reg9 & ~(5 << 1)};
         fpga->StartStreaming();
         fpga->WriteRegisters(addr, data, 2);
+        configured = true;
+    }
+    else if((needTx || needRx) && !wasStreaming)
+    {
+        fpga->WriteRegister(0xFFFF, 1 << chipId);
+        fpga->StartStreaming();
     }
     else if(not needTx and not needRx)
     {
@@ -615,67 +1642,108 @@ int Streamer::UpdateThreads(bool stopAll)
         fpga->StopStreaming();
     }
 
-    //FPGA should be configured and activated, start needed threads
+    //FPGA should be configured and activated, start or unpark needed threads
     if(needRx && (!rxThread.joinable()))
     {
         terminateRx.store(false);
         auto RxLoopFunction = std::bind(&Streamer::ReceivePacketsLoop, this);
         rxThread = std::thread(RxLoopFunction);
     }
-    if(needTx && (!txThread.joinable()))
+    else if(needRx && !IsRunning(false))
+        UnparkThread(rxControl);
+    if(needTx && !IsRunning(true))
     {
         fpga->WriteRegister(0xFFFF, 1 << chipId);
         fpga->WriteRegister(0xD, 0); //stop WFM
-        terminateTx.store(false);
-        auto TxLoopFunction = std::bind(&Streamer::TransmitPacketsLoop, this);
-        txThread = std::thread(TxLoopFunction);
+        if (txThread.joinable())
+            UnparkThread(txControl);
+        else
+        {
+            terminateTx.store(false);
+            auto TxLoopFunction = std::bind(&Streamer::TransmitPacketsLoop, this);
+            txThread = std::thread(TxLoopFunction);
+        }
     }
     return 0;
 }
 
 void Streamer::TransmitPacketsLoop()
 {
+    ThreadControl::ExitGuard exitGuard{txControl};
     //at this point FPGA has to be already configured to output samples
     const uint8_t maxChannelCount = 2;
-    const uint8_t chCount = streamSize;
-    const bool packed = dataLinkFormat == StreamConfig::FMT_INT12;
+    //link layout, changes only while the thread is parked
+    uint8_t chCount = streamSize;
+    bool packed = dataLinkFormat == StreamConfig::FMT_INT12;
     const int epIndex = chipId;
-    const uint8_t buffersCount = dataPort->GetBuffersCount();
-    const uint8_t packetsToBatch = dataPort->CheckStreamSize(rxBatchSize);
-    const uint32_t bufferSize = packetsToBatch*sizeof(FPGA_DataPacket);
+    const uint8_t buffersCount = dataPort->SetTransferDepth(true, GetTransferDepth(true));
+    const BatchController::Bounds bounds = BatchController::MakeBounds(GetLatencyPreference(true),
+        dataPort->CheckStreamSize(maxPacketsInTransfer), buffersCount);
+    BatchController batch(bounds, dataPort->CheckStreamSize(txBatchSize));
+    const uint32_t bufferSize = bounds.maxPackets*sizeof(FPGA_DataPacket);
     const uint32_t popTimeout_ms = 500;
 
-    const int maxSamplesBatch = (packed ? samples12InPkt:samples16InPkt)/chCount;
-    std::vector<int> handles(buffersCount, 0);
-    std::vector<bool> bufferUsed(buffersCount, 0);
-    std::vector<uint32_t> bytesToSend(buffersCount, 0);
+    int maxSamplesBatch = (packed ? samples12InPkt:samples16InPkt)/chCount;
+    batch.SetPacketTime(PacketTime(GetSampleRate(true), maxSamplesBatch));
+    SetCurrentThreadOptions(GetThreadOptions(true), "Tx");
+    std::vector<TransferQueue::Completion> done(buffersCount);
     std::vector<complex16_t> samples[maxChannelCount];
-    std::vector<char> buffers;
+    StreamBuffer buffersMemory;
     try
     {
-        for(int i=0; i<chCount; ++i)
-            samples[i].resize(maxSamplesBatch);
-        buffers.resize(buffersCount*bufferSize, 0);
+        for(int i=0; i<maxChannelCount; ++i)
+            samples[i].resize(samples12InPkt);
+        buffersMemory.Allocate(buffersCount*bufferSize);
+        buffersMemory.Touch(); //place pages on this thread's node
     }
     catch (const std::bad_alloc& ex) //not enough memory for buffers
     {
         return lime::error("Error allocating Tx buffers, not enough memory");
     }
+    TransferQueue queue(dataPort, true, epIndex, static_cast<char*>(buffersMemory.data()), bufferSize, buffersCount);
 
     long totalBytesSent = 0;
     auto t1 = std::chrono::high_resolution_clock::now();
     auto t2 = t1;
     bool end_burst = false;
-    uint8_t bi = 0; //buffer index
     while (terminateTx.load() != true)
     {
-        if (bufferUsed[bi])
+        if (txControl.state.load(std::memory_order_acquire) == ThreadControl::PARK)
+        {
+            //streams stopped or layout changes, queued transfers are dropped, buffers stay
+            queue.Abort();
+            end_burst = false;
+            totalBytesSent = 0;
+            txDataRate_Bps.store(0);
+            Park(txControl, terminateTx);
+            t1 = std::chrono::high_resolution_clock::now();
+            chCount = streamSize;
+            packed = dataLinkFormat == StreamConfig::FMT_INT12;
+            maxSamplesBatch = (packed ? samples12InPkt:samples16InPkt)/chCount;
+            batch.SetPacketTime(PacketTime(GetSampleRate(true), maxSamplesBatch));
+            continue;
+        }
+        //wait for transfers while the in-flight target is reached
+        char* buffer = nullptr;
+        if (queue.InFlight() < batch.InFlight())
+            buffer = queue.Acquire();
+        if (buffer == nullptr)
         {
-            if (dataPort->WaitForSending(handles[bi], 1000) == true)
+            int count;
+            const uint64_t waitStart = NowMicroseconds();
             {
-                unsigned bytesSent = dataPort->FinishDataSending(&buffers[bi*bufferSize], bytesToSend[bi], handles[bi]);
-
-                if (bytesSent != bytesToSend[bi])
+                StageTimer timer(STAGE_TX_USB_WAIT);
+                count = queue.Wait(done.data(), buffersCount, 1000);
+            }
+            if (count == 0)
+            {
+                txDataRate_Bps.store(totalBytesSent);
+                totalBytesSent = 0;
+            }
+            for (int d = 0; d < count; ++d)
+            {
+                const unsigned bytesSent = done[d].transferred;
+                if (bytesSent != done[d].length)
                 {
                     for (auto &value : mTxStreams)
                         if (value.used && value.mActive)
@@ -683,17 +1751,14 @@ void Streamer::TransmitPacketsLoop()
                 }
                 else
                     totalBytesSent += bytesSent;
-                bufferUsed[bi] = false;
-            }
-            else
-            {
-                txDataRate_Bps.store(totalBytesSent);
-                totalBytesSent = 0;
-                continue;
+                txBytesTotal.fetch_add(bytesSent, std::memory_order_relaxed);
+                batch.OnCompletion(bytesSent/sizeof(FPGA_DataPacket), done[d].due_us, waitStart);
             }
+            continue;
         }
 
-        FPGA_DataPacket* pkt = reinterpret_cast<FPGA_DataPacket*>(&buffers[bi*bufferSize]);
+        const uint32_t packetsToBatch = batch.Packets();
+        FPGA_DataPacket* pkt = reinterpret_cast<FPGA_DataPacket*>(buffer);
         int i=0;
         do
         {
@@ -709,7 +1774,11 @@ void Streamer::TransmitPacketsLoop()
                     memset(&samples[ind][0],0,maxSamplesBatch*sizeof(complex16_t));
                     continue;
                 }
-                int samplesPopped = mTxStreams[ch].Read(samples[ind].data(), maxSamplesBatch, &meta, popTimeout_ms);
+                int samplesPopped;
+                {
+                    StageTimer timer(STAGE_TX_FIFO_POP);
+                    samplesPopped = mTxStreams[ch].Read(samples[ind].data(), maxSamplesBatch, &meta, popTimeout_ms);
+                }
                 if (samplesPopped != maxSamplesBatch)
                 {
                     if ((!end_burst) && !(meta.flags & RingFIFO::END_BURST))
@@ -737,20 +1806,44 @@ void Streamer::TransmitPacketsLoop()
             for(uint8_t c=0; c<chCount; ++c)
                 src[c] = (samples[c].data());
             uint8_t* const dataStart = (uint8_t*)pkt[i].data;
+            StageTimer timer(STAGE_TX_BUILD);
             FPGA::Samples2FPGAPacketPayload(src.data(), maxSamplesBatch, chCount==2, packed, dataStart);
 
-        }while(++i<packetsToBatch && end_burst == false);
+        }while(++i<(int)packetsToBatch && end_burst == false);
 
         if(terminateTx.load() == true) //early termination
             break;
 
         if (i)
         {
-            bytesToSend[bi] = i*sizeof(FPGA_DataPacket);
-            handles[bi] = dataPort->BeginDataSending(&buffers[bi*bufferSize], bytesToSend[bi], epIndex);
             txLastTimestamp.store(pkt[i-1].counter+maxSamplesBatch-1); //timestamp of the last sample that was sent to HW
-            bufferUsed[bi] = true;
-            bi = (bi + 1) & (buffersCount-1);
+            const uint64_t due = batch.ExpectedCompletion(NowMicroseconds(), queue.InFlight(), i);
+            if (!queue.Submit(buffer, i*sizeof(FPGA_DataPacket), due))
+                for (auto &value : mTxStreams)
+                    if (value.used && value.mActive)
+                        value.overflow++;
+        }
+        else
+            queue.Release(buffer);
+
+        const uint64_t now = NowMicroseconds();
+        if (batch.Due(now))
+        {
+            //transfers should not outgrow what the least filled channel keeps queued
+            uint32_t fifoPackets = UINT32_MAX;
+            uint32_t fifoSize = 0;
+            for (auto &value : mTxStreams)
+                if (value.used && value.mActive)
+                {
+                    uint32_t filled, size;
+                    value.GetFIFOPackets(&filled, &size);
+                    fifoPackets = std::min(fifoPackets, filled);
+                    fifoSize = std::max(fifoSize, size);
+                }
+            if (fifoSize == 0)
+                fifoPackets = 0;
+            if (batch.Retune(now, fifoPackets, fifoSize, true))
+                lime::debug("Tx: %u packets per transfer, %u transfers in flight", batch.Packets(), batch.InFlight());
         }
 
         t2 = std::chrono::high_resolution_clock::now();
@@ -769,7 +1862,7 @@ void Streamer::TransmitPacketsLoop()
     }
 
     // Wait for all the queued requests to be cancelled
-    dataPort->AbortSending(epIndex);
+    queue.Abort();
     txDataRate_Bps.store(0);
 }
 
@@ -778,33 +1871,39 @@ void Streamer::TransmitPacketsLoop()
 */
 void Streamer::ReceivePacketsLoop()
 {
+    ThreadControl::ExitGuard exitGuard{rxControl};
     //at this point FPGA has to be already configured to output samples
     const uint8_t maxChannelCount = 2;
-    const uint8_t chCount = streamSize;
-    const bool packed = dataLinkFormat == StreamConfig::FMT_INT12;
-    const uint32_t samplesInPacket = (packed  ? samples12InPkt : samples16InPkt)/chCount;
+    //link layout, changes only while the thread is parked
+    uint8_t chCount = streamSize;
+    bool packed = dataLinkFormat == StreamConfig::FMT_INT12;
+    uint32_t samplesInPacket = (packed  ? samples12InPkt : samples16InPkt)/chCount;
+    const StreamConfig::ThreadOptions threadOptions = GetThreadOptions(false);
+    SetCurrentThreadOptions(threadOptions, "Rx");
 
     const int epIndex = chipId;
-    const uint8_t buffersCount = dataPort->GetBuffersCount();
-    const uint8_t packetsToBatch = dataPort->CheckStreamSize(rxBatchSize);
-    const uint32_t bufferSize = packetsToBatch*sizeof(FPGA_DataPacket);
-    std::vector<int> handles(buffersCount, 0);
-    std::vector<char>buffers(buffersCount*bufferSize, 0);
+    const uint8_t buffersCount = dataPort->SetTransferDepth(false, GetTransferDepth(false));
+    const BatchController::Bounds bounds = BatchController::MakeBounds(GetLatencyPreference(false),
+        dataPort->CheckStreamSize(maxPacketsInTransfer), buffersCount);
+    BatchController batch(bounds, dataPort->CheckStreamSize(rxBatchSize));
+    batch.SetPacketTime(PacketTime(GetSampleRate(false), samplesInPacket));
+    const uint32_t bufferSize = bounds.maxPackets*sizeof(FPGA_DataPacket);
+    std::vector<TransferQueue::Completion> done(buffersCount);
+    StreamBuffer buffersMemory;
     std::vector<StreamChannel::Frame> chFrames;
     try
     {
-        chFrames.resize(chCount);
+        buffersMemory.Allocate(buffersCount*bufferSize);
+        buffersMemory.Touch(); //place pages on this thread's node
+        chFrames.resize(maxChannelCount);
     }
     catch (const std::bad_alloc &ex)
     {
         lime::error("Error allocating Rx buffers, not enough memory");
         return;
     }
+    TransferQueue queue(dataPort, false, epIndex, static_cast<char*>(buffersMemory.data()), bufferSize, buffersCount);
 
-    for (int i = 0; i<buffersCount; ++i)
-        handles[i] = dataPort->BeginDataReading(&buffers[i*bufferSize], bufferSize, epIndex);
-
-    int bi = 0;
     unsigned long totalBytesReceived = 0; //for data rate calculation
 
     auto t1 = std::chrono::high_resolution_clock::now();
@@ -816,8 +1915,10 @@ void Streamer::ReceivePacketsLoop()
     std::thread txReset([](FPGA* fpga,
                         std::atomic<bool> *terminate,
                         std::mutex *spiLock,
-                        std::condition_variable *doWork)
+                        std::condition_variable *doWork,
+                        StreamConfig::ThreadOptions options)
     {
+        SetCurrentThreadOptions(options, "Tx flags reset");
         uint32_t reg9 = fpga->ReadRegister(0x0009);
         const uint32_t addr[] = {0x0009, 0x0009};
         const uint32_t data[] = {reg9 | (5 << 1), reg9 & ~(5 << 1)};
@@ -827,83 +1928,166 @@ void Streamer::ReceivePacketsLoop()
             doWork->wait(lck);
             fpga->WriteRegisters(addr, data, 2);
         }
-    }, fpga, &terminateRx, &txFlagsLock, &resetTxFlags);
+    }, fpga, &terminateRx, &txFlagsLock, &resetTxFlags, threadOptions);
 
     int resetFlagsDelay = 0;
     uint64_t prevTs = 0;
+    uint32_t prevSamples = 0; //packet size can change with layout
+    bool havePrevTs = false; //first packet has nothing to be compared to
     while (terminateRx.load() == false)
     {
-        int32_t bytesReceived = 0;
-        if(handles[bi] >= 0)
+        if (rxControl.state.load(std::memory_order_acquire) == ThreadControl::PARK)
         {
-            if (dataPort->WaitForReading(handles[bi], 1000) == true)
-            {
-                bytesReceived = dataPort->FinishDataReading(&buffers[bi*bufferSize], bufferSize, handles[bi]);
-                totalBytesReceived += bytesReceived;
-                if (bytesReceived != int32_t(bufferSize)) //data should come in full sized packets
-                    for(auto &value: mRxStreams)
-                        if (value.used && value.mActive)
-                            value.underflow++;
-            }
-            else
-            {
-                rxDataRate_Bps.store(totalBytesReceived);
-                totalBytesReceived = 0;
-                continue;
-            }
+            //streams stopped or layout changes, queued transfers are dropped, buffers stay
+            queue.Abort();
+            totalBytesReceived = 0;
+            rxDataRate_Bps.store(0);
+            Park(rxControl, terminateRx);
+            t1 = std::chrono::high_resolution_clock::now();
+            chCount = streamSize;
+            packed = dataLinkFormat == StreamConfig::FMT_INT12;
+            samplesInPacket = (packed  ? samples12InPkt : samples16InPkt)/chCount;
+            batch.SetPacketTime(PacketTime(GetSampleRate(false), samplesInPacket));
+            //after a layout change the gap is lost data of streams that kept running
+            if (!rxControl.keepTimestamps.exchange(false))
+                havePrevTs = false;
+            continue;
+        }
+        //keep the in-flight target of transfers queued
+        while (queue.InFlight() < batch.InFlight())
+        {
+            char* buffer = queue.Acquire();
+            if (buffer == nullptr)
+                break;
+            const uint64_t due = batch.ExpectedCompletion(NowMicroseconds(), queue.InFlight(), batch.Packets());
+            if (!queue.Submit(buffer, batch.Packets()*sizeof(FPGA_DataPacket), due))
+                break;
+        }
+        int count;
+        const uint64_t waitStart = NowMicroseconds();
+        {
+            StageTimer timer(STAGE_RX_USB_WAIT);
+            count = queue.Wait(done.data(), buffersCount, 1000);
         }
-        bool txLate=false;
-        for (uint8_t pktIndex = 0; pktIndex < bytesReceived / sizeof(FPGA_DataPacket); ++pktIndex)
+        if (count == 0)
         {
-            const FPGA_DataPacket* pkt = (FPGA_DataPacket*)&buffers[bi*bufferSize];
-            const uint8_t byte0 = pkt[pktIndex].reserved[0];
-            if ((byte0 & (1 << 3)) != 0 && !txLate) //report only once per batch
+            rxDataRate_Bps.store(totalBytesReceived);
+            totalBytesReceived = 0;
+            continue;
+        }
+        //bulk transfers complete in submission order, samples stay in sequence
+        for (int d = 0; d < count; ++d)
+        {
+            const int32_t bytesReceived = done[d].transferred;
+            batch.OnCompletion(bytesReceived/sizeof(FPGA_DataPacket), done[d].due_us, waitStart);
+            totalBytesReceived += bytesReceived;
+            rxBytesTotal.fetch_add(bytesReceived, std::memory_order_relaxed);
+            if (bytesReceived != int32_t(done[d].length)) //data should come in full sized packets
+                for(auto &value: mRxStreams)
+                    if (value.used && value.mActive)
+                        value.underflow++;
+            const FPGA_DataPacket* pkt = (const FPGA_DataPacket*)done[d].buffer;
+            bool txLate=false;
+            for (uint8_t pktIndex = 0; pktIndex < bytesReceived / sizeof(FPGA_DataPacket); ++pktIndex)
             {
-                txLate = true;
-                if(resetFlagsDelay > 0)
-                    --resetFlagsDelay;
-                else
+                const uint8_t byte0 = pkt[pktIndex].reserved[0];
+                if ((byte0 & (1 << 3)) != 0 && !txLate) //report only once per batch
                 {
-                    lime::warning("L");
-                    resetTxFlags.notify_one();
-                    resetFlagsDelay = buffersCount;
-                    for(auto &value: mTxStreams)
+                    txLate = true;
+                    if(resetFlagsDelay > 0)
+                        --resetFlagsDelay;
+                    else
+                    {
+                        lime::warning("L");
+                        resetTxFlags.notify_one();
+                        resetFlagsDelay = buffersCount;
+                        for(auto &value: mTxStreams)
+                            if (value.used && value.mActive)
+                                value.pktLost++;
+                    }
+                }
+                uint8_t* pktStart = (uint8_t*)pkt[pktIndex].data;
+                const uint64_t expectedTs = prevTs + prevSamples;
+                if(pkt[pktIndex].counter > expectedTs && havePrevTs)
+                {
+                    const uint64_t missing = pkt[pktIndex].counter - expectedTs;
+                    int packetLoss = (missing + samplesInPacket - 1)/samplesInPacket;
+                    for(auto &value: mRxStreams)
                         if (value.used && value.mActive)
-                            value.pktLost++;
+                        {
+                            value.pktLost += packetLoss;
+                            if (packetLoss > 0)
+                                value.RecordLoss(expectedTs, packetLoss, missing);
+                        }
+                }
+                havePrevTs = true;
+                prevTs = pkt[pktIndex].counter;
+                prevSamples = samplesInPacket;
+                rxLastTimestamp.store(prevTs);
+                //parse samples straight into FIFO packets of active channels,
+                //channels without a FIFO packet are parsed into chFrames
+                complex16_t* dest[maxChannelCount];
+                StreamChannel* target[maxChannelCount] = {nullptr, nullptr};
+                for(uint8_t c=0; c<chCount; ++c)
+                    dest[c] = (chFrames[c].samples);
+                {
+                    StageTimer timer(STAGE_RX_FIFO_PUSH);
+                    for(int ch=0; ch<maxChannelCount; ++ch)
+                    {
+                        if (mRxStreams[ch].used==false || mRxStreams[ch].mActive==false)
+                            continue;
+                        const int ind = chCount == maxChannelCount ? ch : 0;
+                        complex16_t* slot;
+                        if (target[ind] == nullptr && mRxStreams[ch].ReceivesInSlot()
+                            && mRxStreams[ch].AcquireWrite(&slot, 100, true) >= (int)samplesInPacket)
+                        {
+                            target[ind] = &mRxStreams[ch];
+                            dest[ind] = slot;
+                        }
+                    }
+                }
+                int samplesCount;
+                {
+                    StageTimer timer(STAGE_RX_PARSE);
+                    samplesCount = FPGA::FPGAPacketPayload2Samples(pktStart, 4080, chCount==2, packed, dest);
                 }
-            }
-            uint8_t* pktStart = (uint8_t*)pkt[pktIndex].data;
-            if(pkt[pktIndex].counter - prevTs != samplesInPacket && pkt[pktIndex].counter != prevTs)
-            {
-                int packetLoss = ((pkt[pktIndex].counter - prevTs)/samplesInPacket)-1;
-                for(auto &value: mRxStreams)
-                    if (value.used && value.mActive)
-                        value.pktLost += packetLoss;
-            }
-            prevTs = pkt[pktIndex].counter;
-            rxLastTimestamp.store(prevTs);
-            //parse samples
-            std::vector<complex16_t*> dest(chCount);
-            for(uint8_t c=0; c<chCount; ++c)
-                dest[c] = (chFrames[c].samples);
-            int samplesCount = FPGA::FPGAPacketPayload2Samples(pktStart, 4080, chCount==2, packed, dest.data());
 
-            for(int ch=0; ch<maxChannelCount; ++ch)
-            {
-                if (mRxStreams[ch].used==false || mRxStreams[ch].mActive==false)
-                    continue;
-                const int ind = chCount == maxChannelCount ? ch : 0;
-                StreamChannel::Metadata meta;
-                meta.timestamp = pkt[pktIndex].counter;
-                meta.flags = RingFIFO::OVERWRITE_OLD | RingFIFO::SYNC_TIMESTAMP;
-                int samplesPushed = mRxStreams[ch].Write((const void*)chFrames[ind].samples, samplesCount, &meta, 100);
-                if(samplesPushed != samplesCount)
-                    mRxStreams[ch].overflow++;
+                for(int ch=0; ch<maxChannelCount; ++ch)
+                {
+                    if (mRxStreams[ch].used==false || mRxStreams[ch].mActive==false)
+                        continue;
+                    const int ind = chCount == maxChannelCount ? ch : 0;
+                    StreamChannel::Metadata meta;
+                    meta.timestamp = pkt[pktIndex].counter;
+                    meta.flags = RingFIFO::OVERWRITE_OLD | RingFIFO::SYNC_TIMESTAMP;
+                    mRxStreams[ch].ProcessOutputs(dest[ind], samplesCount, meta.timestamp);
+                    StageTimer timer(STAGE_RX_FIFO_PUSH);
+                    if (!mRxStreams[ch].PushReceived(dest[ind], target[ind] == &mRxStreams[ch], samplesCount, &meta))
+                        mRxStreams[ch].overflow++;
+                }
             }
         }
-        // Re-submit this request to keep the queue full
-        handles[bi] = dataPort->BeginDataReading(&buffers[bi*bufferSize], bufferSize, epIndex);
-        bi = (bi + 1) & (buffersCount-1);
+
+        const uint64_t now = NowMicroseconds();
+        if (batch.Due(now))
+        {
+            //application lagging behind any channel needs more transfers in flight
+            uint32_t fifoPackets = 0;
+            uint32_t fifoSize = 0;
+            for (auto &value : mRxStreams)
+                if (value.used && value.mActive)
+                {
+                    uint32_t filled, size;
+                    value.GetFIFOPackets(&filled, &size);
+                    if (size && (fifoSize == 0 || uint64_t(filled)*fifoSize > uint64_t(fifoPackets)*size))
+                    {
+                        fifoPackets = filled;
+                        fifoSize = size;
+                    }
+                }
+            if (batch.Retune(now, fifoPackets, fifoSize, false))
+                lime::debug("Rx: %u packets per transfer, %u transfers in flight", batch.Packets(), batch.InFlight());
+        }
 
         t2 = std::chrono::high_resolution_clock::now();
         auto timePeriod = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
@@ -919,7 +2103,7 @@ void Streamer::ReceivePacketsLoop()
             rxDataRate_Bps.store((uint32_t)dataRate);
         }
     }
-    dataPort->AbortReading(epIndex);
+    queue.Abort();
     resetTxFlags.notify_one();
     txReset.join();
     rxDataRate_Bps.store(0);
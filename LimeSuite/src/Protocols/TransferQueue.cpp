@@ -0,0 +1,117 @@
+/**
+    @file TransferQueue.cpp
+    @brief Stream transfers in flight on one endpoint, finished in completion order
+*/
+
+#include "TransferQueue.h"
+#include "IConnection.h"
+#include <algorithm>
+
+namespace lime
+{
+
+TransferQueue::TransferQueue(IConnection* port, bool tx, int epIndex, char* buffers, uint32_t bufferSize, uint32_t count) :
+    mPort(port), mTx(tx), mEpIndex(epIndex), mBuffers(buffers), mBufferSize(bufferSize), mCount(count),
+    mQueued(true), mInFlight(0), mHandles(count)
+{
+    //lowest buffers on top of the free list
+    for (uint32_t i = count; i > 0; --i)
+        mFree.push_back(i - 1);
+}
+
+char* TransferQueue::Acquire()
+{
+    if (mFree.empty())
+        return nullptr;
+    const int index = mFree.back();
+    mFree.pop_back();
+    return &mBuffers[index*mBufferSize];
+}
+
+void TransferQueue::Release(char* buffer)
+{
+    mFree.push_back((buffer - mBuffers) / mBufferSize);
+}
+
+bool TransferQueue::Submit(char* buffer, uint32_t length, uint64_t due_us)
+{
+    const int handle = mTx ? mPort->BeginDataSending(buffer, length, mEpIndex) : mPort->BeginDataReading(buffer, length, mEpIndex);
+    if (handle < 0)
+    {
+        Release(buffer);
+        return false;
+    }
+    if (handle >= int(mSlots.size()))
+    {
+        Slot unused = {-1, 0, 0};
+        mSlots.resize(handle + 1, unused);
+    }
+    mSlots[handle].buffer = (buffer - mBuffers) / mBufferSize;
+    mSlots[handle].length = length;
+    mSlots[handle].due_us = due_us;
+    mOrder.push_back(handle);
+    ++mInFlight;
+    return true;
+}
+
+int TransferQueue::Wait(Completion* done, uint32_t count, unsigned timeout_ms)
+{
+    if (mInFlight == 0)
+        return 0;
+    int n = -1;
+    if (mQueued)
+    {
+        n = mPort->WaitForCompletions(mTx, mEpIndex, mHandles.data(), std::min(count, mCount), timeout_ms);
+        mQueued = n >= 0;
+    }
+    if (!mQueued)
+    {
+        const int handle = mOrder.front();
+        if (!(mTx ? mPort->WaitForSending(handle, timeout_ms) : mPort->WaitForReading(handle, timeout_ms)))
+            return 0;
+        mHandles[0] = handle;
+        n = 1;
+    }
+
+    int finished = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        const int handle = mHandles[i];
+        //transfers begun by others on the same endpoint are theirs to finish, they stay reported
+        if (handle < 0 || handle >= int(mSlots.size()) || mSlots[handle].buffer < 0)
+            continue;
+        Slot &slot = mSlots[handle];
+        char* buffer = &mBuffers[slot.buffer*mBufferSize];
+        done[finished].buffer = buffer;
+        done[finished].length = slot.length;
+        done[finished].due_us = slot.due_us;
+        done[finished].transferred = mTx ? mPort->FinishDataSending(buffer, slot.length, handle)
+                                         : mPort->FinishDataReading(buffer, slot.length, handle);
+        mFree.push_back(slot.buffer);
+        slot.buffer = -1;
+        --mInFlight;
+        if (mOrder.front() == handle)
+            mOrder.pop_front();
+        else
+            mOrder.erase(std::find(mOrder.begin(), mOrder.end(), handle));
+        ++finished;
+    }
+    return finished;
+}
+
+void TransferQueue::Abort()
+{
+    if (mTx)
+        mPort->AbortSending(mEpIndex);
+    else
+        mPort->AbortReading(mEpIndex);
+    for (auto &slot : mSlots)
+        slot.buffer = -1;
+    mOrder.clear();
+    mFree.clear();
+    for (uint32_t i = mCount; i > 0; --i)
+        mFree.push_back(i - 1);
+    mInFlight = 0;
+}
+
+}
@@ -0,0 +1,276 @@
+/**
+    @file TriggerEngine.cpp
+    @brief Per packet trigger evaluation of received samples
+*/
+
+#include "TriggerEngine.h"
+#include "SampleKernels.h"
+#include "fifo.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+namespace lime
+{
+
+//power of a full scale 12-bit sample, 0 dBFS
+static const double fullScalePower = 2048.0*2048.0;
+static const double maxPatternValue = 2047.0;
+static const int maxCorrelationInput = 2048;
+
+static inline uint32_t SamplePower(const complex16_t &sample)
+{
+    return uint32_t(int32_t(sample.i)*sample.i) + uint32_t(int32_t(sample.q)*sample.q);
+}
+
+TriggerEngine::TriggerEngine() : mConfigPending(false), mTriggers(0)
+{
+    mConfig.mode = Config::MODE_OFF;
+    mConfig.threshold = 0;
+    mConfig.preTrigger = 0;
+    mConfig.postTrigger = 0;
+    mConfig.singleShot = false;
+    mState = STATE_IDLE;
+    mThresholdEnergy = 0;
+    mPatternEnergy = 0;
+    mRemaining = 0;
+    mBelow = false;
+    mMarkWindow = false;
+    mHistoryPos = 0;
+    mHistoryFill = 0;
+    mHistoryEnd = 0;
+}
+
+void TriggerEngine::Configure(const Config &config)
+{
+    std::lock_guard<std::mutex> lck(mConfigLock);
+    mPendingConfig = config;
+    mConfigPending.store(true, std::memory_order_release);
+}
+
+uint32_t TriggerEngine::Triggers() const
+{
+    return mTriggers.load();
+}
+
+bool TriggerEngine::Armed()
+{
+    if (mConfigPending.load(std::memory_order_acquire))
+        Apply();
+    return mConfig.mode != Config::MODE_OFF;
+}
+
+//! Takes pending configuration and starts over, only place that allocates
+void TriggerEngine::Apply()
+{
+    {
+        std::lock_guard<std::mutex> lck(mConfigLock);
+        mConfig = mPendingConfig;
+        mConfigPending.store(false, std::memory_order_relaxed);
+    }
+    mConfig.postTrigger = std::max<uint32_t>(1, mConfig.postTrigger);
+
+    //pattern is scaled to 12-bit range so that correlation sums fit 32 bits
+    std::vector<complex16_t> &pattern = mConfig.pattern;
+    if (pattern.size() > size_t(kernels::maxCorrelationLength))
+        pattern.resize(kernels::maxCorrelationLength);
+    int peak = 0;
+    for (auto &value : pattern)
+        peak = std::max(peak, std::max(abs(value.i), abs(value.q)));
+    mPatternEnergy = 0;
+    for (auto &value : pattern)
+    {
+        if (peak)
+        {
+            value.i = lrint(value.i * maxPatternValue / peak);
+            value.q = lrint(value.q * maxPatternValue / peak);
+        }
+        mPatternEnergy += double(value.i)*value.i + double(value.q)*value.q;
+    }
+
+    mThresholdEnergy = std::min<double>(UINT32_MAX, fullScalePower * pow(10, mConfig.threshold / 10));
+    mHistory.resize(mConfig.preTrigger + kernels::maxCorrelationLength);
+    mHistoryPos = 0;
+    mHistoryFill = 0;
+    mState = STATE_IDLE;
+    mRemaining = 0;
+    mBelow = false;
+    mMarkWindow = false;
+    mTriggers.store(0);
+}
+
+/** @brief Evaluates trigger condition on a packet
+    @param trigger returns index of the trigger sample relative to packet start,
+           correlation can place it up to pattern length before the packet
+*/
+bool TriggerEngine::Detect(const complex16_t* samples, uint32_t count, int* trigger)
+{
+    switch (mConfig.mode)
+    {
+    case Config::MODE_POWER:
+        *trigger = 0;
+        return kernels::Energy(samples, count) > mThresholdEnergy * count;
+    case Config::MODE_EDGE:
+    {
+        uint32_t from = 0;
+        if (!mBelow)
+        {
+            const int below = kernels::FindPower(samples, count, mThresholdEnergy, false);
+            if (below < 0)
+                return false;
+            mBelow = true;
+            from = below;
+        }
+        const int above = kernels::FindPower(samples + from, count - from, mThresholdEnergy, true);
+        if (above < 0)
+            return false;
+        *trigger = from + above;
+        return true;
+    }
+    case Config::MODE_CORRELATION:
+    {
+        const uint32_t length = mConfig.pattern.size();
+        if (length == 0 || mPatternEnergy == 0)
+            return false;
+        //windows starting in the end of history were not complete with the previous packet
+        const uint32_t tail = std::min(length - 1, mHistoryFill);
+        const uint32_t total = tail + count;
+        if (total < length)
+            return false;
+        if (mCorrInput.size() < total)
+            mCorrInput.resize(total);
+        const uint32_t cap = mHistory.size();
+        for (uint32_t i = 0; i < tail; ++i)
+            mCorrInput[i] = mHistory[(mHistoryPos + cap - tail + i) % cap];
+        memcpy(&mCorrInput[tail], samples, count*sizeof(complex16_t));
+        //sums fit 32 bits for 12-bit samples only, louder input is scaled down,
+        //normalized correlation does not depend on the scale
+        int peak = 0;
+        for (uint32_t i = 0; i < total; ++i)
+            peak = std::max(peak, std::max(abs(mCorrInput[i].i), abs(mCorrInput[i].q)));
+        int shift = 0;
+        while ((peak >> shift) > maxCorrelationInput)
+            ++shift;
+        for (uint32_t i = 0; shift && i < total; ++i)
+        {
+            mCorrInput[i].i >>= shift;
+            mCorrInput[i].q >>= shift;
+        }
+
+        const uint32_t outputs = total - length + 1;
+        if (mCorrRe.size() < outputs)
+        {
+            mCorrRe.resize(outputs);
+            mCorrIm.resize(outputs);
+        }
+        kernels::Correlate(mCorrInput.data(), outputs, mConfig.pattern.data(), length, mCorrRe.data(), mCorrIm.data());
+        //normalized correlation |c|^2/(Ep*Ex) compared without division
+        uint64_t windowEnergy = kernels::Energy(mCorrInput.data(), length);
+        for (uint32_t n = 0; n < outputs; ++n)
+        {
+            if (n)
+                windowEnergy += SamplePower(mCorrInput[n + length - 1]) - uint64_t(SamplePower(mCorrInput[n - 1]));
+            const double c = double(mCorrRe[n])*mCorrRe[n] + double(mCorrIm[n])*mCorrIm[n];
+            if (windowEnergy && c > mConfig.threshold * mPatternEnergy * double(windowEnergy))
+            {
+                *trigger = int(n) - int(tail);
+                return true;
+            }
+        }
+        return false;
+    }
+    default:
+        return false;
+    }
+}
+
+//! Appends packet to the ring of samples preceding the next packet
+void TriggerEngine::KeepHistory(const complex16_t* samples, uint32_t count, uint64_t timestamp)
+{
+    const uint32_t cap = mHistory.size();
+    if (cap == 0)
+        return;
+    if (count > cap)
+    {
+        samples += count - cap;
+        count = cap;
+    }
+    const uint32_t first = std::min(count, cap - mHistoryPos);
+    memcpy(&mHistory[mHistoryPos], samples, first*sizeof(complex16_t));
+    memcpy(&mHistory[0], samples + first, (count - first)*sizeof(complex16_t));
+    mHistoryPos = (mHistoryPos + count) % cap;
+    mHistoryFill = std::min(cap, mHistoryFill + count);
+    mHistoryEnd = timestamp + count;
+}
+
+//! Writes samples to FIFO packet by packet, the first one of a window gets TRIGGERED flag
+bool TriggerEngine::Push(RingFIFO* fifo, const complex16_t* samples, uint32_t count, uint64_t timestamp, uint32_t flags)
+{
+    const uint32_t packetSamples = fifo->PacketSamples();
+    uint32_t pushed = 0;
+    while (pushed < count)
+    {
+        const uint32_t cnt = std::min(count - pushed, packetSamples);
+        const uint32_t pktFlags = mMarkWindow ? flags | RingFIFO::TRIGGERED : flags;
+        mMarkWindow = false;
+        if (fifo->push_samples(&samples[pushed], cnt, 1, timestamp + pushed, 100, pktFlags) != cnt)
+            return false;
+        pushed += cnt;
+    }
+    return true;
+}
+
+/** @brief Delivers window part available at trigger time: history before the packet and the packet itself
+    @param samples packet samples, must not be in a FIFO slot as pushing overwrites it
+*/
+bool TriggerEngine::StartWindow(RingFIFO* fifo, const complex16_t* samples, uint32_t count, uint64_t timestamp, uint32_t flags, int trigger)
+{
+    mTriggers++;
+    mMarkWindow = true;
+    mBelow = false;
+    bool ok = true;
+    const int64_t start = int64_t(trigger) - mConfig.preTrigger;
+    if (start < 0)
+    {
+        //history is kept in a ring, at most two pieces
+        const uint32_t cap = mHistory.size();
+        const uint32_t n = std::min<uint64_t>(-start, mHistoryFill);
+        const uint32_t from = (mHistoryPos + cap - n) % cap;
+        const uint32_t first = std::min(n, cap - from);
+        ok &= Push(fifo, &mHistory[from], first, timestamp - n, flags);
+        ok &= Push(fifo, &mHistory[0], n - first, timestamp - n + first, flags);
+    }
+    const int64_t end = int64_t(trigger) + mConfig.postTrigger;
+    const uint32_t from = std::max<int64_t>(0, start);
+    const uint32_t to = std::max<int64_t>(from, std::min<int64_t>(count, end));
+    ok &= Push(fifo, samples + from, to - from, timestamp + from, flags);
+    mRemaining = end > count ? end - count : 0;
+    if (mRemaining)
+        mState = STATE_CAPTURE;
+    else
+        mState = mConfig.singleShot ? STATE_DONE : STATE_IDLE;
+    return ok;
+}
+
+bool TriggerEngine::Process(RingFIFO* fifo, const complex16_t* samples, uint32_t count, uint64_t timestamp, uint32_t flags)
+{
+    //history only helps when it continues into this packet
+    if (mHistoryEnd != timestamp)
+        mHistoryFill = 0;
+    bool ok = true;
+    int trigger;
+    if (mState == STATE_CAPTURE)
+    {
+        const uint32_t n = std::min(count, mRemaining);
+        ok = Push(fifo, samples, n, timestamp, flags);
+        mRemaining -= n;
+        if (mRemaining == 0)
+            mState = mConfig.singleShot ? STATE_DONE : STATE_IDLE;
+    }
+    else if (mState == STATE_IDLE && Detect(samples, count, &trigger))
+        ok = StartWindow(fifo, samples, count, timestamp, flags, trigger);
+    KeepHistory(samples, count, timestamp);
+    return ok;
+}
+
+}
@@ -64,6 +64,7 @@ public:
 	// Streaming calls
 	int devDestroyStream(lms_stream_t *streamObj);
 	int devGetStreamStatus(lms_stream_t *stream, lms_stream_status_t* status);
+	int devGetStreamTelemetry(lms_stream_t *stream, lms_stream_telemetry_t* telemetry);
 	int devSendStream(lms_stream_t *streamObj, const void *samples, size_t sample_count,
 			lms_stream_meta_t *meta, unsigned timeout_ms);
 	int devReceiveStream(lms_stream_t *streamObj, void *samples, size_t sample_count,
@@ -71,6 +72,8 @@ public:
 	int devSetupStream(lms_stream_t *streamObj);
 	int devStartStream(lms_stream_t *streamObj);
 	int devStopStream(lms_stream_t *streamObj);
+	void setStreamThreadOptions(bool dir_tx, const lms_stream_thread_t& options);
+	lms_stream_thread_t getStreamThreadOptions(bool dir_tx);
 
 	// Transmission specific
 	bool changeConstellation(int constellationID);
@@ -109,6 +112,8 @@ private:
 	int numChannels;
 	lms_info_str_t deviceName;
 	lms_device_t *devicePointer;
+	// Applied to the streams of this device when they are set up. 0: RX, 1: TX
+	lms_stream_thread_t streamThreads[2];
 
 	mutex devLck;
 };
@@ -38,14 +38,16 @@ enum eCmd {
 	INIT = 10,
 	LO = 11,
 	LOAD = 12,
-	LPBW = 13,
-	QUIT = 14,
-	RESET = 15,
-	SAMPLE = 16,
-	SAVE = 17,
-	STREAM = 18,
-	WFMPLAYER = 19,
-	NUMBEROFCOMMANDS = 20 // Has to be the last entry
+	LOGLEVEL = 13,
+	LPBW = 14,
+	QUIT = 15,
+	RESET = 16,
+	SAMPLE = 17,
+	SAVE = 18,
+	STREAM = 19,
+	THREADS = 20,
+	WFMPLAYER = 21,
+	NUMBEROFCOMMANDS = 22 // Has to be the last entry
 };
 
 // Commands strings. Make sure to have the same length-1 as commands ENUM, as well as the same order.
@@ -63,12 +65,14 @@ static const char *commands[NUMBEROFCOMMANDS] {
 	"init",
 	"lo",
 	"load",
+	"loglevel",
 	"lpbw",
 	"quit",
 	"reset",
 	"sample",
 	"save",
 	"stream",
+	"threads",
 	"wfm"
 };
 
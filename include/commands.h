@@ -53,5 +53,6 @@ bool setGain(deviceVector& deviceVec, int devID, const char *dir, int channel);
 bool setLOFreq(deviceVector& deviceVec, int devID, const char *dir, int channel);
 bool setLPBW(deviceVector& deviceVec, int devID, const char *dir, int channel);
 bool setSamplingRate(deviceVector& deviceVec, int devID, const char *dir);
+bool setStreamThreads(deviceVector& deviceVec, int devID, const char *dir, const lms_stream_thread_t& options);
 
 #endif /* INCLUDE_COMMANDS_H_ */
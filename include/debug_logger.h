@@ -5,6 +5,8 @@
  * description:
  * This is a simple, custom debug logger.
  * It includes functions for printing into a log file, printing to console or both.
+ * Log file lines are queued into a lock-free ring buffer of the calling thread and
+ * written by a background thread, which keeps the log file open and writes in batches.
  * ==================================================================
  */
 
@@ -20,10 +22,32 @@
 
 using namespace std;
 
+// Log levels of the log file. Lines with a higher level than the current one are discarded.
+enum eLogLevel
+{
+	LOG_LVL_ERROR = 0,
+	LOG_LVL_WARNING = 1,
+	LOG_LVL_INFO = 2,
+	LOG_LVL_DEBUG = 3
+};
+
+// Trace lines of hot paths (every device call, every modulated symbol, ...).
+// They are compiled out entirely in release builds.
+#ifdef NDEBUG
+#define printTraceLine(...) ((void)0)
+#else
+#define printTraceLine(...) printDebugLine(LOG_LVL_DEBUG, __VA_ARGS__)
+#endif
+
 bool debug_logger();
+void closeDebugLogger();
 void writeHeader();
 bool openLogFile(bool newFile = false);
 
+// Runtime log level of the log file, default is LOG_LVL_INFO.
+void setLogLevel(eLogLevel level);
+eLogLevel getLogLevel();
+
 // Functions to print a text to the console and the log file
 void printConsoleAndDebugLine(const char* text, int addInt);
 void printConsoleAndDebugLine(const char* text, float addFloat);
@@ -34,9 +58,12 @@ void printConsoleLine(const char* text, int addInt);
 void printConsoleLine(const char* text, float addFloat);
 void printConsoleLine(const char* text);
 
-// Log File functions.
+// Log File functions. Without a level, lines are logged as LOG_LVL_INFO.
 void printDebugLine(const char* text, int addInt);
 void printDebugLine(const char* text, float addFloat);
 bool printDebugLine(const char* text);
+void printDebugLine(eLogLevel level, const char* text, int addInt);
+void printDebugLine(eLogLevel level, const char* text, float addFloat);
+bool printDebugLine(eLogLevel level, const char* text);
 
 #endif /* INCLUDE_DEBUG_LOGGER_H_ */
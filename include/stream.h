@@ -11,6 +11,7 @@
 
 #include "globals.h"
 #include "Device.h"
+#include "telemetry.h"
 
 // LimeSuite and externals.
 #include "dataTypes.h"
@@ -39,6 +40,7 @@ enum iCommands
 	iPRINTRXDATA = 11,
 	iPRINTSTREAMDATA = 15,
 	iPRINTDEVICEINFO = 16,
+	iPRINTTELEMETRY = 17,
 	iPRINTTXDATATOFILE = 18,
 	iPRINTRXDATATOFILE = 19,
 	iCHANGELPBW = 20,
@@ -56,6 +58,9 @@ enum iCommands
 	iGETANTENNAPORT = 33,
 	iSETGFIRLPF = 34,
 	iSETINTANDDEC = 36,
+	iPROFILING = 40,
+	iPRINTPROFILE = 41,
+	iWRITETRACE = 42,
 //	iCHANGETHVSLAT = 50,
 	iONETONE = 100,
 	iSPIMODE = 200
@@ -94,6 +99,7 @@ public:
 	bool printTxDataToFile(int16_t* tx_buffer, int tx_size);
 	bool printRxDataToFile(int16_t* rx_buffer, int rx_size);
 	string returnStreamStatus(int channel);
+	string returnStreamProfile();
 
 	// Various
 	int setIntpAndDeci(int interpolation, int decimation);
@@ -113,6 +119,7 @@ private:
 	FILE *fdDestinationFile_ch0;
 	FILE *fdDestinationFile_ch1;
 	FILE *fdResultsFile;
+	Telemetry telemetry;
 
 #ifdef USE_GNU_PLOT
 	GNUPlotPipe gppRx, gppTx;
@@ -0,0 +1,86 @@
+/* ==================================================================
+ * title:		telemetry.h
+ * author:		mh
+ * project:		Masterthesis Martin Hinteregger
+ * description:
+ * Periodic export of the stream health counters (overruns, underruns, dropped packets,
+ * link rate, FIFO fill level and high-water mark) while the streams are running.
+ * Every sample is written as one line per stream into a rolling metrics file and
+ * sent to all clients connected to a local UNIX socket.
+ * ==================================================================
+ */
+
+#ifndef INCLUDE_TELEMETRY_H_
+#define INCLUDE_TELEMETRY_H_
+
+#include "globals.h"
+#include "Device.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+#define telemetrySocketPath "wat_telemetry.sock"
+#define telemetryFileName "metrics.txt"
+// Size of the metrics file before it is moved to old_metrics.txt
+#define telemetryMaxFileBytes (4*1024*1024)
+#define telemetryDefaultIntervalMs 1000
+
+class Telemetry {
+public:
+	Telemetry();
+	~Telemetry();
+
+	// Register a stream before start(). name is used as stream label in the output.
+	void addStream(Device* dev, lms_stream_t* stream, const char* name);
+	void clearStreams();
+
+	// Start / stop the sampling thread.
+	int start(int intervalMs = telemetryDefaultIntervalMs);
+	void stop();
+	bool isRunning() const;
+
+	// The last exported lines, one per stream.
+	string lastSample();
+
+private:
+	struct Entry
+	{
+		Device* dev;
+		lms_stream_t* stream;
+		string name;
+		lms_stream_telemetry_t last;
+		bool hasLast;
+	};
+
+	void run();
+	void sample(double dt);
+	int openSocket();
+	void closeSocket();
+	void acceptClients();
+	void publish(const string& text);
+	int openFile();
+	void writeFile(const string& text);
+
+	vector<Entry> entries;
+	thread sampler;
+	atomic<bool> running;
+	int interval;
+	mutex lck;
+	condition_variable wake;
+
+	int fdSocket;
+	vector<int> clients;
+	FILE* fdFile;
+	long fileBytes;
+
+	mutex lckLast;
+	string lastText;
+};
+
+#endif /* INCLUDE_TELEMETRY_H_ */
@@ -24,6 +24,7 @@ Device::Device(int id_, lms_info_str_t deviceName_)
 	printDebugLine("Device::create ", id_);
 	id = id_;
 	strcpy(deviceName, deviceName_);
+	memset(streamThreads, 0, sizeof(streamThreads));
 
 	if (LMS_Open(&devicePointer, deviceName, NULL))
 	{
@@ -59,7 +60,7 @@ Device::~Device()
 bool Device::changeConstellation(int constellationID)
 {
 	devLck.lock();
-	printDebugLine("Device::changeConstellation ", id);
+	printTraceLine("Device::changeConstellation ", id);
 
 	switch (constellationID)
 	{
@@ -88,7 +89,7 @@ int Device::devCalibrate(bool dir_tx, float bandwidth, int channel)
 {
 	int retVal;
 	devLck.lock();
-	printDebugLine("Device::devCalibrate ", id);
+	printTraceLine("Device::devCalibrate ", id);
 	retVal = LMS_Calibrate(devicePointer, dir_tx, channel, bandwidth, 0);
 	devLck.unlock();
 	return retVal;
@@ -101,7 +102,7 @@ int Device::devCalibrate(bool dir_tx, float bandwidth, int channel)
 bool Device::devDisconnect()
 {
 	devLck.lock();
-	printDebugLine("Device::devDisconnect ", id);
+	printTraceLine("Device::devDisconnect ", id);
 	LMS_Close(this->devicePointer);
 	devLck.unlock();
 	return false;
@@ -116,7 +117,7 @@ int Device::devEnable(bool dir_tx, bool en, int channel)
 {
 	int retVal;
 	devLck.lock();
-	printDebugLine("Device::devEnable ", id);
+	printTraceLine("Device::devEnable ", id);
 	retVal = LMS_EnableChannel(devicePointer, dir_tx, channel, en);
 	devLck.unlock();
 	return retVal;
@@ -130,7 +131,7 @@ int Device::devEnable(bool dir_tx, bool en, int channel)
 string Device::devGetAntennaPorts(int channel)
 {
 	devLck.lock();
-	printDebugLine("Device::devGetAntennaPorts ", id);
+	printTraceLine("Device::devGetAntennaPorts ", id);
 	string text;
 	lms_name_t antennaRX_list[10], antennaTX_list[10];
 	int n, nRX, nTX;
@@ -182,7 +183,7 @@ string Device::devGetAntennaPorts(int channel)
 string Device::devGetSynthesiserFrequency(size_t clk_id)
 {
 	devLck.lock();
-	printDebugLine("Device::devGetSynthesiserFrequency ", id);
+	printTraceLine("Device::devGetSynthesiserFrequency ", id);
 	float_type freq;
 	int retVal;
 	retVal = LMS_GetClockFreq(devicePointer, clk_id, &freq);
@@ -216,7 +217,7 @@ string Device::devGetSynthesiserFrequency(size_t clk_id)
 string Device::devGetGain(int channel)
 {
 	devLck.lock();
-	printDebugLine("Device::devGetGain ", id);
+	printTraceLine("Device::devGetGain ", id);
 	string text;
 
 	unsigned int gainRX, gainTX;
@@ -244,7 +245,7 @@ string Device::devGetGain(int channel)
 string Device::devGetLOFreq(int channel)
 {
 	devLck.lock();
-	printDebugLine("Device::devGetLOFreq ", id);
+	printTraceLine("Device::devGetLOFreq ", id);
 	string text;
 
 	devLck.unlock();
@@ -279,7 +280,7 @@ string Device::devGetLOFreq(int channel)
 string Device::devGetLOFreqRange()
 {
 	devLck.lock();
-	printDebugLine("Device::devGetLOFreq ", id);
+	printTraceLine("Device::devGetLOFreq ", id);
 	string text;
 
 	lms_range_t rangeRX, rangeTX;
@@ -308,7 +309,7 @@ string Device::devGetLOFreqRange()
 string Device::devGetLPBW(int channel)
 {
 	devLck.lock();
-	printDebugLine("Device::devGetLPBW ", id);
+	printTraceLine("Device::devGetLPBW ", id);
 	string text;
 
     float_type bwRX, bwTX;
@@ -342,7 +343,7 @@ string Device::devGetLPBW(int channel)
 string Device::devGetLPBWRange()
 {
 	devLck.lock();
-	printDebugLine("Device::devGetLPBWRange ", id);
+	printTraceLine("Device::devGetLPBWRange ", id);
 	string text;
 
     lms_range_t rangeRX, rangeTX;
@@ -372,7 +373,7 @@ int Device::devGetNumChannels(bool dir_tx)
 {
 	int retVal;
 	devLck.lock();
-	printDebugLine("Device::devGetNumChannels ", id);
+	printTraceLine("Device::devGetNumChannels ", id);
 	retVal = LMS_GetNumChannels(devicePointer, dir_tx);
 	devLck.unlock();
 	return retVal;
@@ -385,7 +386,7 @@ int Device::devGetNumChannels(bool dir_tx)
 string Device::devGetSamplingRate(int channel)
 {
 	devLck.lock();
-	printDebugLine("Device::devGetSamplingRate ", id);
+	printTraceLine("Device::devGetSamplingRate ", id);
 	string text = "";
 
     float_type rateRX, rf_rateRX;
@@ -420,7 +421,7 @@ string Device::devGetSamplingRate(int channel)
 string Device::devGetSamplingRateRange()
 {
 	devLck.lock();
-	printDebugLine("Device::devGetSamplingRateRange ", id);
+	printTraceLine("Device::devGetSamplingRateRange ", id);
 	string text;
 
     lms_range_t rangeRX, rangeTX;
@@ -449,7 +450,7 @@ string Device::devGetSamplingRateRange()
 void Device::devInit()
 {
 	devLck.lock();
-	printDebugLine("Device::devInit ", id);
+	printTraceLine("Device::devInit ", id);
 	LMS_Init(devicePointer);
 	devLck.unlock();
 }
@@ -462,7 +463,7 @@ int Device::devLoadConfig(const char *filename)
 {
 	int retVal;
 	devLck.lock();
-	printDebugLine("Device::devLoadConfig ", id);
+	printTraceLine("Device::devLoadConfig ", id);
 	retVal = LMS_LoadConfig(devicePointer, filename);
 	devLck.unlock();
 	return retVal;
@@ -499,7 +500,7 @@ void Device::devPrintInfoNoConsole()
 void Device::devReset()
 {
 	devLck.lock();
-	printDebugLine("Device::devReset ", id);
+	printTraceLine("Device::devReset ", id);
 	LMS_Reset(devicePointer);
 	devLck.unlock();
 }
@@ -512,7 +513,7 @@ int Device::devSaveConfig(const char *filename)
 {
 	int retVal;
 	devLck.lock();
-	printDebugLine("Device::devSaveConfig ", id);
+	printTraceLine("Device::devSaveConfig ", id);
 	retVal = LMS_SaveConfig(devicePointer, filename);
 	devLck.unlock();
 	return retVal;
@@ -526,7 +527,7 @@ int Device::devSetAntennaPorts(int channel, bool dir_tx, int port)
 {
 	int retVal;
 	devLck.lock();
-	printDebugLine("Device::devSetAntennaPorts ", id);
+	printTraceLine("Device::devSetAntennaPorts ", id);
 	retVal = LMS_SetAntenna(devicePointer, dir_tx, channel, port);
 	devLck.unlock();
 	return retVal;
@@ -541,7 +542,7 @@ int Device::devSetSynthesiserFrequency(size_t clk_id, float_type freq)
 {
 	int retVal;
 	devLck.lock();
-	printDebugLine("Device::devSetSynthesiserFrequency ", id);
+	printTraceLine("Device::devSetSynthesiserFrequency ", id);
 	retVal = LMS_SetClockFreq(devicePointer, clk_id, freq);
 	devLck.unlock();
 	return retVal;
@@ -555,7 +556,7 @@ int Device::devSetGain(int channel, bool dir_tx, unsigned int gain)
 {
 	int retVal;
 	devLck.lock();
-	printDebugLine("Device::devSetGain ", id);
+	printTraceLine("Device::devSetGain ", id);
 	retVal = LMS_SetGaindB(devicePointer, dir_tx, channel, gain);
 	devLck.unlock();
 	return retVal;
@@ -569,7 +570,7 @@ int Device::devSetLOFreq(int channel, bool dir_tx, float_type freq)
 {
 	int retVal;
 	devLck.lock();
-	printDebugLine("Device::devSetLOFreq ", id);
+	printTraceLine("Device::devSetLOFreq ", id);
 	retVal = LMS_SetLOFrequency(devicePointer, dir_tx, channel, (float_type)freq);
 	devLck.unlock();
 	return retVal;
@@ -583,7 +584,7 @@ int Device::devSetLPBW(int channel, bool dir_tx, float_type bandwidth)
 {
 	int retVal;
 	devLck.lock();
-	printDebugLine("Device::devSetLPBW ", id);
+	printTraceLine("Device::devSetLPBW ", id);
 	retVal = LMS_SetLPFBW(devicePointer, dir_tx, channel, bandwidth);
 	devLck.unlock();
 	return retVal;
@@ -597,7 +598,7 @@ int Device::devSetSamplingRate(float_type rate, size_t sampling, bool dir_tx)
 {
 	int retVal;
 	devLck.lock();
-	printDebugLine("Device::devSetSamplingRate ", id);
+	printTraceLine("Device::devSetSamplingRate ", id);
 	retVal = LMS_SetSampleRateDir(devicePointer, dir_tx, rate, sampling);
 	devLck.unlock();
 	return retVal;
@@ -611,7 +612,7 @@ int Device::devSetSamplingRate(float_type rate, size_t sampling)
 {
 	int retVal;
 	devLck.lock();
-	printDebugLine("Device::devSetSamplingRate ", id);
+	printTraceLine("Device::devSetSamplingRate ", id);
 	retVal = LMS_SetSampleRate(devicePointer, rate, sampling);
 	devLck.unlock();
 	return retVal;
@@ -650,7 +651,7 @@ int Device::devDestroyStream(lms_stream_t *streamObj)
 {
 	int retVal;
 	devLck.lock();
-	printDebugLine("Device::devDestroyStream ", id);
+	printTraceLine("Device::devDestroyStream ", id);
 	retVal = LMS_DestroyStream(devicePointer, streamObj);
 	devLck.unlock();
 	return retVal;
@@ -661,12 +662,19 @@ int Device::devGetStreamStatus(lms_stream_t *stream, lms_stream_status_t* status
 {
 	int retVal;
 	devLck.lock();
-	printDebugLine("Device::devGetStreamStatus ", id);
+	printTraceLine("Device::devGetStreamStatus ", id);
 	retVal = LMS_GetStreamStatus(stream, status);
 	devLck.unlock();
 	return retVal;
 }
 
+// Safe cumulative stream counters into telemetry. Does not take the device lock, so it can be
+// polled while the stream threads are busy.
+int Device::devGetStreamTelemetry(lms_stream_t *stream, lms_stream_telemetry_t* telemetry)
+{
+	return LMS_GetStreamTelemetry(stream, telemetry);
+}
+
 // Send data to TX thread, stored in samples with length sample_count.
 // Mmta and timeout is optional.
 int Device::devSendStream(lms_stream_t *streamObj, const void *samples, size_t sample_count,
@@ -698,18 +706,37 @@ int Device::devSetupStream(lms_stream_t *streamObj)
 {
 	int retVal;
 	devLck.lock();
-	printDebugLine("Device::devSetupStream ", id);
+	printTraceLine("Device::devSetupStream ", id);
 	retVal = LMS_SetupStream(devicePointer, streamObj);
+	if (!retVal)
+		retVal = LMS_SetStreamThreadOptions(streamObj, &streamThreads[streamObj->isTx]);
 	devLck.unlock();
 	return retVal;
 }
 
+// Thread options for streams set up afterwards, they take effect when the stream threads start.
+void Device::setStreamThreadOptions(bool dir_tx, const lms_stream_thread_t& options)
+{
+	devLck.lock();
+	streamThreads[dir_tx] = options;
+	devLck.unlock();
+}
+
+lms_stream_thread_t Device::getStreamThreadOptions(bool dir_tx)
+{
+	lms_stream_thread_t options;
+	devLck.lock();
+	options = streamThreads[dir_tx];
+	devLck.unlock();
+	return options;
+}
+
 // Start stream by setting thread to active
 int Device::devStartStream(lms_stream_t *streamObj)
 {
 	int retVal;
 	devLck.lock();
-	printDebugLine("Device::devStartStream ", id);
+	printTraceLine("Device::devStartStream ", id);
 	retVal = LMS_StartStream(streamObj);
 	devLck.unlock();
 	return retVal;
@@ -720,7 +747,7 @@ int Device::devStopStream(lms_stream_t *streamObj)
 {
 	int retVal;
 	devLck.lock();
-	printDebugLine("Device::devStopStream ", id);
+	printTraceLine("Device::devStopStream ", id);
 	retVal = LMS_StopStream(streamObj);
 	devLck.unlock();
 	return retVal;
@@ -733,7 +760,7 @@ int Device::toggleAGC(uint32_t wantedRSSI, bool start)
 {
 	int retVal;
 	devLck.lock();
-	printDebugLine("Device::toggleAGC ", id);
+	printTraceLine("Device::toggleAGC ", id);
 	retVal = LMS_ToogleAGC(devicePointer, wantedRSSI, start);
 	devLck.unlock();
 	return retVal;
@@ -746,7 +773,7 @@ int Device::devReadParam(const std::string& name, uint16_t *val)
 {
 	int retVal;
 	devLck.lock();
-	printDebugLine("Device::devReadParam ", id);
+	printTraceLine("Device::devReadParam ", id);
 	retVal = LMS_ReadParam(devicePointer, name, val);
 	devLck.unlock();
 	return retVal;
@@ -756,7 +783,7 @@ int Device::devReadParam(struct LMS7Parameter param, uint16_t *val)
 {
 	int retVal;
 	devLck.lock();
-	printDebugLine("Device::devReadParam ", id);
+	printTraceLine("Device::devReadParam ", id);
 	retVal = LMS_ReadParam(devicePointer, param, val);
 	devLck.unlock();
 	return retVal;
@@ -766,7 +793,7 @@ int Device::devWriteParam(const std::string& name, uint16_t val)
 {
 	int retVal;
 	devLck.lock();
-	printDebugLine("Device::devWriteParam ", id);
+	printTraceLine("Device::devWriteParam ", id);
 	retVal = LMS_WriteParam(devicePointer, name, val);
 	devLck.unlock();
 	return retVal;
@@ -776,7 +803,7 @@ int Device::devWriteParam(struct LMS7Parameter param, uint16_t val)
 {
 	int retVal;
 	devLck.lock();
-	printDebugLine("Device::devWriteParam ", id);
+	printTraceLine("Device::devWriteParam ", id);
 	retVal = LMS_WriteParam(devicePointer, param, val);
 	devLck.unlock();
 	return retVal;
@@ -787,7 +814,7 @@ int Device::devSetGFIRLPF(bool dir_tx, size_t chan, bool enabled, float_type ban
 {
 	int retVal;
 	devLck.lock();
-	printDebugLine("Device::devWriteParam ", id);
+	printTraceLine("Device::devWriteParam ", id);
 	retVal = LMS_SetGFIRLPF(devicePointer, dir_tx, chan, enabled, bandwidth);
 	devLck.unlock();
 	return retVal;
@@ -809,7 +836,7 @@ int Device::devSetDecimation(uint16_t val)
 {
 	int retVal;
 	devLck.lock();
-	printDebugLine("Device::devSetIntpAndDeci ", id);
+	printTraceLine("Device::devSetIntpAndDeci ", id);
 	retVal = LMS_SetIntpAndDeciAndTune(devicePointer, freqMHz, interpolation, decimation);
 	devLck.unlock();
 	return retVal;
@@ -23,6 +23,7 @@ int main(int argc, char** argv)
 	bool quit, retVal, en, firstrun = true;
 	int destID, sourceID, channel;
 	float_type bandwidth;
+	lms_stream_thread_t threadOptions;
 
 	cout << "WAT version " << swVersion << ", will init and start prompt.\n";
 	cout << "Warning: Most inputs will not be checked for type or validity.\n";
@@ -90,6 +91,16 @@ int main(int argc, char** argv)
 		case HELP:
 			printHelp();
 			continue;
+		case LOGLEVEL:
+			cout << "Specify log file level (0: error, 1: warning, 2: info, 3: debug). Current: " <<
+					getLogLevel() << "\n=>loglevel=>";
+			cin >> channel;
+			cin.ignore();
+			if (channel < LOG_LVL_ERROR || channel > LOG_LVL_DEBUG)
+				printConsoleLine("Invalid log level.");
+			else
+				setLogLevel((eLogLevel)channel);
+			continue;
 		case QUIT:
 			quit = true;
 			continue;
@@ -444,6 +455,36 @@ int main(int argc, char** argv)
 			delete stream;
 
 			continue;
+		case THREADS:
+			cout << "Specify device ID.\n=>threads=>";
+			cin >> destID;
+			cin.ignore();
+
+			cout << "TX, RX or both? (tx, rx, both)\n=>threads=>";
+			getline(cin, sCmd);
+
+			cout << "Specify CPU mask in hex (bit n for CPU n, 0 for all CPUs).\n=>threads=>";
+			cin >> hex >> threadOptions.cpuMask >> dec;
+			cin.ignore();
+
+			cout << "Specify scheduling policy (0: default, 1: fifo, 2: round robin).\n=>threads=>";
+			cin >> threadOptions.policy;
+			cin.ignore();
+
+			threadOptions.priority = 0;
+			if (threadOptions.policy != LMS_SCHED_DEFAULT)
+			{
+				cout << "Specify real-time priority (1-99).\n=>threads=>";
+				cin >> threadOptions.priority;
+				cin.ignore();
+			}
+
+			retVal = setStreamThreads(deviceVec, destID, sCmd.c_str(), threadOptions);
+			if (retVal)
+				printConsoleAndDebugLine("Could not set stream thread options.");
+			else
+				printConsoleLine("Stream thread options will be applied to the next stream.");
+			continue;
 		case WFMPLAYER:
 			printConsoleAndDebugLine("Play Waveform: This feature was planned, but never implemented.");
 			//cout << "Specify device to send the waveform.\n=>wfm=>";
@@ -464,6 +505,7 @@ int main(int argc, char** argv)
 	}
 
 	disconnect(deviceVec);
+	closeDebugLogger();
 	return 0;
 }
 
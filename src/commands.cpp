@@ -720,11 +720,13 @@ void printHelp()
 	printConsoleLine("init:          Load opened devices with default configuration.");
 	printConsoleLine("lo:            Get / Set LO Frequency.");
 	printConsoleLine("load / save:   Load / Save a configuration file.");
+	printConsoleLine("loglevel:      Set the level of the log file (error, warning, info, debug).");
 	printConsoleLine("lpbw:          Configure low-pass bandwidth.");
 	printConsoleLine("reset:         Resets opened devices.");
 	printConsoleLine("sample:        Get / Set sampling rate.");
 	printConsoleLine("stream:        Will set up a stream object and start stream procedure between user defined devices and \n"
 			         "               with a defined test file. User can pause stream by pressing \"p\" and issue commands.");
+	printConsoleLine("threads:       Set CPU affinity and real-time priority of the stream threads of a device.");
 	printConsoleLine("wfm:           Specify a device to send a waveform through the FPGA waveform player.");
 	printConsoleLine("\nTip: Use -1 when prompted with deviceID, channel or similar to select all available.");
 }
@@ -1163,3 +1165,48 @@ bool setSamplingRate(deviceVector& deviceVec, int devID, const char *dir)
 	return true;
 }
 
+
+/*
+ * setStreamThreads(deviceVector& deviceVec, int devID, const char *dir, const lms_stream_thread_t& options)
+ * This function will first call it self again for every device if devID is -1 and for both directions.
+ * Stores CPU affinity and scheduling policy for the stream threads of the device.
+ * They are applied when streams are set up and take effect when the stream threads start.
+ */
+bool setStreamThreads(deviceVector& deviceVec, int devID, const char *dir, const lms_stream_thread_t& options)
+{
+	bool dir_tx = false;
+
+	if (devID == -1)
+	{
+		for (int i = 0; i < (int)deviceVec.size(); i++)
+		{
+			if (setStreamThreads(deviceVec, i, dir, options))
+				return true;
+		}
+		return false;
+	}
+
+	if (!strcmp(dir, "both"))
+	{
+		if (setStreamThreads(deviceVec, devID, "tx", options))
+			return true;
+		return setStreamThreads(deviceVec, devID, "rx", options);
+	}
+
+	if (!strcmp(dir, "tx"))
+		dir_tx = true;
+	if (!strcmp(dir, "rx"))
+		dir_tx = false;
+
+	for (const auto& device : deviceVec)
+	{
+		if (devID == device->getId())
+		{
+			device->setStreamThreadOptions(dir_tx, options);
+			printDebugLine("Stream thread options set for device ", devID);
+			return false;
+		}
+	}
+	printConsoleAndDebugLine("Device ID not found.");
+	return true;
+}
@@ -74,31 +74,31 @@ char Bpsk::demodulateToChar(int16_t toDemod[], int len)
 
 int Bpsk::getConstellationID()
 {
-	printDebugLine("Bpsk::getConstellationID");
+	printTraceLine("Bpsk::getConstellationID");
 	return constellationID;
 }
 
 const char *Bpsk::getConstellationName()
 {
-	printDebugLine("Bpsk::getConstellationName");
+	printTraceLine("Bpsk::getConstellationName");
 	return constellationName;
 }
 
 int Bpsk::getNumBits()
 {
-	printDebugLine("Bpsk::getNumBits");
+	printTraceLine("Bpsk::getNumBits");
 	return numBits;
 }
 
 int Bpsk::getSymbolsBits()
 {
-	printDebugLine("Bpsk::getSymbolsBits");
+	printTraceLine("Bpsk::getSymbolsBits");
 	return numSymbols;
 }
 
 int Bpsk::getBitmask()
 {
-	printDebugLine("Bpsk::getBitmask");
+	printTraceLine("Bpsk::getBitmask");
 	return bitmask;
 }
 
@@ -27,56 +27,56 @@ Constellation::~Constellation()
 
 complex16_t Constellation::modulateSingleSymbol(int8_t toMod)
 {
-	printDebugLine("Error: constellation::modulate");
+	printDebugLine(LOG_LVL_ERROR, "constellation::modulate");
 	// Should not be reached due to abstract.
 	return {-1, -1};
 }
 
 int8_t Constellation::demodulateSingleSymbol(int16_t i_, int16_t q_)
 {
-	printDebugLine("Error: constellation::demodulateSingleSymbol");
+	printDebugLine(LOG_LVL_ERROR, "constellation::demodulateSingleSymbol");
 	// Should not be reached due to abstract.
 	return 0;
 }
 
 char Constellation::demodulateToChar(int16_t toDemod[], int len)
 {
-	printDebugLine("Error: constellation::demodulateToChar");
+	printDebugLine(LOG_LVL_ERROR, "constellation::demodulateToChar");
 	// Should not be reached due to abstract.
 	return -1;
 }
 
 int Constellation::getConstellationID()
 {
-	printDebugLine("Error: constellation::getConstellationID");
+	printDebugLine(LOG_LVL_ERROR, "constellation::getConstellationID");
 	// Should not be reached due to abstract.
 	return constellationID;
 }
 
 const char *Constellation::getConstellationName()
 {
-	printDebugLine("Error: constellation::getConstellationName");
+	printDebugLine(LOG_LVL_ERROR, "constellation::getConstellationName");
 	// Should not be reached due to abstract.
 	return constellationName;
 }
 
 int Constellation::getNumBits()
 {
-	printDebugLine("Error: constellation::getNumBits");
+	printDebugLine(LOG_LVL_ERROR, "constellation::getNumBits");
 	// Should not be reached due to abstract.
 	return numBits;
 }
 
 int Constellation::getSymbolsBits()
 {
-	printDebugLine("Error: constellation::getSymbolsBits");
+	printDebugLine(LOG_LVL_ERROR, "constellation::getSymbolsBits");
 	// Should not be reached due to abstract.
 	return numSymbols;
 }
 
 int Constellation::getBitmask()
 {
-	printDebugLine("Error: constellation::getBitmask");
+	printDebugLine(LOG_LVL_ERROR, "constellation::getBitmask");
 	// Should not be reached due to abstract.
 	return bitmask;
 }
@@ -26,7 +26,7 @@ Qpsk::~Qpsk()
 
 complex16_t Qpsk::modulateSingleSymbol(int8_t toMod)
 {
-	printDebugLine("Qpsk::modulate");
+	printTraceLine("Qpsk::modulate");
 	if (toMod & 0b00000010)
 	{
 		if (toMod & 0b00000001)
@@ -45,7 +45,7 @@ complex16_t Qpsk::modulateSingleSymbol(int8_t toMod)
 
 int8_t Qpsk::demodulateSingleSymbol(int16_t i_, int16_t q_)
 {
-	printDebugLine("Qpsk::demodulate");
+	printTraceLine("Qpsk::demodulate");
 	return 0;
 }
 
@@ -56,31 +56,31 @@ char Qpsk::demodulateToChar(int16_t toDemod[], int len)
 
 int Qpsk::getConstellationID()
 {
-	printDebugLine("Qpsk::getConstellationID");
+	printTraceLine("Qpsk::getConstellationID");
 	return constellationID;
 }
 
 const char *Qpsk::getConstellationName()
 {
-	printDebugLine("Qpsk::getConstellationName");
+	printTraceLine("Qpsk::getConstellationName");
 	return constellationName;
 }
 
 int Qpsk::getNumBits()
 {
-	printDebugLine("Qpsk::getNumBits");
+	printTraceLine("Qpsk::getNumBits");
 	return numBits;
 }
 
 int Qpsk::getSymbolsBits()
 {
-	printDebugLine("Qpsk::getSymbolsBits");
+	printTraceLine("Qpsk::getSymbolsBits");
 	return numSymbols;
 }
 
 int Qpsk::getBitmask()
 {
-	printDebugLine("Qpsk::getBitmask");
+	printTraceLine("Qpsk::getBitmask");
 	return bitmask;
 }
 
@@ -5,17 +5,207 @@
  * description:
  * This is a simple, custom debug logger.
  * It includes functions for printing into a log file, printing to console or both.
+ * Every thread writing into the log file gets its own single producer / single consumer
+ * ring buffer. A background thread drains all rings, sorts the lines by time and writes
+ * them in one batch into the log file, which stays open until the logger is closed.
  * ==================================================================
  */
 
 #include "debug_logger.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <thread>
+#include <vector>
+
 const char* logFileName = "log.txt";
-mutex lckFile;
 
-// Filedescriptor
+// Number of lines a single thread can queue before lines are dropped.
+#define logRingSize 256
+// Maximum length of a single line, longer lines are cut.
+#define logLineLength 240
+// Interval of the writer thread if nobody wakes it up.
+#define logFlushIntervalMs 50
+
+// A single queued log line.
+struct LogRecord
+{
+	int64_t timeNs;
+	eLogLevel level;
+	char text[logLineLength];
+};
+
+// Padding keeps head and tail on separate cache lines. Rings are allocated with new,
+// which does not honour alignas() before C++17.
+#define logCacheLine 64
+
+// Ring buffer of one thread. The thread only writes head, the writer thread only writes tail.
+struct LogRing
+{
+	LogRing() : head(0), tail(0), dropped(0), orphaned(false) {}
+
+	char pad0[logCacheLine];
+	std::atomic<uint32_t> head;
+	char pad1[logCacheLine];
+	std::atomic<uint32_t> tail;
+	char pad2[logCacheLine];
+	std::atomic<uint32_t> dropped;
+	std::atomic<bool> orphaned;
+	LogRecord records[logRingSize];
+};
+
+// All rings, owned by the writer. Rings of exited threads are deleted after draining.
+mutex lckRings;
+vector<LogRing*> logRings;
+
+atomic<int> logLevel(LOG_LVL_INFO);
+
+// Writer thread state
+thread writerThread;
+mutex lckWriter;
+condition_variable writerWake;
+atomic<bool> writerRunning(false);
+
+// Filedescriptor, only used by the writer thread while it is running.
 FILE* fdLogFile;
 
+/*
+ * Registers a ring for the calling thread on its first log line and marks it orphaned
+ * when the thread exits, so the writer can drain and delete it.
+ */
+struct LogRingHandle
+{
+	LogRingHandle()
+	{
+		ring = new LogRing();
+		lock_guard<mutex> lck(lckRings);
+		logRings.push_back(ring);
+	}
+	~LogRingHandle()
+	{
+		// The writer may delete the ring from now on, later lines of this thread are dropped.
+		LogRing* last = ring;
+		ring = NULL;
+		last->orphaned.store(true, memory_order_release);
+	}
+	LogRing* ring;
+};
+
+static LogRing* threadRing()
+{
+	thread_local LogRingHandle handle;
+	return handle.ring;
+}
+
+// Write all queued lines of all rings into the log file.
+static void drainRings(vector<LogRecord>& batch, vector<char>& out)
+{
+	uint32_t dropped = 0;
+	batch.clear();
+	{
+		lock_guard<mutex> lck(lckRings);
+		for (auto it = logRings.begin(); it != logRings.end();)
+		{
+			LogRing* ring = *it;
+			// Check orphaned before reading head, so no line of an exited thread is lost.
+			const bool orphaned = ring->orphaned.load(memory_order_acquire);
+			const uint32_t head = ring->head.load(memory_order_acquire);
+			uint32_t tail = ring->tail.load(memory_order_relaxed);
+			for (; tail != head; tail++)
+				batch.push_back(ring->records[tail % logRingSize]);
+			ring->tail.store(tail, memory_order_release);
+			dropped += ring->dropped.exchange(0, memory_order_relaxed);
+
+			if (orphaned)
+			{
+				delete ring;
+				it = logRings.erase(it);
+			}
+			else
+				++it;
+		}
+	}
+
+	if (batch.empty() && dropped == 0)
+		return;
+
+	// Lines of different threads are only ordered by their time.
+	stable_sort(batch.begin(), batch.end(), [](const LogRecord& a, const LogRecord& b)
+	{
+		return a.timeNs < b.timeNs;
+	});
+
+	// Format everything into one buffer, localtime is only called once per second.
+	out.clear();
+	time_t lastSecond = -1;
+	char textTime[32] = "";
+	char line[logLineLength + 64];
+	for (const auto& record : batch)
+	{
+		time_t second = record.timeNs / 1000000000;
+		if (second != lastSecond)
+		{
+			struct tm timeinfo;
+			localtime_r(&second, &timeinfo);
+			strftime(textTime, sizeof(textTime), "%d-%m-%Y %H:%M:%S: ", &timeinfo);
+			lastSecond = second;
+		}
+
+		int len;
+		switch (record.level)
+		{
+		case LOG_LVL_ERROR:
+			len = snprintf(line, sizeof(line), "%sERROR: %s\n", textTime, record.text);
+			break;
+		case LOG_LVL_WARNING:
+			len = snprintf(line, sizeof(line), "%sWARNING: %s\n", textTime, record.text);
+			break;
+		case LOG_LVL_DEBUG:
+			len = snprintf(line, sizeof(line), "%sDEBUG: %s\n", textTime, record.text);
+			break;
+		default:
+			len = snprintf(line, sizeof(line), "%s%s\n", textTime, record.text);
+			break;
+		}
+		if (len > (int)sizeof(line) - 1)
+			len = sizeof(line) - 1;
+		out.insert(out.end(), line, line + len);
+	}
+	if (dropped)
+	{
+		int len = snprintf(line, sizeof(line), "%sdebug_logger: %u lines dropped.\n", textTime, dropped);
+		out.insert(out.end(), line, line + len);
+	}
+
+	if (fdLogFile != NULL)
+	{
+		fwrite(out.data(), 1, out.size(), fdLogFile);
+		fflush(fdLogFile);
+	}
+}
+
+// Background thread, drains the rings periodically or when a ring gets filled up.
+static void writerLoop()
+{
+	vector<LogRecord> batch;
+	vector<char> out;
+	batch.reserve(logRingSize);
+
+	while (writerRunning.load())
+	{
+		{
+			unique_lock<mutex> lck(lckWriter);
+			writerWake.wait_for(lck, chrono::milliseconds(logFlushIntervalMs));
+		}
+		drainRings(batch, out);
+	}
+	drainRings(batch, out);
+}
+
 // initialize the logger by checking the file
 bool debug_logger()
 {
@@ -23,6 +213,9 @@ bool debug_logger()
 	char oldLogFileName[32] = "old_";
 	strcat(oldLogFileName, logFileName);
 
+	if (writerRunning.load())
+		return false;
+
 	fileExists = access(logFileName, F_OK);
 
 	if (!fileExists)
@@ -36,10 +229,24 @@ bool debug_logger()
 
 	writeHeader();
 
-	fclose(fdLogFile);
+	writerRunning.store(true);
+	writerThread = thread(writerLoop);
 	return false;
 }
 
+// Flush all queued lines, stop the writer thread and close the log file.
+void closeDebugLogger()
+{
+	if (!writerRunning.exchange(false))
+		return;
+
+	writerWake.notify_one();
+	writerThread.join();
+
+	fclose(fdLogFile);
+	fdLogFile = NULL;
+}
+
 // Write log file header information
 void writeHeader()
 {
@@ -66,6 +273,16 @@ bool openLogFile(bool newFile)
 		return false;
 }
 
+void setLogLevel(eLogLevel level)
+{
+	logLevel.store(level, memory_order_relaxed);
+}
+
+eLogLevel getLogLevel()
+{
+	return (eLogLevel)logLevel.load(memory_order_relaxed);
+}
+
 /*
  * The following functions will call both functions to print text and the additional variables
  * into the console and the log file.
@@ -108,53 +325,101 @@ void printConsoleLine(const char* text)
 	cout << text << "\n";
 }
 
+/*
+ * Reserve the next free record in the ring of the calling thread.
+ * Returns NULL if the level is disabled, the ring is full or the thread is
+ * already exiting and its ring was handed to the writer.
+ */
+static LogRecord* beginRecord(eLogLevel level)
+{
+	if (level > logLevel.load(memory_order_relaxed))
+		return NULL;
+
+	LogRing* ring = threadRing();
+	if (ring == NULL)
+		return NULL;
+	const uint32_t head = ring->head.load(memory_order_relaxed);
+	const uint32_t used = head - ring->tail.load(memory_order_acquire);
+	if (used >= logRingSize)
+	{
+		ring->dropped.fetch_add(1, memory_order_relaxed);
+		return NULL;
+	}
+
+	LogRecord* record = &ring->records[head % logRingSize];
+	record->timeNs = chrono::duration_cast<chrono::nanoseconds>(
+			chrono::system_clock::now().time_since_epoch()).count();
+	record->level = level;
+	return record;
+}
+
+// Publish the record reserved by beginRecord, wake the writer if the ring gets crowded.
+static void commitRecord()
+{
+	LogRing* ring = threadRing();
+	const uint32_t head = ring->head.load(memory_order_relaxed) + 1;
+	ring->head.store(head, memory_order_release);
+	if (head - ring->tail.load(memory_order_relaxed) == logRingSize / 2)
+		writerWake.notify_one();
+}
+
 /*
  * The following functions will print a line into the text file.
  * Either call the function with a single text, or with an additional parameter.
- * When called with additional parameter, the function will format the text and call the native function.
+ * When called with additional parameter, the text is formatted directly into the queued line.
  */
 void printDebugLine(const char* text, int addInt)
 {
-	string newText;
-	newText = text + to_string(addInt);
-
-	printDebugLine(newText.c_str());
+	printDebugLine(LOG_LVL_INFO, text, addInt);
 }
 
 void printDebugLine(const char* text, float addFloat)
 {
-	string newText;
-	newText = text + to_string(addFloat);
-
-	printDebugLine(newText.c_str());
+	printDebugLine(LOG_LVL_INFO, text, addFloat);
 }
 
-
 bool printDebugLine(const char* text)
 {
-	lckFile.lock();
+	return printDebugLine(LOG_LVL_INFO, text);
+}
 
+void printDebugLine(eLogLevel level, const char* text, int addInt)
+{
 	if (text == NULL)
-		return false;
+		return;
 
-	if (openLogFile())
-		return false;
+	LogRecord* record = beginRecord(level);
+	if (record == NULL)
+		return;
+
+	snprintf(record->text, logLineLength, "%s%d", text, addInt);
+	commitRecord();
+}
+
+void printDebugLine(eLogLevel level, const char* text, float addFloat)
+{
+	if (text == NULL)
+		return;
 
-	// Get time
-	time_t timer;
-	struct tm * timeinfo;
+	LogRecord* record = beginRecord(level);
+	if (record == NULL)
+		return;
 
-	timer = time(NULL);
-	timeinfo = localtime(&timer);
-	char textTime[32];
-	string textCat;
+	snprintf(record->text, logLineLength, "%s%f", text, addFloat);
+	commitRecord();
+}
 
-	strftime(textTime,sizeof(textTime),"%d-%m-%Y %H:%M:%S: ",timeinfo);
-	fprintf(fdLogFile, "%s", textTime);
-	fprintf(fdLogFile, "%s", text);
-	fprintf(fdLogFile, "\n");
+bool printDebugLine(eLogLevel level, const char* text)
+{
+	if (text == NULL)
+		return false;
 
-	fclose(fdLogFile);
-	lckFile.unlock();
+	LogRecord* record = beginRecord(level);
+	if (record == NULL)
+		return false;
+
+	strncpy(record->text, text, logLineLength - 1);
+	record->text[logLineLength - 1] = '\0';
+	commitRecord();
 	return true;
 }
@@ -7,6 +7,7 @@
  */
 
 #include "stream.h"
+#include "StreamProfiler.h"
 
 bool pauseStream;
 extern std::vector<const LMS7Parameter*> LMS7parameterList;
@@ -70,6 +71,7 @@ Stream::Stream(deviceVector& deviceVec, int destID, int sourceID)
  */
 Stream::~Stream()
 {
+	telemetry.stop();
 	for (int chan = 0; chan < globalNumChannels; chan++)
 	{
 		rxDev->devStopStream(&rx_stream[chan]);
@@ -201,6 +203,16 @@ int Stream::setupStream()
 		}
 	}
 
+	// Register all streams for the telemetry export.
+	telemetry.clearStreams();
+	for (int chan = 0; chan < globalNumChannels; chan++)
+	{
+		string name = "rx" + to_string(chan);
+		telemetry.addStream(rxDev, &rx_stream[chan], name.c_str());
+		name = "tx" + to_string(chan);
+		telemetry.addStream(txDev, &tx_stream[chan], name.c_str());
+	}
+
 	return 0;
 }
 
@@ -433,6 +445,7 @@ int Stream::startStream(bool continuousMode)
 		rxDev->devStartStream(&rx_stream[chan]);
 		txDev->devStartStream(&tx_stream[chan]);
 	}
+	telemetry.start();
 
 	// Start streampause thread.
 	pauseThreadArgs thArgs;
@@ -466,6 +479,7 @@ int Stream::startStream(bool continuousMode)
     		received = rxDev->devReceiveStream(&rx_stream[chan], rx_buffer, rx_size, NULL, 100);
     		if (received)
     		{
+    			lime::StageTimer timer(lime::STAGE_APP_PROCESS);
 
     			// The following code was programmed at the end of the project
     			// It was a poor try to implement a basic phase shift of the data by
@@ -591,6 +605,7 @@ int Stream::startStream(bool continuousMode)
     	}
     }
 
+	telemetry.stop();
 	printConsoleAndDebugLine("Stream finished.");
 	return 0;
 }
@@ -691,6 +706,13 @@ int Stream::pauseLoop(int16_t* tx_buffer, int &tx_size, int16_t* rx_buffer, int
 				printConsoleAndDebugLine(sCmd.c_str());
 	    	}
 	    	break;
+		case iPRINTTELEMETRY:
+			sCmd = telemetry.lastSample();
+			if (sCmd.empty())
+				printConsoleLine("No telemetry sample yet.");
+			else
+				printConsoleLine(sCmd.c_str());
+			break;
 		case iPRINTDEVICEINFO:
 			cout << "TX:\n";
 			txDev->devPrintInfo();
@@ -961,6 +983,23 @@ int Stream::pauseLoop(int16_t* tx_buffer, int &tx_size, int16_t* rx_buffer, int
 			if (this->setIntpAndDeci(iCmd, (int) fCmd))
 				cout << "Failed.\n";
 			break;
+		case iPROFILING:
+			cout << "Stream profiling (0: off, 1: histograms, 2: histograms and trace)\npaused=>i" <<
+					iPROFILING << "=>";
+			cin >> iCmd;
+			cin.ignore();
+			LMS_SetStreamProfiling(iCmd > 0, iCmd > 1);
+			break;
+		case iPRINTPROFILE:
+			sCmd = returnStreamProfile();
+			printConsoleAndDebugLine(sCmd.c_str());
+			break;
+		case iWRITETRACE:
+			cout << "Specify trace file name.\npaused=>i" << iWRITETRACE << "=>";
+			getline(cin, sCmd);
+			if (LMS_WriteStreamTrace(sCmd.c_str()))
+				printConsoleAndDebugLine("Writing trace file failed.");
+			break;
 			// This is no longer necessary
 //		case iCHANGETHVSLAT:
 //			cout << "Warning: Changing this value will set up a new stream. Sure? (1/0)\n";
@@ -1245,6 +1284,28 @@ string Stream::returnStreamStatus(int channel)
 	return retStr;
 }
 
+/*
+ * returnStreamProfile()
+ * Returns a string with the latency statistics of all stages of the streaming path.
+ */
+string Stream::returnStreamProfile()
+{
+	char line[256];
+	string retStr = "Stage               count     mean[us]   p50[us]   p99[us]  p99.9[us]   max[us]\n";
+	lms_stream_stage_stats_t stats;
+
+	for (int stage = 0; stage < LMS_STAGE_COUNT; stage++)
+	{
+		if (LMS_GetStreamStageStats(stage, &stats))
+			continue;
+		sprintf(line, "%-14s %10llu %12.1f %9.1f %9.1f %10.1f %9.1f\n", LMS_GetStreamStageName(stage),
+				(unsigned long long)stats.count, stats.mean / 1e3, stats.p50 / 1e3, stats.p99 / 1e3, stats.p999 / 1e3,
+				stats.max / 1e3);
+		retStr += line;
+	}
+	return retStr;
+}
+
 /*
  * printTxDataToFile(int16_t* tx_buffer, int tx_size)
  * Take tx_buffer and print it into destination file
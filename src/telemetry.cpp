@@ -0,0 +1,269 @@
+/* ==================================================================
+ * title:		telemetry.cpp
+ * author:		mh
+ * project:		Masterthesis Martin Hinteregger
+ * description:
+ * Periodic export of the stream health counters, see telemetry.h.
+ * Output format is one line per stream and sample of space separated key=value pairs,
+ * counters are cumulative, rates are per second since the previous sample.
+ * ==================================================================
+ */
+
+#include "telemetry.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+Telemetry::Telemetry()
+{
+	running = false;
+	interval = telemetryDefaultIntervalMs;
+	fdSocket = -1;
+	fdFile = NULL;
+	fileBytes = 0;
+}
+
+Telemetry::~Telemetry()
+{
+	stop();
+}
+
+void Telemetry::addStream(Device* dev, lms_stream_t* stream, const char* name)
+{
+	Entry entry;
+	entry.dev = dev;
+	entry.stream = stream;
+	entry.name = name;
+	entry.hasLast = false;
+	memset(&entry.last, 0, sizeof(entry.last));
+	entries.push_back(entry);
+}
+
+void Telemetry::clearStreams()
+{
+	entries.clear();
+}
+
+/*
+ * start(int intervalMs)
+ * Open the metrics file and the socket and start the sampling thread.
+ * A failing socket is not fatal, the metrics file will still be written.
+ */
+int Telemetry::start(int intervalMs)
+{
+	if (running.load())
+		return 0;
+
+	interval = intervalMs;
+	if (openFile())
+		return -1;
+	if (openSocket())
+		printConsoleAndDebugLine("Telemetry: Could not open socket, will only write metrics file.");
+
+	for (auto& entry : entries)
+		entry.hasLast = false;
+
+	running = true;
+	sampler = thread(&Telemetry::run, this);
+	printDebugLine("Telemetry: started.");
+	return 0;
+}
+
+void Telemetry::stop()
+{
+	if (!running.exchange(false))
+		return;
+
+	wake.notify_one();
+	sampler.join();
+
+	closeSocket();
+	if (fdFile != NULL)
+		fclose(fdFile);
+	fdFile = NULL;
+	printDebugLine("Telemetry: stopped.");
+}
+
+bool Telemetry::isRunning() const
+{
+	return running.load();
+}
+
+string Telemetry::lastSample()
+{
+	lock_guard<mutex> lckGuard(lckLast);
+	return lastText;
+}
+
+void Telemetry::run()
+{
+	auto t1 = chrono::steady_clock::now();
+	while (running.load())
+	{
+		{
+			unique_lock<mutex> lckWait(lck);
+			wake.wait_for(lckWait, chrono::milliseconds(interval));
+		}
+		if (!running.load())
+			break;
+
+		auto t2 = chrono::steady_clock::now();
+		sample(chrono::duration<double>(t2 - t1).count());
+		t1 = t2;
+	}
+}
+
+/*
+ * sample(double dt)
+ * Read the counters of all streams, calculate rates since the last sample and export them.
+ */
+void Telemetry::sample(double dt)
+{
+	char line[512];
+	string text;
+	long long now = chrono::duration_cast<chrono::milliseconds>(
+			chrono::system_clock::now().time_since_epoch()).count();
+
+	for (auto& entry : entries)
+	{
+		lms_stream_telemetry_t cur;
+		if (entry.dev->devGetStreamTelemetry(entry.stream, &cur))
+			continue;
+
+		// Counters only go backwards if the stream was set up again.
+		const lms_stream_telemetry_t& prev = entry.last;
+		bool delta = entry.hasLast && dt > 0 && cur.overrun >= prev.overrun &&
+				cur.underrun >= prev.underrun && cur.droppedPackets >= prev.droppedPackets;
+		double overrunRate = delta ? (cur.overrun - prev.overrun) / dt : 0;
+		double underrunRate = delta ? (cur.underrun - prev.underrun) / dt : 0;
+		double droppedRate = delta ? (cur.droppedPackets - prev.droppedPackets) / dt : 0;
+		double fill = cur.fifoSize ? 100.0 * cur.fifoFilledCount / cur.fifoSize : 0;
+		double hwmFill = cur.fifoSize ? 100.0 * cur.fifoHighWater / cur.fifoSize : 0;
+
+		snprintf(line, sizeof(line), "time=%lld stream=%s active=%d fifo_filled=%u fifo_size=%u "
+				"fifo_fill_pct=%.1f fifo_hwm=%u fifo_hwm_pct=%.1f overrun=%u overrun_rate=%.2f "
+				"underrun=%u underrun_rate=%.2f dropped=%u dropped_rate=%.2f link_Bps=%.0f "
+				"link_bytes=%llu timestamp=%llu\n",
+				now, entry.name.c_str(), cur.active, cur.fifoFilledCount, cur.fifoSize,
+				fill, cur.fifoHighWater, hwmFill, cur.overrun, overrunRate,
+				cur.underrun, underrunRate, cur.droppedPackets, droppedRate, (double)cur.linkRate,
+				(unsigned long long)cur.linkBytes, (unsigned long long)cur.timestamp);
+		text += line;
+
+		entry.last = cur;
+		entry.hasLast = true;
+	}
+
+	if (text.empty())
+		return;
+
+	writeFile(text);
+	acceptClients();
+	publish(text);
+
+	lock_guard<mutex> lckGuard(lckLast);
+	lastText = text;
+}
+
+// Listening, non-blocking UNIX stream socket. Clients just connect and read lines.
+int Telemetry::openSocket()
+{
+	struct sockaddr_un addr;
+
+	fdSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fdSocket < 0)
+		return -1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, telemetrySocketPath, sizeof(addr.sun_path) - 1);
+	unlink(telemetrySocketPath);
+
+	if (bind(fdSocket, (struct sockaddr*)&addr, sizeof(addr)) || listen(fdSocket, 4))
+	{
+		close(fdSocket);
+		fdSocket = -1;
+		return -1;
+	}
+	return 0;
+}
+
+void Telemetry::closeSocket()
+{
+	for (int fd : clients)
+		close(fd);
+	clients.clear();
+
+	if (fdSocket >= 0)
+	{
+		close(fdSocket);
+		unlink(telemetrySocketPath);
+	}
+	fdSocket = -1;
+}
+
+void Telemetry::acceptClients()
+{
+	if (fdSocket < 0)
+		return;
+
+	int fd;
+	while ((fd = accept4(fdSocket, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+		clients.push_back(fd);
+}
+
+// Send to all clients. Slow or disconnected clients are dropped, the sampler never blocks.
+void Telemetry::publish(const string& text)
+{
+	for (auto it = clients.begin(); it != clients.end();)
+	{
+		ssize_t sent = send(*it, text.data(), text.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+		if (sent != (ssize_t)text.size())
+		{
+			close(*it);
+			it = clients.erase(it);
+		}
+		else
+			++it;
+	}
+}
+
+int Telemetry::openFile()
+{
+	fdFile = fopen(telemetryFileName, "a");
+	if (fdFile == NULL)
+	{
+		printConsoleAndDebugLine("Telemetry: Could not open metrics file.");
+		return -1;
+	}
+	fileBytes = ftell(fdFile);
+	return 0;
+}
+
+// Append to the metrics file, move it to old_metrics.txt once it got too big.
+void Telemetry::writeFile(const string& text)
+{
+	if (fdFile == NULL)
+		return;
+
+	if (fileBytes + (long)text.size() > telemetryMaxFileBytes)
+	{
+		char oldFileName[32] = "old_";
+		strcat(oldFileName, telemetryFileName);
+
+		fclose(fdFile);
+		rename(telemetryFileName, oldFileName);
+		fdFile = fopen(telemetryFileName, "w");
+		fileBytes = 0;
+		if (fdFile == NULL)
+			return;
+	}
+
+	fwrite(text.data(), 1, text.size(), fdFile);
+	fflush(fdFile);
+	fileBytes += text.size();
+}